@@ -10,49 +10,227 @@
  * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
  * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
  */
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <string.h>
+#endif
 #include "DS1306.h"
+#include "DS1306BCD.h"
+#include "DS1306RawTime.h"
+#if DS1306_BUS == DS1306_BUS_SPILIB
+#include <SPI.h>
+#elif DS1306_BUS == DS1306_BUS_HOST
+#include "DS1306Emulator.h"
+#elif DS1306_BUS == DS1306_BUS_SPIDEV
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "DS1306Emulator.h"
+#endif
+
+// Instrumentation, compiled out unless DS1306_STATS is set
+#if DS1306_STATS
+#define DS1306_STATS_ENTER(api)		DS1306StatsScope statsScope(this, api)
+#define DS1306_STATS_COUNT(field)	(stats[statsApi].field++)
+#define DS1306_STATS_ADD(field, n)	(stats[statsApi].field += (n))
+#else
+#define DS1306_STATS_ENTER(api)
+#define DS1306_STATS_COUNT(field)
+#define DS1306_STATS_ADD(field, n)
+#endif
+
+#if DS1306_BUS_LOCK
+// Byte operations on the bus lock and request queue, safe against interrupt handlers and threads
+// On Arduino interrupts are masked for the compare and swap alone, restoring the previous state on
+// AVR so it may be used inside a handler; elsewhere the compiler's atomic builtins are used
+#ifdef ARDUINO
+#ifdef __AVR__
+#define DS1306_ATOMIC_BEGIN()		unsigned char sreg = SREG; cli()
+#define DS1306_ATOMIC_END()			SREG = sreg
+#else
+#define DS1306_ATOMIC_BEGIN()		noInterrupts()
+#define DS1306_ATOMIC_END()			interrupts()
+#endif
+#define DS1306_BARRIER()			__asm__ __volatile__ ("" ::: "memory")
+#endif
+
+// Store desired in *value if it holds expected, returns true if it did
+static bool atomicSwap(volatile unsigned char *value, unsigned char expected, unsigned char desired)
+{
+#ifdef ARDUINO
+	DS1306_ATOMIC_BEGIN();
+	bool swapped = (*value == expected);
+	if (swapped) *value = desired;
+	DS1306_ATOMIC_END();
+	return swapped;
+#else
+	return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Read *value, ordered after the stores that preceded it in the context that wrote it
+static unsigned char atomicLoad(volatile unsigned char *value)
+{
+#ifdef ARDUINO
+	DS1306_BARRIER();
+	return *value;
+#else
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Write *value, ordered after every store before it
+static void atomicStore(volatile unsigned char *value, unsigned char v)
+{
+#ifdef ARDUINO
+	DS1306_BARRIER();
+	*value = v;
+#else
+	__atomic_store_n(value, v, __ATOMIC_SEQ_CST);
+#endif
+}
 
+// Bus lock and request queue, shared by every DS1306
+volatile unsigned char DS1306::busLocked = 0;
+DS1306::deferred DS1306::deferQueue[DS1306_DEFER_QUEUE];
+volatile unsigned char DS1306::deferHead = 0;
+volatile unsigned char DS1306::deferTail = 0;
+#endif
+
+// Flag within spiRate (AVR backend) selecting SPI2X
+#define DS1306_RATE_2X			0x80
+
+#if DS1306_HOURS == DS1306_HOURS_RUNTIME
 // Constructor with the option to set whether or not we use 24 hour based write (default)
 // or not
 DS1306::DS1306(bool writeHours24) : writeHours24(writeHours24)
 {
+	construct();
 }
 
 // Default constructor, sets the 24 hour based write methodology as default
 DS1306::DS1306() : writeHours24(true)
+#else
+// Constructor, the hour form written is fixed by DS1306_HOURS
+DS1306::DS1306()
+#endif
 {
+	construct();
+}
+
+// Member setup shared by the constructors
+void DS1306::construct()
+{
+	cacheEnabled = false;
+	cacheValid = 0;
+	cacheSaved = 0;
+#if DS1306_STATS
+	statsApi = DS1306_API_OTHER;
+	resetStats();
+#endif
+#if DS1306_BUS == DS1306_BUS_HOST
+	emulator = 0;
+#elif DS1306_BUS == DS1306_BUS_SPIDEV
+	emulator = 0;
+	spiPath = 0;
+	spiFd = -1;
+	spiSegmentCount = 0;
+	spiTxUsed = 0;
+	spiBatching = spiReceiving = spiHeld = spiFailed = false;
+	resetMessageCount();
+#endif
+	selectClock(DS1306_SPI_DIVIDER);
 }
 
 // Must call initialize prior to using any other method in this class (except constructor)
 void DS1306::init(unsigned char ce) 
 {
-	// Initialize SPI Bus
-	pinMode(MOSI, OUTPUT);
-	pinMode(MISO, INPUT);
-	pinMode(SCK, OUTPUT);
-	pinMode(SS, OUTPUT);
-
-	// Initialize the chip enable, LOW
-	pinMode(ce, OUTPUT);
-	digitalWrite(ce, LOW);
+	DS1306_STATS_ENTER(DS1306_API_INIT);
 
 	// Record chip enable line
 	this->ce = ce;
 
+	// Initialize the SPI bus and chip enable
+	busInit();
+
 	// Read control register
-	unsigned char cr = read(DS1306_CR);
+	unsigned char cr = readControl(DS1306_CR);
 
 	// Rewrite control register, disabling write protect
 	// disabling write protect
 	cr = cr & ~ (1 << DS1306_CR_WP);
-	write(DS1306_CR, cr);
+	writeControl(DS1306_CR, cr);
+}
+
+#if DS1306_BUS == DS1306_BUS_HOST || DS1306_BUS == DS1306_BUS_SPIDEV
+// Host builds only, attach the emulated chip that stands in for the SPI bus
+// With the spidev backend the device is then not opened, messages are replayed on the emulator
+// Must be called prior to init
+void DS1306::attach(DS1306Emulator *emulator)
+{
+	this->emulator = emulator;
+}
+#endif
+
+#if DS1306_BUS == DS1306_BUS_SPIDEV
+// Name the spidev device opened by init(), the string must remain valid
+// Must be called prior to init
+void DS1306::setDevice(const char *path)
+{
+	spiPath = path;
 }
 
+// True once init() has opened the spidev device (or an emulator is attached)
+bool DS1306::isBusOpen()
+{
+	return emulator || spiFd >= 0;
+}
+
+// Hold back write transactions, sending them with the next read or at endBatch()
+// Reads still complete before returning, so any method may be called while batching
+void DS1306::beginBatch()
+{
+	spiBatching = true;
+	spiFailed = false;
+}
+
+// Send any held back writes, returns false if a message failed since beginBatch()
+bool DS1306::endBatch()
+{
+	spiBatching = false;
+	busFlush();
+	return !spiFailed;
+}
+
+// Messages sent, each one SPI_IOC_MESSAGE ioctl
+unsigned long DS1306::getMessageCount()
+{
+	return spiMessages;
+}
+
+// Messages the kernel rejected
+unsigned long DS1306::getMessageErrorCount()
+{
+	return spiErrors;
+}
+
+// Zero the message counters
+void DS1306::resetMessageCount()
+{
+	spiMessages = 0;
+	spiErrors = 0;
+}
+#endif
+
 // Set the current time
 // Time set uses hours (when writeHours24 = true), hours12/ampm (when writeHours24 = false)
 void DS1306::setTime(const ds1306time *time)
 {
+	DS1306_STATS_ENTER(DS1306_API_SETTIME);
+
 	unsigned char buf[DS1306_SIZE_DATETIME];
 	encodeTimePacket(buf, time);
 	write(DS1306_DATETIME, buf, DS1306_SIZE_DATETIME);
@@ -61,18 +239,63 @@ void DS1306::setTime(const ds1306time *time)
 // Retrieve current time
 void DS1306::getTime(ds1306time *time)
 {
+	DS1306_STATS_ENTER(DS1306_API_GETTIME);
+
 	unsigned char buf[DS1306_SIZE_DATETIME];
 	memset(time, 0, sizeof(ds1306time));
 	read(DS1306_DATETIME, buf, DS1306_SIZE_DATETIME);
 	decodeTimePacket(buf, time);
 }
 
+// Retrieve current time without decoding, fields are decoded on access (see DS1306RawTime.h)
+void DS1306::getRawTime(DS1306RawTime *time)
+{
+	DS1306_STATS_ENTER(DS1306_API_GETRAWTIME);
+
+	read(DS1306_DATETIME, time->regs, DS1306_SIZE_DATETIME);
+}
+
+// Retrieve current time as seconds since 2000-01-01 00:00:00
+unsigned long DS1306::getEpoch()
+{
+	DS1306_STATS_ENTER(DS1306_API_GETEPOCH);
+
+	DS1306RawTime raw;
+	getRawTime(&raw);
+	return raw.getEpoch();
+}
+
+// Retrieve current time as a compact timestamp (see DS1306Stamp.h), ticks are always 0
+void DS1306::getStamp(ds1306stamp *stamp)
+{
+	DS1306_STATS_ENTER(DS1306_API_GETSTAMP);
+
+	DS1306RawTime raw;
+	getRawTime(&raw);
+	stamp->seconds = raw.getEpoch();
+	stamp->ticks = 0;
+}
+
+// Set current time from seconds since 2000-01-01 00:00:00
+// Hours are written in 24 or 12 hour form per writeHours24, day of week uses DS1306_SUNDAY = 1
+void DS1306::setEpoch(unsigned long epoch)
+{
+	DS1306_STATS_ENTER(DS1306_API_SETEPOCH);
+
+	DS1306RawTime raw;
+	raw.setEpoch(epoch, writeHours24);
+	write(DS1306_DATETIME, raw.regs, DS1306_SIZE_DATETIME);
+}
+
+#if DS1306_ALARMS
 // Set an alarm
 // alarm must be 0 or 1 else nothing is done
 // Time set uses hours (when writeHours24 = true), hours12/ampm (when writeHours24 = false)
 // Set any field (except ampm of course) to DS1306_ANY to indicate that alarm fires on any value in that field
 void DS1306::setAlarm(int alarm, const ds1306alarm *time)
 {
+	DS1306_STATS_ENTER(DS1306_API_SETALARM);
+
 	if (alarm < 2) {
 		unsigned char buf[DS1306_SIZE_ALARM];
 		encodeAlarmPacket(buf, time);
@@ -86,6 +309,8 @@ void DS1306::setAlarm(int alarm, const ds1306alarm *time)
 // in that field
 void DS1306::getAlarm(int alarm, ds1306alarm *time)
 {
+	DS1306_STATS_ENTER(DS1306_API_GETALARM);
+
 	memset(time, 0, sizeof(ds1306alarm));
 	if (alarm < 2) {
 		unsigned char buf[DS1306_SIZE_ALARM];
@@ -98,99 +323,123 @@ void DS1306::getAlarm(int alarm, ds1306alarm *time)
 // A true return means the alarm has triggered
 bool DS1306::getAlarmState(unsigned int alarm)
 {
+	DS1306_STATS_ENTER(DS1306_API_GETALARMSTATE);
+
 	if (alarm > 1) return false;
-	return ((read(DS1306_SR) & (1 << alarm)) ? true : false);
+	return ((readControl(DS1306_SR) & (1 << alarm)) ? true : false);
 }
 
 // Retrieve state of both alarms
 // true values indicate that the alarm has triggered
 void DS1306::getAlarmBothState(bool *state1, bool *state2)
 {
-	unsigned char sr = read(DS1306_SR);
+	DS1306_STATS_ENTER(DS1306_API_GETALARMBOTHSTATE);
+
+	unsigned char sr = readControl(DS1306_SR);
 	*state1 = (sr & 0x01) ? true : false;
 	*state2 = (sr & 0x02) ? true : false;
 }
 
 // Clear the state of an individual alarm where alarm = 0 or 1
+// SR is read only, the chip clears an alarm flag when any register of that alarm is accessed
+// so a single byte read of the alarm's last register is sufficient
 void DS1306::clearAlarmState(unsigned int alarm)
 {
+	DS1306_STATS_ENTER(DS1306_API_CLEARALARMSTATE);
+
 	if (alarm > 1) return;
 
-	write(DS1306_SR, read(DS1306_SR) & ~ (1 << alarm));
+	read((alarm == 0 ? DS1306_ALARM0 : DS1306_ALARM1) + DS1306_SIZE_ALARM - 1);
 }
 
 // Clear state of both alarms
+// Burst read across the last alarm 0 register and the first alarm 1 register clears both flags
 void DS1306::clearAlarmBothState()
 {
-	write(DS1306_SR, 0);
+	DS1306_STATS_ENTER(DS1306_API_CLEARALARMBOTHSTATE);
+
+	unsigned char buf[2];
+	read(DS1306_ALARM1 - 1, buf, 2);
 }
 
 // Returns the enabled state of an individual alarm where alarm = 0 or 1
 // A true return means the alarm is enabled
 bool DS1306::getAlarmEnabled(unsigned int alarm)
 {
+	DS1306_STATS_ENTER(DS1306_API_GETALARMENABLED);
+
 	if (alarm > 1) return false;
-	return((read(DS1306_CR) & (1 << alarm)) ? true : false);
+	return((readControl(DS1306_CR) & (1 << alarm)) ? true : false);
 }
 
 // Returns the alarm enablement state of both alarms (true = enabled, false = disabled)
 void DS1306::getAlarmBothEnabled(bool *enabled1, bool *enabled2)
 {
-	unsigned char cr = read(DS1306_CR);
+	DS1306_STATS_ENTER(DS1306_API_GETALARMBOTHENABLED);
+
+	unsigned char cr = readControl(DS1306_CR);
 	*enabled1 = (cr & 0x01) ? true : false;
-	*enabled2 = (cr & 0x01) ? true : false;
+	*enabled2 = (cr & 0x02) ? true : false;
 }
 
 // Enable an alarm where alarm = 0 or 1
 void DS1306::enableAlarm(unsigned int alarm)
 {
+	DS1306_STATS_ENTER(DS1306_API_ENABLEALARM);
+
 	if (alarm > 1) return;
-	write(DS1306_CR, read(DS1306_CR) | (1 << alarm));
+	writeControl(DS1306_CR, readControl(DS1306_CR) | (1 << alarm));
 }
 
 // Disable an alarm where alarm = 0 or 1
 void DS1306::disableAlarm(unsigned int alarm)
 {
+	DS1306_STATS_ENTER(DS1306_API_DISABLEALARM);
+
 	if (alarm > 1) return;
-	write(DS1306_CR, read(DS1306_CR) & ~ (1 << alarm));
+	writeControl(DS1306_CR, readControl(DS1306_CR) & ~ (1 << alarm));
 }
 
 // Enable both alarms
 void DS1306::enableBothAlarms()
 {
-	write(DS1306_CR, read(DS1306_CR) | 0x03);
+	DS1306_STATS_ENTER(DS1306_API_ENABLEBOTHALARMS);
+
+	writeControl(DS1306_CR, readControl(DS1306_CR) | 0x03);
 }
 
 // Disable both alarms
 void DS1306::disableBothAlarms()
 {
-	write(DS1306_CR, read(DS1306_CR) & ~ 0x03);
+	DS1306_STATS_ENTER(DS1306_API_DISABLEBOTHALARMS);
+
+	writeControl(DS1306_CR, readControl(DS1306_CR) & ~ 0x03);
 }
+#endif
 
+#if DS1306_TRICKLE
 // Enable trickle charging
 // Must provide number of diodes (1 or 2)
 // and KOhm resistance (2, 4 or 8)
 // Any other values will fail (false returned, no changes made)
 bool DS1306::enableTrickleCharge(unsigned char numDiodes, unsigned char kRes)
 {
-	if (numDiodes < 1 || numDiodes > 2) return false;
+	DS1306_STATS_ENTER(DS1306_API_ENABLETRICKLECHARGE);
 
-	unsigned char byte = 0xA0 | (numDiodes << 2);
-	switch(kRes) {
-		case 2	:	byte |= 0x01; break;
-		case 4	:	byte |= 0x02; break;
-		case 8	:	byte |= 0x03; break;
-		default	:	return false;
-	}
+	unsigned char byte;
+	if (!encodeTrickleByte(numDiodes, kRes, &byte)) return false;
 
-	write(DS1306_TCR, &byte, 1);
+	writeControl(DS1306_TCR, byte);
+	return true;
 }
 
 // Disable trickle charging
 void DS1306::disableTrickleCharge()
 {
+	DS1306_STATS_ENTER(DS1306_API_DISABLETRICKLECHARGE);
+
 	unsigned char byte = 0;
-	write(DS1306_TCR, &byte, 1);
+	writeControl(DS1306_TCR, byte);
 }
 
 // Retrieve trickle charging state
@@ -199,25 +448,51 @@ void DS1306::disableTrickleCharge()
 // When disabled numDiodes and kRes will be set to 0
 bool DS1306::getTrickleChargeState(unsigned char *numDiodes, unsigned char *kRes)
 {
-	unsigned char byte;
-	read(DS1306_TCR, &byte, 1);
+	DS1306_STATS_ENTER(DS1306_API_GETTRICKLECHARGESTATE);
 
-	*numDiodes = 0;
-	*kRes = 0;
-
-	if ((byte & 0xF0) != 0xA0) return false;	// TCR disabled
+	return decodeTrickleByte(readControl(DS1306_TCR), numDiodes, kRes);
+}
+#endif
 
-	switch(byte & 0x03) {
-		case 0x01	:	*kRes = 2; break;
-		case 0x02	:	*kRes = 4; break;
-		case 0x03	:	*kRes = 8; break;
-		default		:	return false;
+// Retrieve the complete device state (time, both alarms, CR, SR, TCR) in a single transaction
+// The burst starts at CR and wraps through the reserved registers to 0x00, so SR is captured
+// before the alarm registers are read. As with any alarm register access, reading the alarms
+// clears the alarm flags on the chip; the snapshot reports the flags as they were.
+void DS1306::getSnapshot(ds1306snapshot *snapshot)
+{
+	DS1306_STATS_ENTER(DS1306_API_GETSNAPSHOT);
+
+	unsigned char buf[DS1306_SIZE_SNAPSHOT];
+	memset(snapshot, 0, sizeof(ds1306snapshot));
+	read(DS1306_SNAPSHOT_START, buf, DS1306_SIZE_SNAPSHOT);
+
+	snapshot->cr = buf[DS1306_SNAPSHOT_OFFSET(DS1306_CR)];
+	snapshot->sr = buf[DS1306_SNAPSHOT_OFFSET(DS1306_SR)];
+	snapshot->tcr = buf[DS1306_SNAPSHOT_OFFSET(DS1306_TCR)];
+
+	decodeTimePacket(&buf[DS1306_SNAPSHOT_OFFSET(DS1306_DATETIME)], &snapshot->time);
+#if DS1306_ALARMS
+	decodeAlarmPacket(&buf[DS1306_SNAPSHOT_OFFSET(DS1306_ALARM0)], &snapshot->alarm0);
+	decodeAlarmPacket(&buf[DS1306_SNAPSHOT_OFFSET(DS1306_ALARM1)], &snapshot->alarm1);
+#endif
+
+	snapshot->alarmState0 = (snapshot->sr & (1 << DS1306_SR_IRQF0)) ? true : false;
+	snapshot->alarmState1 = (snapshot->sr & (1 << DS1306_SR_IRQF1)) ? true : false;
+	snapshot->alarmEnabled0 = (snapshot->cr & (1 << DS1306_CR_AIE0)) ? true : false;
+	snapshot->alarmEnabled1 = (snapshot->cr & (1 << DS1306_CR_AIE1)) ? true : false;
+	snapshot->oneHz = (snapshot->cr & (1 << DS1306_CR_1HZ)) ? true : false;
+	snapshot->writeProtected = (snapshot->cr & (1 << DS1306_CR_WP)) ? true : false;
+#if DS1306_TRICKLE
+	snapshot->trickleEnabled = decodeTrickleByte(snapshot->tcr, &snapshot->trickleDiodes, &snapshot->trickleKRes);
+#endif
+
+	// The snapshot holds the current control registers, so refill the cache for free
+	if (cacheEnabled) {
+		cache[DS1306_CACHE_CR] = snapshot->cr;
+		cache[DS1306_CACHE_SR] = snapshot->sr & ~((1 << DS1306_SR_IRQF0) | (1 << DS1306_SR_IRQF1));
+		cache[DS1306_CACHE_TCR] = snapshot->tcr;
+		cacheValid = (1 << DS1306_CACHE_SIZE) - 1;
 	}
-
-	// TCR is enabled if we got this far
-	*numDiodes = (byte & 0x0C) >> 2;
-
-	return true;
 }
 
 // Write num elements of user memory, starting at addr
@@ -225,6 +500,8 @@ bool DS1306::getTrickleChargeState(unsigned char *numDiodes, unsigned char *kRes
 // Will return true provided write is valid
 bool DS1306::writeUser(unsigned char addr, const char *buf, int num)
 {
+	DS1306_STATS_ENTER(DS1306_API_WRITEUSER);
+
 	if (addr >= DS1306_USER_START && addr < DS1306_USER_END && (addr + num - 1) <= DS1306_USER_END) {
 		write(addr, (const unsigned char *) buf, num);
 		return true;
@@ -238,6 +515,8 @@ bool DS1306::writeUser(unsigned char addr, const char *buf, int num)
 // Will return true provided read is valid
 bool DS1306::readUser(unsigned char addr, char *buf, int num)
 {
+	DS1306_STATS_ENTER(DS1306_API_READUSER);
+
 	memset(buf, 0, num);
 	if (addr >= DS1306_USER_START && addr < DS1306_USER_END && (addr + num - 1) <= DS1306_USER_END) {
 		read(addr, (unsigned char *) buf, num);
@@ -250,73 +529,265 @@ bool DS1306::readUser(unsigned char addr, char *buf, int num)
 // Returns true if DS1306 is write protected
 bool DS1306::isWriteProtected()
 {
-	return ((read(DS1306_CR) & (1 << DS1306_CR_WP)) ? true : false);
+	DS1306_STATS_ENTER(DS1306_API_ISWRITEPROTECTED);
+
+	return ((readControl(DS1306_CR) & (1 << DS1306_CR_WP)) ? true : false);
 }
 
 // Set's the write protection on (true) or off for the DS1306
 void DS1306::setWriteProtection(bool on)
 {
-	unsigned char cr = read(DS1306_CR);
+	DS1306_STATS_ENTER(DS1306_API_SETWRITEPROTECTION);
+
+	unsigned char cr = readControl(DS1306_CR);
 	if (on) {
 		cr |= (1 << DS1306_CR_WP);
 	} else {
 		cr &= ~ (1 << DS1306_CR_WP);
 	}
-	write(DS1306_CR, cr);
+	writeControl(DS1306_CR, cr);
 }
 
 // Get state of 1hz pin
 bool DS1306::get1HzState()
 {
-	unsigned char cr = read(DS1306_CR);
+	DS1306_STATS_ENTER(DS1306_API_GET1HZSTATE);
+
+	unsigned char cr = readControl(DS1306_CR);
 	return ((cr & (1 << DS1306_CR_1HZ)) ? true : false);
 }
 
 // Set state of 1hz pin
 void DS1306::set1HzState(bool enabled)
 {
-	unsigned char cr = read(DS1306_CR);
+	DS1306_STATS_ENTER(DS1306_API_SET1HZSTATE);
+
+	unsigned char cr = readControl(DS1306_CR);
 	if (enabled) {
 		cr |= (1 << DS1306_CR_1HZ);
 	} else {
 		cr &= ~ (1 << DS1306_CR_1HZ);
 	}
-	write(DS1306_CR, cr);
+	writeControl(DS1306_CR, cr);
 }
 
-// Reads len bytes from register in address into data
-void DS1306::read(unsigned char address, unsigned char *data, int len)
+// Enable the control register (CR, SR, TCR) shadow cache
+// Once a register has been read or written, getters are served from the cache with no bus traffic
+// and read-modify-write operations cost a single write. srPolicy selects how SR is treated, since
+// the chip sets the IRQF bits by itself:
+//   DS1306_CACHE_SR_LIVE    SR is always read from the chip (default)
+//   DS1306_CACHE_SR_CACHED  SR is served from the cache until refreshCache or invalidateCache is called
+void DS1306::enableCache(unsigned char srPolicy)
 {
-	// Take backup of SPCR
-	uint8_t spcr = SPCR;
+	cacheEnabled = true;
+	cacheSRPolicy = srPolicy;
+	cacheValid = 0;
+}
 
-	// Enable SPI as master, clock phase falling edge, CPOL idle low, MSB first, max rate, no interrupt
-	SPCR = (1 << SPE) | (1 << MSTR) | (1 << CPHA);
+// Disable the control register cache, all subsequent accesses go to the chip
+void DS1306::disableCache()
+{
+	cacheEnabled = false;
+	cacheValid = 0;
+}
 
-	// Select the DS1306 by raising it's chip enable line
-	digitalWrite(ce, HIGH);
+// Discard cached control registers, next access of each reads from the chip
+// Call after changing CR, SR or TCR other than through this class
+void DS1306::invalidateCache()
+{
+	cacheValid = 0;
+}
 
-	// Write the address to the SPI bus and wait for SPI write to copmlete
-	SPDR = address;
-	waitSPI();
+// Reload CR, SR and TCR into the cache with a single burst read
+void DS1306::refreshCache()
+{
+	DS1306_STATS_ENTER(DS1306_API_REFRESHCACHE);
 
-	// Write junk byte to finish the read
-	for (int i = 0; i < len; i++) {
-		SPDR = 0x00;
-		waitSPI();
-		data[i] = SPDR;
+	if (!cacheEnabled) return;
+
+	unsigned char buf[DS1306_CACHE_SIZE];
+	read(DS1306_CR, buf, DS1306_CACHE_SIZE);
+	memcpy(cache, buf, DS1306_CACHE_SIZE);
+	cacheValid = (1 << DS1306_CACHE_SIZE) - 1;
+}
+
+// Number of bus transactions avoided by the cache since the last reset
+unsigned long DS1306::getCacheSavedTransactions()
+{
+	return cacheSaved;
+}
+
+// Reset the cache savings counter
+void DS1306::resetCacheCounters()
+{
+	cacheSaved = 0;
+}
+
+// Set the SPI clock divider, one of DS1306_SPI_DIV2 (fastest) to DS1306_SPI_DIV128 (slowest)
+// Returns false, leaving the rate unchanged, for any other value
+// The soft SPI backend runs at the speed of its code and ignores the divider
+bool DS1306::setClockDivider(unsigned char divider)
+{
+	if (!selectClock(divider)) return false;
+
+#if DS1306_BUS == DS1306_BUS_AVR && !DS1306_SHARED_SPI
+	// Bus is not shared, so SPI is configured here rather than per transaction
+	busConfigure(false);
+#endif
+	return true;
+}
+
+// Current SPI clock divider
+unsigned char DS1306::getClockDivider()
+{
+	return spiDivider;
+}
+
+#if DS1306_STATS
+// Bus usage counters of one entry point (DS1306_API_xxx), zeroed if api is out of range
+void DS1306::getStats(unsigned char api, ds1306stats *stats)
+{
+	if (api >= DS1306_API_COUNT) {
+		memset(stats, 0, sizeof(ds1306stats));
+		return;
 	}
+	*stats = this->stats[api];
+}
 
-	// Deselect the DS1306 by lowering it's chip enable line
-	digitalWrite(ce, LOW);
+// Bus usage counters summed over every entry point
+void DS1306::getStatsTotal(ds1306stats *stats)
+{
+	memset(stats, 0, sizeof(ds1306stats));
+	for (unsigned char i = 0; i < DS1306_API_COUNT; i++) {
+		stats->calls += this->stats[i].calls;
+		stats->transactions += this->stats[i].transactions;
+		stats->selects += this->stats[i].selects;
+		stats->bytes += this->stats[i].bytes;
+		stats->waitLoops += this->stats[i].waitLoops;
+	}
+}
 
-	// Restore SPCR
-	SPCR = spcr;
+// Zero every bus usage counter
+void DS1306::resetStats()
+{
+	memset(stats, 0, sizeof(stats));
+}
+#endif
+
+// Record the SPI clock divider, working out the backend's settings once rather than per transaction
+bool DS1306::selectClock(unsigned char divider)
+{
+	// Dividers are the powers of two from 2 to 128
+	if (divider < DS1306_SPI_DIV2 || (divider & (divider - 1))) return false;
+	spiDivider = divider;
+
+#if DS1306_BUS == DS1306_BUS_AVR
+	// SPI2X doubles the rate selected by SPR1:SPR0 (fosc / 4, 16, 64, 128), except at fosc / 128
+	if (divider == DS1306_SPI_DIV128) {
+		spiRate = (1 << SPR1) | (1 << SPR0);
+	} else {
+		unsigned char spr = 0;
+		while (divider > DS1306_SPI_DIV4) {
+			divider >>= 2;
+			spr++;
+		}
+		spiRate = spr | ((divider == DS1306_SPI_DIV2) ? DS1306_RATE_2X : 0);
+	}
+#elif DS1306_BUS == DS1306_BUS_SPILIB || DS1306_BUS == DS1306_BUS_SPIDEV
+	spiClock = (DS1306_SPI_CLOCK * 4UL) / divider;
+#endif
+	return true;
+}
+
+// Read a control register (CR, SR or TCR), through the cache when enabled
+unsigned char DS1306::readControl(unsigned char address)
+{
+	unsigned char index = address - DS1306_CR;
+
+	if (cacheEnabled && (cacheValid & (1 << index)) &&
+		!(address == DS1306_SR && cacheSRPolicy == DS1306_CACHE_SR_LIVE)) {
+		cacheSaved++;
+		return cache[index];
+	}
+
+	unsigned char value = read(address);
+	if (cacheEnabled) {
+		cache[index] = value;
+		cacheValid |= (1 << index);
+	}
+	return value;
+}
+
+// Write a control register (CR or TCR), updating the cache when enabled
+// The chip ignores everything but the WP bit while write protected, the cache follows suit
+void DS1306::writeControl(unsigned char address, unsigned char value)
+{
+	unsigned char index = address - DS1306_CR;
+	unsigned char valid = cacheValid;
+
+	write(address, value);
+
+	if (cacheEnabled) {
+		cacheValid = valid;
+		if (!(cacheValid & (1 << DS1306_CACHE_CR))) {
+			// Write protection state unknown, cannot tell what the chip accepted
+			cacheValid &= ~(1 << index);
+		} else if (cache[DS1306_CACHE_CR] & (1 << DS1306_CR_WP)) {
+			if (address == DS1306_CR) {
+				cache[DS1306_CACHE_CR] = (cache[DS1306_CACHE_CR] & ~(1 << DS1306_CR_WP)) | (value & (1 << DS1306_CR_WP));
+			}
+		} else {
+			cache[index] = value;
+			cacheValid |= (1 << index);
+		}
+	}
+}
+
+// Keep the cache coherent with a raw register access
+// Writes overlapping the control registers invalidate them; any access to an alarm's registers
+// clears that alarm's IRQF bit in the chip, so the cached SR is updated to match
+void DS1306::cacheNoteAccess(unsigned char address, int len, bool write)
+{
+	if (!cacheEnabled) return;
+
+	int end = address + len;
+
+	if (write) {
+		for (unsigned char i = 0; i < DS1306_CACHE_SIZE; i++) {
+			if (address <= DS1306_CR + i && end > DS1306_CR + i) cacheValid &= ~(1 << i);
+		}
+	}
+	if (address < DS1306_ALARM0 + DS1306_SIZE_ALARM && end > DS1306_ALARM0) {
+		cache[DS1306_CACHE_SR] &= ~(1 << DS1306_SR_IRQF0);
+	}
+	if (address < DS1306_ALARM1 + DS1306_SIZE_ALARM && end > DS1306_ALARM1) {
+		cache[DS1306_CACHE_SR] &= ~(1 << DS1306_SR_IRQF1);
+	}
+}
+
+// Reads len bytes from register in address into data
+void DS1306::read(unsigned char address, unsigned char *data, int len)
+{
+	DS1306_STATS_ENTER(DS1306_API_READ);
+
+	cacheNoteAccess(address, len, false);
+
+	busBegin();
+
+	// Write the address to the SPI bus
+	busSend(address);
+
+	// Write junk bytes to finish the read
+	busReceive(data, len);
+
+	busEnd();
 }
 
 // Read a single byte register
 unsigned char DS1306::read(unsigned char address)
 {
+	DS1306_STATS_ENTER(DS1306_API_READ);
+
 	unsigned char buf;
 	read(address, &buf, 1);
 	return buf;
@@ -325,38 +796,119 @@ unsigned char DS1306::read(unsigned char address)
 // Write SPI to register "address" with specified data, bursting for the given length
 void DS1306::write(unsigned char address, const unsigned char *data, int len)
 {
-	// Take backup of SPCR
-	uint8_t spcr = SPCR;
+	DS1306_STATS_ENTER(DS1306_API_WRITE);
 
-	// Enable SPI as master, clock phase falling edge, CPOL idle low, MSB first, max rate, no interrupt
-	SPCR = (1 << SPE) | (1 << MSTR) | (1 << CPHA);
+	cacheNoteAccess(address, len, true);
 
-	// Select the DS1306 by raising it's chip enable line
-	digitalWrite(ce, HIGH);
+	busBegin();
 
-	// Write the address to the SPI bus (applying wirte offset automatically) and wait for SPI write to copmlete
-	SPDR = address | DS1306_WRITE_OFFSET;
-	waitSPI();
+	// Write the address to the SPI bus (applying write offset automatically)
+	busSend(address | DS1306_WRITE_OFFSET);
 
-	// Loop through all provided data and write to SPI bus
-	for (int i = 0; i < len; i++) {
-		SPDR = data[i];
-		waitSPI();
-	}
+	// Write all provided data to SPI bus
+	busSend(data, len);
 
-	// Deselect the DS1306 by lowering it's chip enable line
-	digitalWrite(ce, LOW);
-
-	// Restore SPCR
-	SPCR = spcr;
+	busEnd();
 }
 
 // Write a single byte register
 void DS1306::write(unsigned char address, const unsigned char value)
 {
+	DS1306_STATS_ENTER(DS1306_API_WRITE);
+
 	write(address, &value, 1);
 }
 
+#if DS1306_BUS_LOCK
+// Read len bytes from register in address into data, from any context including interrupt handlers
+// Runs at once if the bus is free, otherwise when the context holding it releases it, handler (if
+// given) being called from whichever context runs it. Returns false if the queue is full
+bool DS1306::requestRead(unsigned char address, unsigned char *data, int len, ds1306handler handler, void *context)
+{
+	return request(address, data, len, handler, context);
+}
+
+// Write len bytes from data to register in address, from any context, as requestRead
+bool DS1306::requestWrite(unsigned char address, const unsigned char *data, int len, ds1306handler handler, void *context)
+{
+	return request(address | DS1306_WRITE_OFFSET, (unsigned char *) data, len, handler, context);
+}
+
+// True while a transaction holds the bus
+bool DS1306::isBusLocked()
+{
+	return atomicLoad(&busLocked) ? true : false;
+}
+#endif
+
+// Burst read into two buffers in a single transaction, len1 bytes into data1 then len2 into data2
+void DS1306::readSplit(unsigned char address, unsigned char *data1, int len1, unsigned char *data2, int len2)
+{
+	cacheNoteAccess(address, len1 + len2, false);
+
+	busBegin();
+	busSend(address);
+	busReceive(data1, len1);
+	busReceive(data2, len2);
+	busEnd();
+}
+
+// Burst write from two buffers in a single transaction, len1 bytes from data1 then len2 from data2
+void DS1306::writeSplit(unsigned char address, const unsigned char *data1, int len1, const unsigned char *data2, int len2)
+{
+	cacheNoteAccess(address, len1 + len2, true);
+
+	busBegin();
+	busSend(address | DS1306_WRITE_OFFSET);
+	busSend(data1, len1);
+	busSend(data2, len2);
+	busEnd();
+}
+
+#if DS1306_TRICKLE
+// Encode a trickle charge register value enabling the charger
+// numDiodes must be 1 or 2 and kRes 2, 4 or 8, else false is returned and byte is untouched
+bool DS1306::encodeTrickleByte(unsigned char numDiodes, unsigned char kRes, unsigned char *byte)
+{
+	if (numDiodes < 1 || numDiodes > 2) return false;
+
+	unsigned char value = 0xA0 | (numDiodes << 2);
+	switch(kRes) {
+		case 2	:	value |= 0x01; break;
+		case 4	:	value |= 0x02; break;
+		case 8	:	value |= 0x03; break;
+		default	:	return false;
+	}
+
+	*byte = value;
+	return true;
+}
+
+// Decode a trickle charge register value
+// Returns true (Trickle enabled), false (Trickle disabled)
+// When enabled, numDiodes and kRes will be set to (1, 2) and (2, 4, 8) respectively
+// When disabled numDiodes and kRes will be set to 0
+bool DS1306::decodeTrickleByte(unsigned char byte, unsigned char *numDiodes, unsigned char *kRes)
+{
+	*numDiodes = 0;
+	*kRes = 0;
+
+	if ((byte & 0xF0) != 0xA0) return false;	// TCR disabled
+
+	switch(byte & 0x03) {
+		case 0x01	:	*kRes = 2; break;
+		case 0x02	:	*kRes = 4; break;
+		case 0x03	:	*kRes = 8; break;
+		default		:	return false;
+	}
+
+	// TCR is enabled if we got this far
+	*numDiodes = (byte & 0x0C) >> 2;
+
+	return true;
+}
+#endif
+
 // Encodes a time packet
 // CJB - need to extend 12 hour based encoding
 void DS1306::encodeTimePacket(unsigned char *buf, const ds1306time *time)
@@ -367,9 +919,10 @@ void DS1306::encodeTimePacket(unsigned char *buf, const ds1306time *time)
 	buf[3] = encodeBCD7(time->dow, 0x07);
 	buf[4] = encodeBCD7(time->day, 0x3F);
 	buf[5] = encodeBCD7(time->month, 0x3F);
-	buf[6] = encodeBCD8(time->year);
+	buf[6] = DS1306BCD::encode(time->year);
 }
 
+#if DS1306_ALARMS
 // Encode an alarm packet
 // CJB - need to extend 12 hour based encoding
 void DS1306::encodeAlarmPacket(unsigned char *buf, const ds1306alarm *alarm)
@@ -379,6 +932,7 @@ void DS1306::encodeAlarmPacket(unsigned char *buf, const ds1306alarm *alarm)
 	buf[2] = encodeHourByte(alarm->hours, alarm->hours12, alarm->ampm);
 	buf[3] = encodeBCD7(alarm->dow, 0x07);
 }
+#endif
 
 // Decode a time response from the DS1306
 void DS1306::decodeTimePacket(const unsigned char *buf, ds1306time *time)
@@ -389,9 +943,10 @@ void DS1306::decodeTimePacket(const unsigned char *buf, ds1306time *time)
 	time->dow = decodeBCD7(buf[3], 0x07);
 	time->day = decodeBCD7(buf[4], 0x3F);
 	time->month = decodeBCD7(buf[5], 0x3F);
-	time->year = decodeBCD8(buf[6]);
+	time->year = DS1306BCD::decode(buf[6]);
 }
 
+#if DS1306_ALARMS
 // Decodes an alarm response from the DS1306
 void DS1306::decodeAlarmPacket(const unsigned char *buf, ds1306alarm *alarm)
 {
@@ -400,8 +955,10 @@ void DS1306::decodeAlarmPacket(const unsigned char *buf, ds1306alarm *alarm)
 	decodeHourByte(buf[2], &(alarm->hours), &(alarm->hours12), &(alarm->ampm));
 	alarm->dow = decodeBCD7(buf[3], 0x07);
 }
+#endif
 
 // Encodes an hour byte using selected default format for write, honoring "ALL" (for alarms)
+// With a fixed DS1306_HOURS, writeHours24 is a constant and the unused form is compiled out
 unsigned char DS1306::encodeHourByte(unsigned char hour24, unsigned char hour12, char ampm)
 {
 	if ((writeHours24 && ((hour24 & DS1306_ANY))) || (!writeHours24 && (hour12 & DS1306_ANY))) {
@@ -419,6 +976,7 @@ unsigned char DS1306::encodeHourByte(unsigned char hour24, unsigned char hour12,
 // Decodes an hour byte, honoring "ALL" (for alarms)
 void DS1306::decodeHourByte(unsigned char hourByte, unsigned char *hour24, unsigned char *hour12, char *ampm)
 {
+#if DS1306_DECODE_12
 	if (hourByte & DS1306_ANY) {
 		*hour12 = DS1306_ANY;
 		*hour24 = DS1306_ANY;
@@ -458,47 +1016,687 @@ void DS1306::decodeHourByte(unsigned char hourByte, unsigned char *hour24, unsig
 			}
 		}
 	}
+#else
+	// Registers hold the 24 hour form, the 12 hour fields are not filled in
+	*hour24 = decodeBCD7(hourByte, 0x3F);
+	*hour12 = 0;
+	*ampm = 0;
+#endif
 }
 
-// Encode value as BCD
-unsigned char DS1306::encodeBCD7(unsigned char value)
+// Encode value as BCD, apply bitmask (AND)
+unsigned char DS1306::encodeBCD7(unsigned char value, unsigned char mask)
 {
-	return ((value & DS1306_ANY) ? DS1306_ANY : (((value / 10) << 4) | (value % 10)));
+	return ((value & DS1306_ANY) ? DS1306_ANY : DS1306BCD::encode(value) & mask);
 }
 
-// Encode value as BCD, apply bitmask (AND)
-unsigned char DS1306::encodeBCD7(unsigned char value, unsigned char mask)
+// Decode BCD after applying bitmask (AND)
+unsigned char DS1306::decodeBCD7(unsigned char value, unsigned char mask)
 {
-	return ((value & DS1306_ANY) ? DS1306_ANY : (((value / 10) << 4) | (value % 10)) & mask);
+	return ((value & DS1306_ANY) ? DS1306_ANY : DS1306BCD::decode(value & mask));
 }
 
-// Encode value as BCD, full 8 bits
-unsigned char DS1306::encodeBCD8(unsigned char value)
+#if DS1306_BUS != DS1306_BUS_HOST && DS1306_BUS != DS1306_BUS_SPIDEV
+#if DS1306_FIXED_CE
+// Chip enable through the port and bit fixed at compile time
+#define DS1306_CE_HIGH()		(DS1306_CE_PORT |= (1 << DS1306_CE_BIT))
+#define DS1306_CE_LOW()			(DS1306_CE_PORT &= ~(1 << DS1306_CE_BIT))
+#elif DS1306_FAST_PINS
+// Chip enable through the port register resolved in init
+#define DS1306_CE_HIGH()		(*cePort |= ceMask)
+#define DS1306_CE_LOW()			(*cePort &= ~ceMask)
+#else
+#define DS1306_CE_HIGH()		digitalWrite(ce, HIGH)
+#define DS1306_CE_LOW()			digitalWrite(ce, LOW)
+#endif
+#endif
+
+#if DS1306_BUS == DS1306_BUS_AVR
+// Initialize hardware SPI pins and the chip enable line
+void DS1306::busInit()
 {
-	return (((value / 10) << 4) | (value % 10));
+	// Initialize SPI Bus
+	pinMode(MOSI, OUTPUT);
+	pinMode(MISO, INPUT);
+	pinMode(SCK, OUTPUT);
+	pinMode(SS, OUTPUT);
+
+	// Initialize the chip enable, LOW
+	pinMode(ce, OUTPUT);
+	digitalWrite(ce, LOW);
+#if !DS1306_FIXED_CE
+	cePort = portOutputRegister(digitalPinToPort(ce));
+	ceMask = digitalPinToBitMask(ce);
+#endif
+
+#if !DS1306_SHARED_SPI
+	// Bus is not shared, configure SPI once
+	busConfigure(false);
+#endif
 }
 
-// Decode BCD
-unsigned char DS1306::decodeBCD7(unsigned char value)
+// Enable SPI as master, clock phase falling edge, CPOL idle low, MSB first, at the selected rate
+void DS1306::busConfigure(bool interrupt)
 {
-	return ((value & DS1306_ANY) ? DS1306_ANY : ((((value & 0xF0) >> 4) * 10) + (value & 0x0F)));
+	SPCR = (1 << SPE) | (1 << MSTR) | (1 << CPHA) | (spiRate & 0x03) | (interrupt ? (1 << SPIE) : 0);
+	SPSR = (spiRate & DS1306_RATE_2X) ? (1 << SPI2X) : 0;
 }
 
-unsigned char DS1306::decodeBCD7(unsigned char value, unsigned char mask)
+// Configure the SPI bus for the DS1306
+void DS1306::busAcquire()
+{
+	DS1306_STATS_COUNT(transactions);
+#if DS1306_SHARED_SPI
+	// Take backup of SPCR and SPSR (only SPI2X is writable)
+	spcr = SPCR;
+	spsr = SPSR;
+
+	busConfigure(false);
+#endif
+}
+
+// Select the DS1306 by raising it's chip enable line
+void DS1306::busSelect()
+{
+	DS1306_STATS_COUNT(selects);
+	DS1306_CE_HIGH();
+}
+
+// Clock a single byte in and out of the SPI bus
+unsigned char DS1306::busTransfer(unsigned char value)
 {
+	DS1306_STATS_COUNT(bytes);
+	SPDR = value;
+	waitSPI();
+	return SPDR;
+}
 
-	return ((value & DS1306_ANY) ? DS1306_ANY : decodeBCD7(value & mask));
+// Deselect the DS1306 by lowering it's chip enable line
+void DS1306::busDeselect()
+{
+	DS1306_CE_LOW();
 }
 
-// Decode BCD, full 8 bits
-unsigned char DS1306::decodeBCD8(unsigned char value)
+// Restore the SPI bus configuration
+void DS1306::busRelease()
 {
-	return ((((value & 0xF0) >> 4) * 10) + (value & 0x0F));
+#if DS1306_SHARED_SPI
+	// Restore SPCR and SPSR
+	SPCR = spcr;
+	SPSR = spsr;
+#endif
 }
 
 // Wait for SPI transaction to finish
 void DS1306::waitSPI()
 {
-	while(!(SPSR & (1<<SPIF))) { };
+	while(!(SPSR & (1<<SPIF))) {
+		DS1306_STATS_COUNT(waitLoops);
+	};
 }
+#elif DS1306_BUS == DS1306_BUS_SPILIB
+// Initialize the SPI library and the chip enable line
+void DS1306::busInit()
+{
+	SPI.begin();
 
+	pinMode(ce, OUTPUT);
+	digitalWrite(ce, LOW);
+#if DS1306_FAST_PINS && !DS1306_FIXED_CE
+	cePort = portOutputRegister(digitalPinToPort(ce));
+	ceMask = digitalPinToBitMask(ce);
+#endif
+}
+
+// Claim the SPI bus, mode 1 (CPOL idle low, CPHA falling edge sample), MSB first
+void DS1306::busAcquire()
+{
+	DS1306_STATS_COUNT(transactions);
+	SPI.beginTransaction(SPISettings(spiClock, MSBFIRST, SPI_MODE1));
+}
+
+// Select the DS1306 by raising it's chip enable line
+void DS1306::busSelect()
+{
+	DS1306_STATS_COUNT(selects);
+	DS1306_CE_HIGH();
+}
+
+// Clock a single byte in and out of the SPI bus
+unsigned char DS1306::busTransfer(unsigned char value)
+{
+	DS1306_STATS_COUNT(bytes);
+	return SPI.transfer(value);
+}
+
+// Deselect the DS1306 by lowering it's chip enable line
+void DS1306::busDeselect()
+{
+	DS1306_CE_LOW();
+}
+
+// Release the SPI bus
+void DS1306::busRelease()
+{
+	SPI.endTransaction();
+}
+#elif DS1306_BUS == DS1306_BUS_SOFT
+#if DS1306_FAST_PINS
+#define DS1306_SCK_HIGH()		(*sckPort |= sckMask)
+#define DS1306_SCK_LOW()		(*sckPort &= ~sckMask)
+#define DS1306_MOSI_HIGH()		(*mosiPort |= mosiMask)
+#define DS1306_MOSI_LOW()		(*mosiPort &= ~mosiMask)
+#define DS1306_MISO_READ()		(*misoPin & misoMask)
+#else
+#define DS1306_SCK_HIGH()		digitalWrite(DS1306_SOFT_SCK, HIGH)
+#define DS1306_SCK_LOW()		digitalWrite(DS1306_SOFT_SCK, LOW)
+#define DS1306_MOSI_HIGH()		digitalWrite(DS1306_SOFT_MOSI, HIGH)
+#define DS1306_MOSI_LOW()		digitalWrite(DS1306_SOFT_MOSI, LOW)
+#define DS1306_MISO_READ()		digitalRead(DS1306_SOFT_MISO)
+#endif
+
+// Initialize the bit-banged SPI lines and the chip enable line
+void DS1306::busInit()
+{
+	pinMode(DS1306_SOFT_SCK, OUTPUT);
+	pinMode(DS1306_SOFT_MOSI, OUTPUT);
+	pinMode(DS1306_SOFT_MISO, INPUT);
+	digitalWrite(DS1306_SOFT_SCK, LOW);
+
+	pinMode(ce, OUTPUT);
+	digitalWrite(ce, LOW);
+#if DS1306_FAST_PINS
+#if !DS1306_FIXED_CE
+	cePort = portOutputRegister(digitalPinToPort(ce));
+	ceMask = digitalPinToBitMask(ce);
+#endif
+	sckPort = portOutputRegister(digitalPinToPort(DS1306_SOFT_SCK));
+	sckMask = digitalPinToBitMask(DS1306_SOFT_SCK);
+	mosiPort = portOutputRegister(digitalPinToPort(DS1306_SOFT_MOSI));
+	mosiMask = digitalPinToBitMask(DS1306_SOFT_MOSI);
+	misoPin = portInputRegister(digitalPinToPort(DS1306_SOFT_MISO));
+	misoMask = digitalPinToBitMask(DS1306_SOFT_MISO);
+#endif
+}
+
+// Nothing to configure, the bit-banged lines belong to the DS1306
+void DS1306::busAcquire()
+{
+	DS1306_STATS_COUNT(transactions);
+}
+
+// Select the DS1306 by raising it's chip enable line
+void DS1306::busSelect()
+{
+	DS1306_STATS_COUNT(selects);
+	DS1306_CE_HIGH();
+}
+
+// Clock a single byte in and out, mode 1 (CPOL idle low, CPHA falling edge sample), MSB first
+// The DS1306 shifts out on the rising edge and samples on the falling edge
+unsigned char DS1306::busTransfer(unsigned char value)
+{
+	DS1306_STATS_COUNT(bytes);
+	unsigned char in = 0;
+	for (unsigned char mask = 0x80; mask; mask >>= 1) {
+		DS1306_SCK_HIGH();
+		if (value & mask) {
+			DS1306_MOSI_HIGH();
+		} else {
+			DS1306_MOSI_LOW();
+		}
+		if (DS1306_MISO_READ()) in |= mask;
+		DS1306_SCK_LOW();
+	}
+	return in;
+}
+
+// Deselect the DS1306 by lowering it's chip enable line
+void DS1306::busDeselect()
+{
+	DS1306_CE_LOW();
+}
+
+// Nothing to release
+void DS1306::busRelease()
+{
+}
+#elif DS1306_BUS == DS1306_BUS_SPIDEV
+// Open the spidev device for chip select ce, mode 1 (CPOL idle low, CPHA falling edge sample) with
+// chip select active high, as the DS1306 chip enable is
+// Nothing is opened when an emulator is attached
+void DS1306::busInit()
+{
+	if (emulator || spiFd >= 0) return;
+
+	char path[32];
+	if (!spiPath) {
+		snprintf(path, sizeof(path), "/dev/spidev%d.%d", DS1306_SPIDEV_BUS, ce);
+	}
+
+	spiFd = open(spiPath ? spiPath : path, O_RDWR);
+	if (spiFd < 0) return;
+
+	unsigned char mode = SPI_MODE_1 | SPI_CS_HIGH;
+	unsigned char bits = 8;
+	unsigned int speed = spiClock;
+	if (ioctl(spiFd, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(spiFd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+		ioctl(spiFd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+		close(spiFd);
+		spiFd = -1;
+	}
+}
+
+// The kernel arbitrates the bus per message, nothing to claim
+void DS1306::busAcquire()
+{
+	DS1306_STATS_COUNT(transactions);
+}
+
+// Chip enable is asserted by the kernel as the queued segments are sent
+void DS1306::busSelect()
+{
+	DS1306_STATS_COUNT(selects);
+}
+
+// Clock a single byte in and out, sending the queued message so the received byte is known
+unsigned char DS1306::busTransfer(unsigned char value)
+{
+	DS1306_STATS_COUNT(bytes);
+	busSegment(&value, &spiLast, 1);
+	busFlush();
+	return spiLast;
+}
+
+// Queue a byte to send
+void DS1306::busSend(unsigned char value)
+{
+	busSend(&value, 1);
+}
+
+// Queue bytes to send, copying them so the caller's buffer may be reused at once
+// Consecutive sends within a transaction share one segment
+void DS1306::busSend(const unsigned char *data, int len)
+{
+	DS1306_STATS_ADD(bytes, len);
+
+	while (len > 0) {
+		// Sent before copying, as the queued segments point into spiTx
+		if (spiTxUsed == DS1306_SPIDEV_BUFFER || spiSegmentCount == DS1306_SPIDEV_SEGMENTS) busFlush();
+
+		int room = DS1306_SPIDEV_BUFFER - spiTxUsed;
+		int chunk = (len < room) ? len : room;
+		unsigned char *tx = &spiTx[spiTxUsed];
+		memcpy(tx, data, chunk);
+		spiTxUsed += chunk;
+
+		struct spi_ioc_transfer *last = spiSegmentCount ? &spiSegments[spiSegmentCount - 1] : 0;
+		if (last && !last->rx_buf && !last->cs_change && last->tx_buf + last->len == (uintptr_t) tx) {
+			last->len += chunk;
+		} else {
+			busSegment(tx, 0, chunk);
+		}
+		data += chunk;
+		len -= chunk;
+	}
+}
+
+// Queue bytes to receive straight into data, sending zeros
+// The message is sent no later than the end of the transaction
+void DS1306::busReceive(unsigned char *data, int len)
+{
+	DS1306_STATS_ADD(bytes, len);
+
+	if (len <= 0) return;
+	busSegment(0, data, len);
+	spiReceiving = true;
+}
+
+// End the transaction at the last queued segment, sending the message unless the transaction
+// only wrote and a batch is open
+void DS1306::busDeselect()
+{
+	// Chip enable was held over from a message sent part way through the transaction
+	if (!spiSegmentCount && spiHeld) busSegment(0, 0, 0);
+
+	if (spiSegmentCount) spiSegments[spiSegmentCount - 1].cs_change = 1;
+	if (!spiBatching || spiReceiving) busFlush();
+}
+
+// Nothing to release
+void DS1306::busRelease()
+{
+}
+
+// Append a segment to the queued message, sending the message first if it is full
+// While queued, cs_change marks the last segment of a transaction
+void DS1306::busSegment(const unsigned char *tx, unsigned char *rx, int len)
+{
+	if (spiSegmentCount == DS1306_SPIDEV_SEGMENTS) busFlush();
+
+	struct spi_ioc_transfer *segment = &spiSegments[spiSegmentCount++];
+	memset(segment, 0, sizeof(struct spi_ioc_transfer));
+	segment->tx_buf = (uintptr_t) tx;
+	segment->rx_buf = (uintptr_t) rx;
+	segment->len = len;
+	segment->speed_hz = spiClock;
+	segment->bits_per_word = 8;
+}
+
+// Send the queued message as one SPI_IOC_MESSAGE, or replay it on the attached emulator
+// Returns false if the kernel rejected it, the bytes to receive are then left as they were
+bool DS1306::busFlush()
+{
+	if (!spiSegmentCount) return true;
+
+	struct spi_ioc_transfer *last = &spiSegments[spiSegmentCount - 1];
+	bool held = !last->cs_change;
+	bool sent;
+
+	if (emulator) {
+		emulator->setClockDivider(spiDivider);
+		for (unsigned char i = 0; i < spiSegmentCount; i++) {
+			struct spi_ioc_transfer *segment = &spiSegments[i];
+			const unsigned char *tx = (const unsigned char *) (uintptr_t) segment->tx_buf;
+			unsigned char *rx = (unsigned char *) (uintptr_t) segment->rx_buf;
+
+			if (!spiHeld) emulator->select();
+			for (unsigned int j = 0; j < segment->len; j++) {
+				unsigned char value = emulator->transfer(tx ? tx[j] : 0x00);
+				if (rx) rx[j] = value;
+			}
+			spiHeld = !segment->cs_change;
+			if (!spiHeld) emulator->deselect();
+		}
+		sent = true;
+	} else {
+		// The kernel reads cs_change as deselect after a segment, except on the last, where it means
+		// leave chip enable asserted after the message
+		last->cs_change = held;
+		sent = spiFd >= 0 && ioctl(spiFd, SPI_IOC_MESSAGE(spiSegmentCount), spiSegments) >= 0;
+		spiHeld = held;
+	}
+
+	spiMessages++;
+	if (!sent) {
+		spiErrors++;
+		spiFailed = true;
+	}
+	spiSegmentCount = 0;
+	spiTxUsed = 0;
+	spiReceiving = false;
+	return sent;
+}
+#else
+// Divider of the emulated SPI clock, shared by every emulated chip as a real bus's SCK would be
+static unsigned char hostDivider = DS1306_SPI_DIVIDER;
+
+// Nothing to initialize, the emulator must have been attached
+void DS1306::busInit()
+{
+}
+
+// Set the emulated bus clock rate
+void DS1306::busAcquire()
+{
+	DS1306_STATS_COUNT(transactions);
+	hostDivider = spiDivider;
+}
+
+// Begin a transaction on the emulated chip, telling it the clock rate, which it may be set to reject
+void DS1306::busSelect()
+{
+	DS1306_STATS_COUNT(selects);
+	emulator->setClockDivider(hostDivider);
+	emulator->select();
+}
+
+// Clock a single byte in and out of the emulated chip
+unsigned char DS1306::busTransfer(unsigned char value)
+{
+	DS1306_STATS_COUNT(bytes);
+	return emulator->transfer(value);
+}
+
+// End a transaction on the emulated chip
+void DS1306::busDeselect()
+{
+	emulator->deselect();
+}
+
+// Nothing to release on the emulated bus
+void DS1306::busRelease()
+{
+}
+#endif
+
+// Begin a transaction, configuring the bus and selecting the DS1306
+void DS1306::busBegin()
+{
+	busClaim();
+	busSelect();
+}
+
+// End a transaction, deselecting the DS1306 and releasing the bus
+void DS1306::busEnd()
+{
+	busDeselect();
+	busFree();
+}
+
+// Take the bus, waiting while another context holds the lock, and configure it for the DS1306
+void DS1306::busClaim()
+{
+#if DS1306_BUS_LOCK
+	// Only another thread or core can release the lock while this waits, which is why interrupt
+	// handlers must use requestRead / requestWrite rather than the methods that come here
+	while (!busTryLock()) {
+	}
+#endif
+	busAcquire();
+}
+
+// Release the bus, then run any requests queued while it was held
+void DS1306::busFree()
+{
+	busRelease();
+#if DS1306_BUS_LOCK
+	busUnlock();
+#endif
+}
+
+#if DS1306_BUS_LOCK
+// Take the bus lock if it is free, never waiting
+bool DS1306::busTryLock()
+{
+	return atomicSwap(&busLocked, 0, 1);
+}
+
+// Release the bus lock and run whatever was queued meanwhile
+void DS1306::busUnlock()
+{
+	atomicStore(&busLocked, 0);
+	busDrain();
+}
+
+// Run queued requests in order, taking the lock for each and calling its handler once released
+// Stops at a request still being filled in, its requester runs the queue once it is complete,
+// and when the lock is held, leaving the queue to the holder as it releases the lock
+void DS1306::busDrain()
+{
+	for (;;) {
+		if (!atomicLoad(&deferQueue[atomicLoad(&deferTail) & (DS1306_DEFER_QUEUE - 1)].ready)) return;
+		if (!busTryLock()) return;
+
+		// Only the lock holder moves the tail, but another may have run the request since it was seen
+		unsigned char tail = deferTail;
+		deferred *slot = &deferQueue[tail & (DS1306_DEFER_QUEUE - 1)];
+		deferred job;
+		bool run = atomicLoad(&slot->ready);
+		if (run) {
+			job.rtc = slot->rtc;
+			job.address = slot->address;
+			job.data = slot->data;
+			job.len = slot->len;
+			job.handler = slot->handler;
+			job.context = slot->context;
+
+			// Free the slot before moving the tail past it, requesters take slots behind the tail
+			atomicStore(&slot->ready, 0);
+			atomicStore(&deferTail, tail + 1);
+			job.rtc->busRun(&job);
+		}
+		atomicStore(&busLocked, 0);
+
+		if (run && job.handler) job.handler(job.context);
+	}
+}
+
+// Queue a request, then run the queue if the bus is free
+// Returns false if the queue is full
+bool DS1306::request(unsigned char address, unsigned char *data, int len, ds1306handler handler, void *context)
+{
+	// Reserve the slot at the head, another requester may take it first
+	unsigned char head;
+	do {
+		head = atomicLoad(&deferHead);
+		if ((unsigned char) (head - atomicLoad(&deferTail)) >= DS1306_DEFER_QUEUE) return false;
+	} while (!atomicSwap(&deferHead, head, head + 1));
+
+	deferred *slot = &deferQueue[head & (DS1306_DEFER_QUEUE - 1)];
+	slot->rtc = this;
+	slot->address = address;
+	slot->data = data;
+	slot->len = len;
+	slot->handler = handler;
+	slot->context = context;
+	atomicStore(&slot->ready, 1);
+
+	busDrain();
+	return true;
+}
+
+// Run a request taken from the queue, the lock being held
+void DS1306::busRun(const deferred *job)
+{
+	bool write = (job->address & DS1306_WRITE_OFFSET) ? true : false;
+
+	cacheNoteAccess(job->address & ~DS1306_WRITE_OFFSET, job->len, write);
+
+	busAcquire();
+	busSelect();
+	busSend(job->address);
+	if (write) {
+		busSend(job->data, job->len);
+	} else {
+		busReceive(job->data, job->len);
+	}
+	busDeselect();
+	busRelease();
+}
+#endif
+
+#if DS1306_BUS != DS1306_BUS_SPIDEV
+// Clock out a byte, discarding the byte received
+void DS1306::busSend(unsigned char value)
+{
+	busTransfer(value);
+}
+
+// Clock out len bytes from data, discarding the bytes received
+void DS1306::busSend(const unsigned char *data, int len)
+{
+	for (int i = 0; i < len; i++) {
+		busTransfer(data[i]);
+	}
+}
+
+// Clock in len bytes to data, sending zeros
+void DS1306::busReceive(unsigned char *data, int len)
+{
+	for (int i = 0; i < len; i++) {
+		data[i] = busTransfer(0x00);
+	}
+}
+#endif
+
+#if DS1306_BUS == DS1306_BUS_AVR
+// Begin an asynchronous transaction, optionally enabling the SPI transfer complete interrupt
+void DS1306::asyncBegin(bool interrupt)
+{
+#if DS1306_SHARED_SPI
+	// Take backup of SPCR and SPSR
+	spcr = SPCR;
+	spsr = SPSR;
+#endif
+
+	busConfigure(interrupt);
+	DS1306_CE_HIGH();
+
+	DS1306_STATS_COUNT(transactions);
+	DS1306_STATS_COUNT(selects);
+}
+
+// Start clocking a byte, returns immediately
+void DS1306::asyncStart(unsigned char value)
+{
+	DS1306_STATS_COUNT(bytes);
+	SPDR = value;
+}
+
+// True once the byte started by asyncStart has been clocked
+bool DS1306::asyncReady()
+{
+	return (SPSR & (1 << SPIF)) ? true : false;
+}
+
+// Byte received during the last completed transfer
+unsigned char DS1306::asyncResult()
+{
+	return SPDR;
+}
+
+// End an asynchronous transaction, lowering chip enable and restoring the SPI bus configuration
+void DS1306::asyncEnd()
+{
+	DS1306_CE_LOW();
+
+#if DS1306_SHARED_SPI
+	SPCR = spcr;
+	SPSR = spsr;
+#else
+	busConfigure(false);
+#endif
+}
+#else
+// Backends without a transfer complete interrupt clock each byte synchronously when started,
+// so every transfer is complete by the time the engine services it and there is no interrupt to enable
+void DS1306::asyncBegin(bool)
+{
+	busBegin();
+}
+
+// Clock a byte, holding the result for asyncResult
+void DS1306::asyncStart(unsigned char value)
+{
+	asyncLast = busTransfer(value);
+}
+
+// Transfers complete in asyncStart
+bool DS1306::asyncReady()
+{
+	return true;
+}
+
+// Byte received during the last transfer
+unsigned char DS1306::asyncResult()
+{
+	return asyncLast;
+}
+
+// End an asynchronous transaction
+void DS1306::asyncEnd()
+{
+	busEnd();
+}
+#endif
@@ -34,10 +34,34 @@
  *			Per specification, writing illogical values will result in undefined behavior.
  *
  *			Full details on the operation and use of each method can be found in DS1306.cpp
+ *
+ *			The hour form, 12 hour decoding, the alarm and trickle charge API and the chip enable line
+ *			can be fixed or removed at compile time to save flash and RAM, see DS1306Config.h.
+ *
+ *			All SPI traffic passes through the bus primitives busBegin / busTransfer / busEnd, implemented
+ *			by the backend selected at compile time in DS1306Config.h. When built outside of the Arduino
+ *			environment (ARDUINO not defined) these drive a DS1306Emulator, which must be attached using
+ *			attach() before init() is called. See DS1306Emulator.h.
+ *
+ *			With DS1306_BUS_SPIDEV the DS1306 is driven through Linux spidev, each transaction being sent
+ *			as one SPI_IOC_MESSAGE ioctl. Between beginBatch() and endBatch(), writes are held back and
+ *			sent together with the next read, or at endBatch(), so a run of register updates costs one
+ *			system call. A DS1306Emulator attached before init() stands in for the device.
+ *
+ *			With DS1306_BUS_LOCK set, each transaction holds a bus lock shared by all DS1306 objects.
+ *			Interrupt handlers use requestRead() / requestWrite(), which never wait: if the bus is busy
+ *			the request is queued and run by the interrupted code as it releases the bus, then its
+ *			handler is called. Other methods wait for the lock, so must not be called from interrupt
+ *			handlers. DS1306Async transactions on the AVR backend do not take the lock.
  */
 #ifndef __DS1306_RTC_
 #define __DS1306_RTC_
 
+#include "DS1306Config.h"
+#if DS1306_BUS == DS1306_BUS_SPIDEV
+#include <linux/spi/spidev.h>
+#endif
+
 /* Memory Locations */
 #define DS1306_DATETIME			0x00
 #define DS1306_ALARM0			0x07
@@ -52,6 +76,11 @@
 #define DS1306_SIZE_DATETIME	7
 #define DS1306_SIZE_ALARM		4
 
+/* Device snapshot, a single burst from CR wrapping through the clock register space */
+#define DS1306_SNAPSHOT_START	DS1306_CR
+#define DS1306_SIZE_SNAPSHOT	32
+#define DS1306_SNAPSHOT_OFFSET(reg)	(((reg) - DS1306_SNAPSHOT_START) & 0x1F)
+
 /* Bit Position of key register parameters (CR) */
 #define DS1306_CR_WP			6
 #define DS1306_CR_1HZ			2
@@ -67,6 +96,9 @@
 #define DS1306_TCR_DS			3
 #define DS1306_TCR_RS			1
 
+/* Largest epoch (seconds since 2000-01-01 00:00:00), 2099-12-31 23:59:59 */
+#define DS1306_EPOCH_MAX		3155759999UL
+
 /* Days of week (suggested, see spec) */
 #define DS1306_SUNDAY			1
 #define DS1306_MONDAY			2
@@ -82,6 +114,72 @@
 /* Write offset used when writing DS1306 registers */
 #define DS1306_WRITE_OFFSET		0x80
 
+/* Status register policies for the control register cache */
+#define DS1306_CACHE_SR_LIVE	0		// SR is always read from the chip
+#define DS1306_CACHE_SR_CACHED	1		// SR is served from cache until refreshed
+
+/* Control register cache layout (CR, SR, TCR are contiguous) */
+#define DS1306_CACHE_CR			0
+#define DS1306_CACHE_SR			1
+#define DS1306_CACHE_TCR		2
+#define DS1306_CACHE_SIZE		3
+
+/* SPI clock dividers for setClockDivider, the SPI clock is fosc / divider on AVR */
+#define DS1306_SPI_DIV2			2
+#define DS1306_SPI_DIV4			4
+#define DS1306_SPI_DIV8			8
+#define DS1306_SPI_DIV16		16
+#define DS1306_SPI_DIV32		32
+#define DS1306_SPI_DIV64		64
+#define DS1306_SPI_DIV128		128
+
+#if DS1306_STATS
+/* Instrumented entry points, traffic is attributed to the outermost public method called */
+#define DS1306_API_OTHER				0		// Bus use from outside a public method (helper classes)
+#define DS1306_API_INIT					1
+#define DS1306_API_SETTIME				2
+#define DS1306_API_GETTIME				3
+#define DS1306_API_GETRAWTIME			4
+#define DS1306_API_GETEPOCH				5
+#define DS1306_API_SETEPOCH				6
+#define DS1306_API_SETALARM				7
+#define DS1306_API_GETALARM				8
+#define DS1306_API_GETALARMSTATE		9
+#define DS1306_API_GETALARMBOTHSTATE	10
+#define DS1306_API_CLEARALARMSTATE		11
+#define DS1306_API_CLEARALARMBOTHSTATE	12
+#define DS1306_API_GETALARMENABLED		13
+#define DS1306_API_GETALARMBOTHENABLED	14
+#define DS1306_API_ENABLEALARM			15
+#define DS1306_API_DISABLEALARM			16
+#define DS1306_API_ENABLEBOTHALARMS		17
+#define DS1306_API_DISABLEBOTHALARMS	18
+#define DS1306_API_GET1HZSTATE			19
+#define DS1306_API_SET1HZSTATE			20
+#define DS1306_API_ENABLETRICKLECHARGE	21
+#define DS1306_API_DISABLETRICKLECHARGE	22
+#define DS1306_API_GETTRICKLECHARGESTATE	23
+#define DS1306_API_GETSNAPSHOT			24
+#define DS1306_API_WRITEUSER			25
+#define DS1306_API_READUSER				26
+#define DS1306_API_ISWRITEPROTECTED		27
+#define DS1306_API_SETWRITEPROTECTION	28
+#define DS1306_API_REFRESHCACHE			29
+#define DS1306_API_READ					30
+#define DS1306_API_WRITE				31
+#define DS1306_API_GETSTAMP				32
+#define DS1306_API_COUNT				33
+
+/* Bus usage counters */
+typedef struct {
+	unsigned long calls;			// Calls of the entry point
+	unsigned long transactions;		// Bus acquisitions (SPCR setup or SPI transaction)
+	unsigned long selects;			// Chip enable assertions
+	unsigned long bytes;			// Bytes clocked, including address bytes
+	unsigned long waitLoops;		// Polls of SPIF while waiting for a byte (AVR backend)
+} ds1306stats;
+#endif
+
 /* Representation of the current time/date */
 typedef struct {
 	unsigned char seconds;
@@ -95,6 +193,12 @@ typedef struct {
 	unsigned char year;
 } ds1306time;
 
+/* Compact timestamp, stored in 4 bytes (5 with ticks) by DS1306Stamp */
+typedef struct {
+	unsigned long seconds;		// Seconds since 2000-01-01 00:00:00
+	unsigned char ticks;		// 1/256 seconds, 0 when the source has no sub-second time
+} ds1306stamp;
+
 /* Representation of an alarm */
 typedef struct {
 	unsigned char seconds;
@@ -105,21 +209,90 @@ typedef struct {
 	unsigned char dow;
 } ds1306alarm;
 
+/* Complete device state, as returned by getSnapshot */
+typedef struct {
+	ds1306time time;
+	ds1306alarm alarm0;
+	ds1306alarm alarm1;
+	bool alarmState0;			// Alarm 0 has triggered (IRQF0)
+	bool alarmState1;			// Alarm 1 has triggered (IRQF1)
+	bool alarmEnabled0;			// Alarm 0 interrupt enabled (AIE0)
+	bool alarmEnabled1;			// Alarm 1 interrupt enabled (AIE1)
+	bool oneHz;					// 1Hz output enabled
+	bool writeProtected;		// Write protection enabled
+	bool trickleEnabled;		// Trickle charger enabled
+	unsigned char trickleDiodes;	// 1 or 2 when enabled, else 0
+	unsigned char trickleKRes;	// 2, 4 or 8 when enabled, else 0
+	unsigned char cr;			// Raw control register
+	unsigned char sr;			// Raw status register
+	unsigned char tcr;			// Raw trickle charge register
+} ds1306snapshot;
+
+#if DS1306_BUS_LOCK
+/* Completion handler for requestRead / requestWrite, receives the caller's context */
+typedef void (*ds1306handler)(void *context);
+#endif
+
+class DS1306RawTime;
+#if DS1306_BUS == DS1306_BUS_HOST || DS1306_BUS == DS1306_BUS_SPIDEV
+class DS1306Emulator;
+#endif
+
+#if DS1306_STATS
+class DS1306StatsScope;
+#endif
+
 class DS1306
 {
+	friend class DS1306Async;
+	friend class DS1306Bus;
+	friend class DS1306RawTime;
+#if DS1306_STATS
+	friend class DS1306StatsScope;
+#endif
+	friend class DS1306Records;
+	friend class DS1306Transaction;
+
 	public:
 
 	// Constructors
 	DS1306();
+#if DS1306_HOURS == DS1306_HOURS_RUNTIME
 	DS1306(bool writeHours24);
+#endif
 
 	// Initialize DS1306 using ce as chip enable line, turn on osc
 	void init(unsigned char ce);
 
+#if DS1306_BUS == DS1306_BUS_HOST || DS1306_BUS == DS1306_BUS_SPIDEV
+	// Host builds only, select the emulated chip used as the bus (or standing in for spidev)
+	void attach(DS1306Emulator *emulator);
+#endif
+
+#if DS1306_BUS == DS1306_BUS_SPIDEV
+	// spidev device to open in init() instead of /dev/spidev<DS1306_SPIDEV_BUS>.<ce>
+	void setDevice(const char *path);
+	bool isBusOpen();
+
+	// Hold back writes until the next read or endBatch(), false if any message failed
+	void beginBatch();
+	bool endBatch();
+
+	// SPI_IOC_MESSAGE ioctls issued (or replayed on an attached emulator), and how many failed
+	unsigned long getMessageCount();
+	unsigned long getMessageErrorCount();
+	void resetMessageCount();
+#endif
+
 	// Primary clock (time/date) operations
 	void setTime(const ds1306time *time);
 	void getTime(ds1306time *time);
+	void getRawTime(DS1306RawTime *time);
+	unsigned long getEpoch();
+	void setEpoch(unsigned long epoch);
+	void getStamp(ds1306stamp *stamp);
 
+#if DS1306_ALARMS
 	// Alarm management operations
 	void setAlarm(int alarm, const ds1306alarm *time);
 	void getAlarm(int alarm, ds1306alarm *time);
@@ -133,15 +306,21 @@ class DS1306
 	void disableAlarm(unsigned int alarm);
 	void enableBothAlarms();
 	void disableBothAlarms();
+#endif
 
 	// 1Hz state
 	bool get1HzState();
 	void set1HzState(bool enabled);
 
+#if DS1306_TRICKLE
 	// Trickle charge management
 	bool enableTrickleCharge(unsigned char numDiodes, unsigned char kRes);
 	void disableTrickleCharge();
 	bool getTrickleChargeState(unsigned char *numDiodes, unsigned char *kRes);
+#endif
+
+	// Complete device state in one transaction
+	void getSnapshot(ds1306snapshot *snapshot);
 
 	// User memory management
 	bool writeUser(unsigned char addr, const char *buf, int num);
@@ -151,40 +330,243 @@ class DS1306
 	bool isWriteProtected();
 	void setWriteProtection(bool on);
 
+	// SPI clock divider (DS1306_SPI_DIVxxx), false if divider is not one of them
+	bool setClockDivider(unsigned char divider);
+	unsigned char getClockDivider();
+
+	// Control register (CR, SR, TCR) shadow cache
+	void enableCache(unsigned char srPolicy = DS1306_CACHE_SR_LIVE);
+	void disableCache();
+	void invalidateCache();
+	void refreshCache();
+	unsigned long getCacheSavedTransactions();
+	void resetCacheCounters();
+
+#if DS1306_STATS
+	// Bus usage counters, per entry point (DS1306_API_xxx) or summed over all of them
+	void getStats(unsigned char api, ds1306stats *stats);
+	void getStatsTotal(ds1306stats *stats);
+	void resetStats();
+#endif
+
 	// Direct Register access (use for direct access to registers, if needed)
 	void read(unsigned char address, unsigned char *data, int len);
 	unsigned char read(unsigned char address);
 	void write(unsigned char address, const unsigned char *data, int len);
 	void write(unsigned char address, const unsigned char value);
 
+	// Time register codec used by setTime / getTime, for data read or written directly
+	// (packets of DS1306_SIZE_DATETIME bytes from DS1306_DATETIME; hours in this object's write form)
+	void encodeTimePacket(unsigned char *buf, const ds1306time *time);
+	static void decodeTimePacket(const unsigned char *buf, ds1306time *time);
+	unsigned char encodeHourByte(unsigned char hour24, unsigned char hour12, char ampm);
+	static void decodeHourByte(unsigned char hourByte, unsigned char *hour24, unsigned char *hour12, char *ampm);
+
+#if DS1306_BUS_LOCK
+	// Register access for interrupt handlers, run at once if the bus is free, else queued until it
+	// is released; false if the queue is full. Buffers must stay valid until handler is called
+	bool requestRead(unsigned char address, unsigned char *data, int len, ds1306handler handler = 0, void *context = 0);
+	bool requestWrite(unsigned char address, const unsigned char *data, int len, ds1306handler handler = 0, void *context = 0);
+
+	// True while a transaction holds the bus
+	static bool isBusLocked();
+#endif
+
 	private:
 
 	// Class Properties
 	unsigned char ce;			// Chip enable line
+#if DS1306_HOURS == DS1306_HOURS_RUNTIME
 	bool writeHours24;			// True (default) means time/alarm writes use 24 hour form
+#else
+	static const bool writeHours24 = (DS1306_HOURS == DS1306_HOURS_24);
+#endif
+	// Control register cache
+	bool cacheEnabled;			// Cache is in use
+	unsigned char cacheSRPolicy;	// DS1306_CACHE_SR_LIVE or DS1306_CACHE_SR_CACHED
+	unsigned char cacheValid;	// Bit per cached register, set when cache holds the chip's value
+	unsigned char cache[DS1306_CACHE_SIZE];	// CR, SR, TCR
+	unsigned long cacheSaved;	// Bus transactions avoided by the cache
+	unsigned char spiDivider;	// SPI clock divider
+#if DS1306_BUS == DS1306_BUS_AVR
+	unsigned char spiRate;		// SPR1:SPR0 bits for SPCR, plus DS1306_RATE_2X for SPI2X in SPSR
+#elif DS1306_BUS == DS1306_BUS_SPILIB || DS1306_BUS == DS1306_BUS_SPIDEV
+	unsigned long spiClock;		// SPI clock in Hz for spiDivider
+#endif
 
-	// Encode a time / alarm packet
-	void encodeTimePacket(unsigned char *buf, const ds1306time *time);
-	void encodeAlarmPacket(unsigned char *buf, const ds1306alarm *alarm);
+#if DS1306_STATS
+	ds1306stats stats[DS1306_API_COUNT];
+	unsigned char statsApi;		// Entry point being counted, DS1306_API_OTHER outside any
+#endif
 
-	// Decode a time / alarm packet
-	void decodeTimePacket(const unsigned char *buf, ds1306time *time);
-	void decodeAlarmPacket(const unsigned char *buf, ds1306alarm *alarm);
+#if DS1306_BUS_LOCK
+	// Request queued while the bus was busy
+	typedef struct {
+		DS1306 *rtc;
+		unsigned char address;	// Register address, including DS1306_WRITE_OFFSET for writes
+		unsigned char *data;	// Source (write) or destination (read) buffer
+		int len;
+		ds1306handler handler;
+		void *context;
+		volatile unsigned char ready;	// Filled in, set last by the requester
+	} deferred;
 
-	// Hour parameter management
-	void decodeHourByte(unsigned char hourByte, unsigned char *hour24, unsigned char *hour12, char *ampm);
-	unsigned char encodeHourByte(unsigned char hour24, unsigned char hour12, char ampm);
+	// Bus lock and queue, shared by every DS1306; head is advanced by requesters, tail by the owner
+	static volatile unsigned char busLocked;
+	static deferred deferQueue[DS1306_DEFER_QUEUE];
+	static volatile unsigned char deferHead;
+	static volatile unsigned char deferTail;
+#endif
+
+#if DS1306_BUS != DS1306_BUS_AVR
+	unsigned char asyncLast;	// Byte received by the last asyncStart
+#endif
+#if DS1306_BUS == DS1306_BUS_HOST
+	DS1306Emulator *emulator;	// Emulated chip used as the bus on host builds
+#elif DS1306_BUS == DS1306_BUS_SPIDEV
+	DS1306Emulator *emulator;	// Emulated chip standing in for the spidev device, 0 for the device
+	const char *spiPath;		// Device path, 0 for the default
+	int spiFd;					// Open spidev device, -1 when closed
+	struct spi_ioc_transfer spiSegments[DS1306_SPIDEV_SEGMENTS];	// Queued message
+	unsigned char spiSegmentCount;
+	unsigned char spiTx[DS1306_SPIDEV_BUFFER];	// Bytes to send, referenced by the queued segments
+	int spiTxUsed;
+	unsigned char spiLast;		// Byte received by busTransfer
+	bool spiBatching;			// Between beginBatch and endBatch
+	bool spiReceiving;			// Queued message reads into caller buffers, so must go before returning
+	bool spiHeld;				// Chip enable left asserted by the last message
+	bool spiFailed;				// A message failed since beginBatch
+	unsigned long spiMessages;	// Messages sent
+	unsigned long spiErrors;	// Messages that failed
+#else
+#if DS1306_BUS == DS1306_BUS_AVR && DS1306_SHARED_SPI
+	unsigned char spcr;			// SPCR backup, taken for the duration of a transaction
+	unsigned char spsr;			// SPSR backup (SPI2X), likewise
+#endif
+#if DS1306_FAST_PINS
+#if !DS1306_FIXED_CE
+	volatile unsigned char *cePort;		// Chip enable output port, resolved in init
+	unsigned char ceMask;				// Chip enable bit within cePort
+#endif
+#if DS1306_BUS == DS1306_BUS_SOFT
+	volatile unsigned char *sckPort;	// Soft SPI clock output port
+	unsigned char sckMask;
+	volatile unsigned char *mosiPort;	// Soft SPI data output port
+	unsigned char mosiMask;
+	volatile unsigned char *misoPin;	// Soft SPI data input register
+	unsigned char misoMask;
+#endif
+#endif
+#endif
+
+	// Member setup shared by the constructors
+	void construct();
+
+	// Single transaction burst access using two buffers (header and payload)
+	void readSplit(unsigned char address, unsigned char *data1, int len1, unsigned char *data2, int len2);
+	void writeSplit(unsigned char address, const unsigned char *data1, int len1, const unsigned char *data2, int len2);
+
+	// Control register access through the cache
+	unsigned char readControl(unsigned char address);
+	void writeControl(unsigned char address, unsigned char value);
+	void cacheNoteAccess(unsigned char address, int len, bool write);
+
+#if DS1306_TRICKLE
+	// Trickle charge register encode / decode
+	static bool encodeTrickleByte(unsigned char numDiodes, unsigned char kRes, unsigned char *byte);
+	bool decodeTrickleByte(unsigned char byte, unsigned char *numDiodes, unsigned char *kRes);
+#endif
+
+	// Encode / decode an alarm packet
+#if DS1306_ALARMS
+	void encodeAlarmPacket(unsigned char *buf, const ds1306alarm *alarm);
+	static void decodeAlarmPacket(const unsigned char *buf, ds1306alarm *alarm);
+#endif
 
 	// Parameter encode / decode
-	unsigned char encodeBCD7(unsigned char value);
-	unsigned char encodeBCD7(unsigned char value, unsigned char mask);
-	unsigned char encodeBCD8(unsigned char value);
-	unsigned char decodeBCD7(unsigned char value);
-	unsigned char decodeBCD7(unsigned char value, unsigned char mask);
-	unsigned char decodeBCD8(unsigned char value);
+	// Masked forms passing DS1306_ANY through, the plain codec is DS1306BCD
+	static unsigned char encodeBCD7(unsigned char value, unsigned char mask);
+	static unsigned char decodeBCD7(unsigned char value, unsigned char mask);
+
+	// Bus primitives, all SPI traffic goes through these
+	// busBegin / busEnd are busClaim + busSelect / busDeselect + busFree; DS1306Bus claims
+	// the bus once and selects several devices in turn
+	// busSend / busReceive move blocks whose received / sent bytes don't matter, letting the spidev
+	// backend queue them; busTransfer needs the byte received and so completes at once
+	void busInit();
+	void busBegin();
+	unsigned char busTransfer(unsigned char value);
+	void busSend(unsigned char value);
+	void busSend(const unsigned char *data, int len);
+	void busReceive(unsigned char *data, int len);
+	void busEnd();
+	void busAcquire();
+	void busSelect();
+	void busDeselect();
+	void busRelease();
+
+	// Take the bus (waiting) or release it, used by DS1306Bus in place of busAcquire / busRelease
+	void busClaim();
+	void busFree();
+
+#if DS1306_BUS_LOCK
+	// Bus lock, and running of requests queued while it was held
+	static bool busTryLock();
+	static void busUnlock();
+	static void busDrain();
+	bool request(unsigned char address, unsigned char *data, int len, ds1306handler handler, void *context);
+	void busRun(const deferred *job);
+#endif
+
+	// Record the SPI clock divider and the backend's settings for it
+	bool selectClock(unsigned char divider);
+
+#if DS1306_BUS == DS1306_BUS_AVR
+	// Program SPCR / SPSR for the DS1306 at the selected rate
+	void busConfigure(bool interrupt);
 
 	// Wait for SPI operation to finish
 	void waitSPI();
+#endif
+
+#if DS1306_BUS == DS1306_BUS_SPIDEV
+	// Queue a segment, send the queued message
+	void busSegment(const unsigned char *tx, unsigned char *rx, int len);
+	bool busFlush();
+#endif
+
+	// Non-blocking bus primitives, used by DS1306Async
+	void asyncBegin(bool interrupt);
+	void asyncStart(unsigned char value);
+	bool asyncReady();
+	unsigned char asyncResult();
+	void asyncEnd();
+};
+
+#if DS1306_STATS
+/* Attributes bus traffic to a public method for the duration of the call, unless already inside one */
+class DS1306StatsScope
+{
+	public:
+
+	DS1306StatsScope(DS1306 *rtc, unsigned char api) : rtc(rtc), outermost(rtc->statsApi == DS1306_API_OTHER)
+	{
+		if (outermost) {
+			rtc->statsApi = api;
+			rtc->stats[api].calls++;
+		}
+	}
+
+	~DS1306StatsScope()
+	{
+		if (outermost) rtc->statsApi = DS1306_API_OTHER;
+	}
+
+	private:
+
+	DS1306 *rtc;
+	bool outermost;
 };
+#endif
 
 #endif /* __DS1306_RTC_ */
@@ -0,0 +1,171 @@
+/*
+ * File			DS1306Async.cpp
+ *
+ * Synopsis		Non-blocking, queued register access for the DS1306
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "DS1306Async.h"
+
+// Queue updates must not be interleaved with service() when it runs from the SPI interrupt
+#if DS1306_BUS == DS1306_BUS_AVR && DS1306_ASYNC_ISR
+#define DS1306_ASYNC_LOCK()		unsigned char sreg = SREG; cli()
+#define DS1306_ASYNC_UNLOCK()	SREG = sreg
+#else
+#define DS1306_ASYNC_LOCK()
+#define DS1306_ASYNC_UNLOCK()
+#endif
+
+#if DS1306_BUS == DS1306_BUS_AVR && DS1306_ASYNC_ISR
+// Engine driven by the SPI transfer complete interrupt
+static DS1306Async *isrEngine = 0;
+
+ISR(SPI_STC_vect)
+{
+	if (isrEngine) isrEngine->service();
+}
+#endif
+
+// Constructor
+DS1306Async::DS1306Async(DS1306 *rtc) : rtc(rtc), head(0), tail(0), active(false), index(0), nextHandle(1), completed(0)
+{
+}
+
+// Prepare the engine, must be called after the DS1306 has been initialized
+void DS1306Async::begin()
+{
+#if DS1306_BUS == DS1306_BUS_AVR && DS1306_ASYNC_ISR
+	isrEngine = this;
+#endif
+}
+
+// Queue a read of len bytes from address into data
+// Returns a handle, or 0 if the queue is full
+unsigned int DS1306Async::queueRead(unsigned char address, unsigned char *data, int len, ds1306callback callback, void *context)
+{
+	return queueRequest(address & ~DS1306_WRITE_OFFSET, data, len, callback, context);
+}
+
+// Queue a write of len bytes from data to address
+// Returns a handle, or 0 if the queue is full
+unsigned int DS1306Async::queueWrite(unsigned char address, const unsigned char *data, int len, ds1306callback callback, void *context)
+{
+	// The buffer is only ever read for write requests
+	return queueRequest(address | DS1306_WRITE_OFFSET, (unsigned char *) data, len, callback, context);
+}
+
+// True once the transaction identified by handle has completed
+bool DS1306Async::isComplete(unsigned int handle)
+{
+	DS1306_ASYNC_LOCK();
+	unsigned int done = completed;
+	DS1306_ASYNC_UNLOCK();
+
+	// Handles increase monotonically, compare allowing for wrap
+	return ((int) (done - handle) >= 0) ? true : false;
+}
+
+// True when no transaction is queued or on the bus
+bool DS1306Async::isIdle()
+{
+	return (!active && head == tail) ? true : false;
+}
+
+// Process one completed byte and start the next, ending and starting transactions as needed
+// Called from the SPI transfer complete interrupt, or repeatedly from loop()
+void DS1306Async::service()
+{
+	if (!active) {
+		if (head != tail) start();
+		return;
+	}
+
+#if !(DS1306_BUS == DS1306_BUS_AVR && DS1306_ASYNC_ISR)
+	if (!rtc->asyncReady()) return;
+#endif
+
+	request *r = &queue[tail];
+	unsigned char in = rtc->asyncResult();
+	bool write = (r->address & DS1306_WRITE_OFFSET) ? true : false;
+
+	if (index >= 0 && !write) r->data[index] = in;
+	index++;
+
+	if (index < r->len) {
+		rtc->asyncStart(write ? r->data[index] : 0x00);
+		return;
+	}
+
+	// Transaction complete
+	rtc->asyncEnd();
+	active = false;
+	completed = r->handle;
+	tail = (tail + 1) % DS1306_ASYNC_RING;
+
+	if (r->callback) r->callback(r->handle, r->context);
+
+	if (head != tail) start();
+}
+
+// Service the queue until every transaction has completed
+void DS1306Async::flush()
+{
+	while (!isIdle()) {
+#if DS1306_BUS == DS1306_BUS_AVR && DS1306_ASYNC_ISR
+		// Interrupt handler does the work
+#else
+		service();
+#endif
+	}
+}
+
+// Add a transaction to the queue, starting it if the bus is idle
+unsigned int DS1306Async::queueRequest(unsigned char address, unsigned char *data, int len, ds1306callback callback, void *context)
+{
+	DS1306_ASYNC_LOCK();
+
+	unsigned char next = (head + 1) % DS1306_ASYNC_RING;
+	if (next == tail) {
+		DS1306_ASYNC_UNLOCK();
+		return 0;
+	}
+
+	request *r = &queue[head];
+	r->address = address;
+	r->data = data;
+	r->len = len;
+	r->callback = callback;
+	r->context = context;
+	r->handle = nextHandle++;
+	if (nextHandle == 0) nextHandle = 1;
+
+	// Keep the control register cache coherent, as a synchronous access would
+	rtc->cacheNoteAccess(address & ~DS1306_WRITE_OFFSET, len, (address & DS1306_WRITE_OFFSET) ? true : false);
+
+	head = next;
+	if (!active) start();
+
+	DS1306_ASYNC_UNLOCK();
+	return r->handle;
+}
+
+// Put the transaction at the tail of the queue on the bus, starting with its address byte
+void DS1306Async::start()
+{
+	active = true;
+	index = -1;
+#if DS1306_BUS == DS1306_BUS_AVR && DS1306_ASYNC_ISR
+	rtc->asyncBegin(true);
+#else
+	rtc->asyncBegin(false);
+#endif
+	rtc->asyncStart(queue[tail].address);
+}
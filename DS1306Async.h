@@ -0,0 +1,95 @@
+/*
+ * File			DS1306Async.h
+ *
+ * Synopsis		Non-blocking, queued register access for the DS1306
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Create a DS1306Async for an initialized DS1306 and call begin(). Register reads and writes
+ * 			are then queued with queueRead / queueWrite, which return immediately with a handle (0 if
+ * 			the queue is full). Up to DS1306_ASYNC_QUEUE transactions may be outstanding.
+ *
+ * 			Each call to service() processes one completed byte and starts the next. With
+ * 			DS1306_ASYNC_ISR set (AVR backend) service() is called from the SPI transfer complete
+ * 			interrupt and the queue runs entirely in the background. Otherwise call service() from
+ * 			loop(); on host builds each call simulates one transfer complete interrupt.
+ *
+ * 			Completion is reported through the optional callback (called from service(), so from
+ * 			interrupt context when DS1306_ASYNC_ISR is set) and can be polled with isComplete().
+ *
+ * 			Buffers passed to queueRead / queueWrite must remain valid until the transaction completes.
+ * 			Do not call synchronous DS1306 methods while the queue is busy (see isIdle()).
+ */
+#ifndef __DS1306_ASYNC_
+#define __DS1306_ASYNC_
+
+#include "DS1306.h"
+
+/* Ring entries, one more than DS1306_ASYNC_QUEUE as a slot is left empty to tell a full ring from an empty one */
+#define DS1306_ASYNC_RING		(DS1306_ASYNC_QUEUE + 1)
+
+/* Completion callback, receives the transaction handle and the caller's context */
+typedef void (*ds1306callback)(unsigned int handle, void *context);
+
+class DS1306Async
+{
+	public:
+
+	// Constructor, rtc must be initialized before begin() is called
+	DS1306Async(DS1306 *rtc);
+
+	// Prepare the engine (and, when configured, claim the SPI interrupt)
+	void begin();
+
+	// Queue transactions, returning a handle or 0 if the queue is full
+	unsigned int queueRead(unsigned char address, unsigned char *data, int len, ds1306callback callback = 0, void *context = 0);
+	unsigned int queueWrite(unsigned char address, const unsigned char *data, int len, ds1306callback callback = 0, void *context = 0);
+
+	// Completion state
+	bool isComplete(unsigned int handle);
+	bool isIdle();
+
+	// Advance the engine by one byte, called from the SPI interrupt or loop()
+	void service();
+
+	// Run the queue to completion, blocking
+	void flush();
+
+	private:
+
+	// Queued transaction descriptor
+	typedef struct {
+		unsigned char address;	// Register address, including DS1306_WRITE_OFFSET for writes
+		unsigned char *data;	// Source (write) or destination (read) buffer
+		int len;				// Number of data bytes
+		ds1306callback callback;
+		void *context;
+		unsigned int handle;
+	} request;
+
+	DS1306 *rtc;
+
+	// Ring of pending transactions, head is written by callers, tail by service()
+	request queue[DS1306_ASYNC_RING];
+	volatile unsigned char head;
+	volatile unsigned char tail;
+
+	// Active transaction state
+	volatile bool active;		// A transaction is on the bus
+	int index;					// Data byte in flight, -1 while the address byte is in flight
+
+	// Handle allocation and completion tracking
+	unsigned int nextHandle;
+	volatile unsigned int completed;	// Handle of the most recently completed transaction
+
+	unsigned int queueRequest(unsigned char address, unsigned char *data, int len, ds1306callback callback, void *context);
+	void start();
+};
+
+#endif /* __DS1306_ASYNC_ */
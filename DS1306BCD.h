@@ -0,0 +1,44 @@
+/*
+ * File			DS1306BCD.h
+ *
+ * Synopsis		BCD codec shared by the DS1306 library classes
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			DS1306BCD::encode() converts a binary value to packed BCD and decode() converts back. Every
+ * 			class of the library converts register bytes through these, so there is one codec to test
+ * 			and tune. Both are inline and avoid division, which is a slow library call on AVR:
+ * 			for 0 <= value < 1029, value / 10 == (value * 205) >> 11, and since BCD is
+ * 			(tens << 4) | units, encoding is value + 6 * tens and decoding is value - 6 * (high nibble).
+ *
+ * 			For every 8 bit input the results equal ((value / 10) << 4) | (value % 10) and
+ * 			(value >> 4) * 10 + (value & 0x0F), truncated to 8 bits; extras/ds1306bcdbench checks this
+ * 			exhaustively and times both forms.
+ */
+#ifndef __DS1306_BCD_
+#define __DS1306_BCD_
+
+class DS1306BCD
+{
+	public:
+
+	// Binary to BCD
+	static unsigned char encode(unsigned char value)
+	{
+		return value + 6 * (unsigned char) (((unsigned int) value * 205) >> 11);
+	}
+
+	// BCD to binary
+	static unsigned char decode(unsigned char value)
+	{
+		return value - 6 * (value >> 4);
+	}
+};
+
+#endif /* __DS1306_BCD_ */
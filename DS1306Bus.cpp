@@ -0,0 +1,214 @@
+/*
+ * File			DS1306Bus.cpp
+ *
+ * Synopsis		Several DS1306 devices sharing one SPI bus
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "DS1306Bus.h"
+
+#if !DS1306_FIXED_CE
+// Attempts at a skew reading before accepting one that straddles a seconds rollover
+#define DS1306_SKEW_ATTEMPTS	3
+
+// Constructor
+DS1306Bus::DS1306Bus() : count(0), owner(0)
+{
+}
+
+// Register an initialized device
+// Returns false if DS1306_MAX_DEVICES devices are already registered
+bool DS1306Bus::add(DS1306 *rtc)
+{
+	if (count >= DS1306_MAX_DEVICES) return false;
+	devices[count++] = rtc;
+	return true;
+}
+
+// Number of registered devices
+unsigned char DS1306Bus::getDeviceCount()
+{
+	return count;
+}
+
+// Registered device at index, or 0 if index is out of range
+DS1306 *DS1306Bus::getDevice(unsigned char index)
+{
+	return (index < count) ? devices[index] : 0;
+}
+
+// Retrieve current time from every device, times must hold getDeviceCount() entries
+void DS1306Bus::getTimeAll(ds1306time *times)
+{
+	DS1306RawTime raw[DS1306_MAX_DEVICES];
+	getRawTimeAll(raw);
+	for (unsigned char i = 0; i < count; i++) {
+		raw[i].decode(&times[i]);
+	}
+}
+
+// Retrieve current time from every device without decoding, in one pass over the bus
+void DS1306Bus::getRawTimeAll(DS1306RawTime *times)
+{
+	if (!count) return;
+
+	claim();
+	for (unsigned char i = 0; i < count; i++) {
+		readDevice(devices[i], DS1306_DATETIME, times[i].regs, DS1306_SIZE_DATETIME);
+	}
+	release();
+}
+
+// Retrieve current time from every device as seconds since 2000-01-01 00:00:00
+void DS1306Bus::getEpochAll(unsigned long *epochs)
+{
+	DS1306RawTime raw[DS1306_MAX_DEVICES];
+	getRawTimeAll(raw);
+	for (unsigned char i = 0; i < count; i++) {
+		epochs[i] = raw[i].getEpoch();
+	}
+}
+
+// Time of every device relative to the first, in seconds (positive when ahead)
+// The first device is read before and after the others, and the pass is retaken if its seconds changed
+void DS1306Bus::getSkew(long *skew)
+{
+	if (!count) return;
+
+	DS1306RawTime raw[DS1306_MAX_DEVICES];
+	DS1306RawTime check;
+
+	for (unsigned char attempt = 0; attempt < DS1306_SKEW_ATTEMPTS; attempt++) {
+		claim();
+		for (unsigned char i = 0; i < count; i++) {
+			readDevice(devices[i], DS1306_DATETIME, raw[i].regs, DS1306_SIZE_DATETIME);
+		}
+		readDevice(devices[0], DS1306_DATETIME, check.regs, DS1306_SIZE_DATETIME);
+		release();
+
+		if (raw[0].regs[0] == check.regs[0]) break;
+	}
+
+	unsigned long reference = raw[0].getEpoch();
+	for (unsigned char i = 0; i < count; i++) {
+		skew[i] = (long) (raw[i].getEpoch() - reference);
+	}
+}
+
+// Set the time on every device
+// Time set uses hours or hours12/ampm according to each device's writeHours24
+void DS1306Bus::setTimeAll(const ds1306time *time)
+{
+	if (!count) return;
+
+	unsigned char buf[DS1306_SIZE_DATETIME];
+
+	claim();
+	for (unsigned char i = 0; i < count; i++) {
+		// Encode once, again only where the hour form changes
+		if (i == 0 || devices[i]->writeHours24 != devices[i - 1]->writeHours24) {
+			devices[i]->encodeTimePacket(buf, time);
+		}
+		writeDevice(devices[i], DS1306_DATETIME, buf, DS1306_SIZE_DATETIME);
+	}
+	release();
+}
+
+// Set the time on every device from seconds since 2000-01-01 00:00:00
+void DS1306Bus::setEpochAll(unsigned long epoch)
+{
+	if (!count) return;
+
+	DS1306RawTime raw;
+
+	claim();
+	for (unsigned char i = 0; i < count; i++) {
+		if (i == 0 || devices[i]->writeHours24 != devices[i - 1]->writeHours24) {
+			raw.setEpoch(epoch, devices[i]->writeHours24);
+		}
+		writeDevice(devices[i], DS1306_DATETIME, raw.regs, DS1306_SIZE_DATETIME);
+	}
+	release();
+}
+
+// Burst read len bytes from address on every device, device i's bytes land at data[i * len]
+void DS1306Bus::read(unsigned char address, unsigned char *data, int len)
+{
+	if (!count) return;
+
+	claim();
+	for (unsigned char i = 0; i < count; i++) {
+		readDevice(devices[i], address, &data[i * len], len);
+	}
+	release();
+}
+
+// Burst write the same len bytes to address on every device
+void DS1306Bus::write(unsigned char address, const unsigned char *data, int len)
+{
+	if (!count) return;
+
+	claim();
+	for (unsigned char i = 0; i < count; i++) {
+		writeDevice(devices[i], address, data, len);
+	}
+	release();
+}
+
+// Take the bus, configured for the first device
+void DS1306Bus::claim()
+{
+	owner = devices[0];
+	owner->busClaim();
+}
+
+// Reconfigure the held bus for rtc if its clock divider differs from the configuration in force
+// The lock is kept, so the pass is not interleaved with other contexts
+void DS1306Bus::configure(DS1306 *rtc)
+{
+	if (rtc->spiDivider == owner->spiDivider) return;
+
+	owner->busRelease();
+	owner = rtc;
+	owner->busAcquire();
+}
+
+// Release the bus, restoring what the configuring device saved
+void DS1306Bus::release()
+{
+	owner->busFree();
+}
+
+// Burst read from one device, bus already acquired
+void DS1306Bus::readDevice(DS1306 *rtc, unsigned char address, unsigned char *data, int len)
+{
+	configure(rtc);
+	rtc->cacheNoteAccess(address, len, false);
+
+	rtc->busSelect();
+	rtc->busSend(address);
+	rtc->busReceive(data, len);
+	rtc->busDeselect();
+}
+
+// Burst write to one device, bus already acquired
+void DS1306Bus::writeDevice(DS1306 *rtc, unsigned char address, const unsigned char *data, int len)
+{
+	configure(rtc);
+	rtc->cacheNoteAccess(address, len, true);
+
+	rtc->busSelect();
+	rtc->busSend(address | DS1306_WRITE_OFFSET);
+	rtc->busSend(data, len);
+	rtc->busDeselect();
+}
+
+#endif
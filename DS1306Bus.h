@@ -0,0 +1,84 @@
+/*
+ * File			DS1306Bus.h
+ *
+ * Synopsis		Several DS1306 devices sharing one SPI bus
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Initialize each DS1306 with its own chip enable line as usual, then add() it to a DS1306Bus
+ * 			(up to DS1306_MAX_DEVICES, see DS1306Config.h). Operations on the bus configure SPI once
+ * 			(saving SPCR / beginning an SPI transaction) and then select each device in turn, so every
+ * 			further device costs only its chip enable cycle and data bytes.
+ *
+ * 			Each device still runs at its own clock divider (DS1306::setClockDivider). The bus is
+ * 			configured for the first device, and reconfigured, keeping the bus, only where a device's
+ * 			divider differs from the one in force; adding devices that share a rate next to each other
+ * 			keeps these changes to a minimum.
+ *
+ * 			Reads fill one result per device, in the order the devices were added. Writes send the same
+ * 			data to every device; setTimeAll() and setEpochAll() encode hours in each device's own
+ * 			12 or 24 hour form.
+ *
+ * 			getSkew() reports each device's time relative to the first device, in whole seconds. The
+ * 			devices are read back to back, and the read is retaken if the first device's seconds change
+ * 			during it, so a seconds rollover during the pass does not show up as skew.
+ */
+#ifndef __DS1306_BUS_
+#define __DS1306_BUS_
+
+#include "DS1306.h"
+#include "DS1306RawTime.h"
+
+/* Every device needs its own chip enable line, see DS1306_CE_PORT in DS1306Config.h */
+#if !DS1306_FIXED_CE
+class DS1306Bus
+{
+	public:
+
+	// Constructor
+	DS1306Bus();
+
+	// Register an initialized device, false if DS1306_MAX_DEVICES are already registered
+	bool add(DS1306 *rtc);
+	unsigned char getDeviceCount();
+	DS1306 *getDevice(unsigned char index);
+
+	// Batched time operations, one result per device
+	void getTimeAll(ds1306time *times);
+	void getRawTimeAll(DS1306RawTime *times);
+	void getEpochAll(unsigned long *epochs);
+	void getSkew(long *skew);
+
+	// Broadcast time operations
+	void setTimeAll(const ds1306time *time);
+	void setEpochAll(unsigned long epoch);
+
+	// Batched register access, data holds len bytes per device for read, len bytes in total for write
+	void read(unsigned char address, unsigned char *data, int len);
+	void write(unsigned char address, const unsigned char *data, int len);
+
+	private:
+
+	DS1306 *devices[DS1306_MAX_DEVICES];
+	unsigned char count;
+	DS1306 *owner;				// Device whose SPI settings are in force while the bus is held
+
+	// Bus ownership for one pass over the devices
+	void claim();
+	void configure(DS1306 *rtc);
+	void release();
+
+	// Single device transfers, called with the bus acquired
+	void readDevice(DS1306 *rtc, unsigned char address, unsigned char *data, int len);
+	void writeDevice(DS1306 *rtc, unsigned char address, const unsigned char *data, int len);
+};
+
+#endif
+
+#endif /* __DS1306_BUS_ */
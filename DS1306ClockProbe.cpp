@@ -0,0 +1,106 @@
+/*
+ * File			DS1306ClockProbe.cpp
+ *
+ * Synopsis		Selection of the fastest SPI clock rate a DS1306 reliably works at
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <string.h>
+#endif
+#include "DS1306ClockProbe.h"
+
+// Constructor
+DS1306ClockProbe::DS1306ClockProbe(DS1306 *rtc, unsigned char address) : rtc(rtc), address(address),
+	fastest(DS1306_SPI_DIV2), slowest(DS1306_SPI_DIV128), negotiations(0), interval(0), lastCheck(0)
+{
+#ifdef ARDUINO
+	millisSource = millis;
+#else
+	millisSource = 0;
+#endif
+}
+
+// Try dividers from fastest to slowest, keeping the first that passes the check
+// Returns the divider kept, or 0 if none passed (the slowest is then kept)
+unsigned char DS1306ClockProbe::negotiate(unsigned char fastest, unsigned char slowest)
+{
+	this->fastest = fastest;
+	this->slowest = slowest;
+	negotiations++;
+	stamp();
+
+	for (unsigned int divider = fastest; divider <= slowest; divider <<= 1) {
+		if (rtc->setClockDivider(divider) && check()) return divider;
+	}
+
+	rtc->setClockDivider(slowest);
+	return 0;
+}
+
+// Check the current divider, returns true if the scratch bytes read back intact
+bool DS1306ClockProbe::validate()
+{
+	stamp();
+	return check();
+}
+
+// Re-validate every ms milliseconds from poll(), 0 disables
+void DS1306ClockProbe::setInterval(unsigned long ms)
+{
+	interval = ms;
+	stamp();
+}
+
+// Re-validate if the interval has passed, negotiating again over the last range if the check fails
+void DS1306ClockProbe::poll()
+{
+	if (!interval || !millisSource || millisSource() - lastCheck < interval) return;
+
+	if (!validate()) negotiate(fastest, slowest);
+}
+
+// Provide the millisecond time source used for re-validation
+void DS1306ClockProbe::setMillisSource(unsigned long (*source)())
+{
+	millisSource = source;
+	stamp();
+}
+
+// Number of negotiations, a count rising from poll() points to a marginal bus
+unsigned int DS1306ClockProbe::getNegotiationCount()
+{
+	return negotiations;
+}
+
+// Write a pattern and its complement to the scratch bytes, reading each back
+// The pattern has transitions in every bit position, so a bit slip or stuck line shows
+bool DS1306ClockProbe::check()
+{
+	unsigned char pattern[DS1306_PROBE_SIZE] = { 0x55, 0x33, 0x0F, 0x96 };
+	unsigned char readback[DS1306_PROBE_SIZE];
+
+	for (unsigned char pass = 0; pass < 2; pass++) {
+		rtc->write(address, pattern, DS1306_PROBE_SIZE);
+		rtc->read(address, readback, DS1306_PROBE_SIZE);
+		if (memcmp(pattern, readback, DS1306_PROBE_SIZE)) return false;
+
+		for (unsigned char i = 0; i < DS1306_PROBE_SIZE; i++) {
+			pattern[i] = ~pattern[i];
+		}
+	}
+	return true;
+}
+
+// Note the time of a check
+void DS1306ClockProbe::stamp()
+{
+	if (millisSource) lastCheck = millisSource();
+}
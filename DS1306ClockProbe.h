@@ -0,0 +1,80 @@
+/*
+ * File			DS1306ClockProbe.h
+ *
+ * Synopsis		Selection of the fastest SPI clock rate a DS1306 reliably works at
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Create a DS1306ClockProbe for an initialized DS1306, giving it DS1306_PROBE_SIZE bytes of user
+ * 			memory it may use as scratch space (by default the last bytes, 0x7C - 0x7F). Their contents
+ * 			are overwritten and must not be used for anything else.
+ *
+ * 			negotiate() tries the SPI clock dividers from fastest to slowest. At each rate a pattern and
+ * 			its complement are written to the scratch bytes and read back; the first rate at which both
+ * 			read back intact is kept with DS1306::setClockDivider() and returned. If none does, the
+ * 			slowest rate is kept and 0 is returned. Write protection must be off.
+ *
+ * 			validate() checks the current rate the same way, without changing it. For periodic
+ * 			re-validation, setInterval() a period in milliseconds and call poll() from loop(); when a
+ * 			check fails, poll() negotiates again. On host builds there is no millis(), supply one with
+ * 			setMillisSource().
+ *
+ * 			The probe assumes that writes at a rate too fast for the chip fail harmlessly or corrupt
+ * 			only the data bytes. Limit the range tried with the fastest / slowest arguments of
+ * 			negotiate() if the wiring may corrupt address bytes at some rates.
+ */
+#ifndef __DS1306_CLOCKPROBE_
+#define __DS1306_CLOCKPROBE_
+
+#include "DS1306.h"
+
+/* Scratch bytes used for each check */
+#define DS1306_PROBE_SIZE		4
+
+class DS1306ClockProbe
+{
+	public:
+
+	// Constructor, address is the first of DS1306_PROBE_SIZE scratch bytes in user memory
+	DS1306ClockProbe(DS1306 *rtc, unsigned char address = DS1306_USER_END - DS1306_PROBE_SIZE + 1);
+
+	// Select the fastest working divider, returns it or 0 if none works
+	unsigned char negotiate(unsigned char fastest = DS1306_SPI_DIV2, unsigned char slowest = DS1306_SPI_DIV128);
+
+	// Check the current divider
+	bool validate();
+
+	// Periodic re-validation, 0 disables
+	void setInterval(unsigned long ms);
+	void poll();
+
+	// Millisecond time source for re-validation (defaults to millis() on Arduino)
+	void setMillisSource(unsigned long (*source)());
+
+	// Negotiations since construction, including those started by poll()
+	unsigned int getNegotiationCount();
+
+	private:
+
+	DS1306 *rtc;
+	unsigned char address;
+
+	unsigned char fastest;			// Range of the last negotiation, reused by poll()
+	unsigned char slowest;
+	unsigned int negotiations;
+
+	unsigned long interval;			// Re-validation period in ms, 0 for never
+	unsigned long lastCheck;		// Time of the last check or negotiation
+	unsigned long (*millisSource)();
+
+	bool check();
+	void stamp();
+};
+
+#endif /* __DS1306_CLOCKPROBE_ */
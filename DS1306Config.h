@@ -0,0 +1,241 @@
+/*
+ * File			DS1306Config.h
+ *
+ * Synopsis		Compile time configuration for the DS1306 library
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Options are selected at compile time so that nothing is dispatched at run time. Either edit
+ * 			the defaults below or define the option in the compiler flags for the whole build.
+ *
+ * 			DS1306_BUS selects the SPI backend used by DS1306::read and DS1306::write:
+ *
+ * 			DS1306_BUS_AVR		Direct SPCR/SPDR access on AVR hardware SPI at fosc/4 (default on AVR)
+ * 			DS1306_BUS_SPILIB	Arduino SPI library with SPI transactions (default on other Arduino cores)
+ * 			DS1306_BUS_SOFT		Bit-banged SPI on DS1306_SOFT_SCK / DS1306_SOFT_MOSI / DS1306_SOFT_MISO
+ * 			DS1306_BUS_HOST		DS1306Emulator, used for host builds (default when ARDUINO is not defined)
+ * 			DS1306_BUS_SPIDEV	Linux spidev, one SPI_IOC_MESSAGE ioctl per transaction or batch
+ *
+ * 			On AVR the chip enable line (and the soft SPI lines) are driven through port registers
+ * 			resolved once in init(), rather than through digitalWrite() on every transaction.
+ *
+ * 			Cost of a typical getTime() (1 address byte + 7 data bytes, one chip enable cycle).
+ * 			Cycle counts are estimates from instruction counts on a 16MHz ATmega328, not measurements.
+ *
+ * 			Backend			Bytes	Cycles per byte		Cycles per getTime()
+ * 			AVR				8		~40					~340
+ * 			AVR (shared)	8		~40					~350 (adds SPCR save/restore)
+ * 			SPILIB			8		~50					~450 (adds beginTransaction/endTransaction)
+ * 			SOFT			8		~130				~1060
+ * 			HOST			8		n/a					see DS1306Emulator::getByteCount()
+ * 			SPIDEV			8		n/a					1 ioctl, see DS1306::getMessageCount()
+ *
+ * 			For comparison, the previous implementation spent roughly 2 x 60 cycles per transaction in
+ * 			digitalWrite() for chip enable alone.
+ *
+ * 			DS1306_HOURS, DS1306_DECODE_12, DS1306_ALARMS, DS1306_TRICKLE and DS1306_CE_PORT / _BIT trim
+ * 			the DS1306 class for small targets. Code sizes are the text of DS1306.cpp built with g++ -Os
+ * 			on x86-64, before the linker discards unused functions, so only the relative savings carry
+ * 			over to AVR; extras/ds1306size measures them all and checks that DS1306_STATS 0 adds
+ * 			nothing. RAM is sizeof(DS1306) on AVR with the shared SPI backend. Time each
+ * 			configuration on the host with extras/ds1306bench.
+ *
+ * 			Configuration						Code	Saved	RAM
+ * 			Default								5777	-		19
+ * 			DS1306_HOURS_24						5655	122		18
+ * 			DS1306_HOURS_12						5723	54		18
+ * 			DS1306_HOURS_24, DS1306_DECODE_12 0	5539	238		18
+ * 			DS1306_ALARMS 0						4617	1160	19
+ * 			DS1306_TRICKLE 0					5375	402		19
+ * 			All of the above (24 hour)			4009	1768	18
+ * 			DS1306_CE_PORT / DS1306_CE_BIT		-		-		16 (CE toggles become sbi / cbi)
+ * 			DS1306_STATS 1						9624	-3847	680 (counters for every method)
+ */
+#ifndef __DS1306_CONFIG_
+#define __DS1306_CONFIG_
+
+/* Bus backends */
+#define DS1306_BUS_AVR			1
+#define DS1306_BUS_SPILIB		2
+#define DS1306_BUS_SOFT			3
+#define DS1306_BUS_HOST			4
+#define DS1306_BUS_SPIDEV		5
+
+/* Backend selection */
+#ifndef DS1306_BUS
+#if !defined(ARDUINO)
+#define DS1306_BUS				DS1306_BUS_HOST
+#elif defined(__AVR__)
+#define DS1306_BUS				DS1306_BUS_AVR
+#else
+#define DS1306_BUS				DS1306_BUS_SPILIB
+#endif
+#endif
+
+/* Shared SPI bus (AVR backend only)
+   When 1, SPCR is saved and restored around every transaction so other SPI devices are unaffected.
+   When 0, SPCR is configured once in init() and left alone, saving two register copies per transaction. */
+#ifndef DS1306_SHARED_SPI
+#define DS1306_SHARED_SPI		1
+#endif
+
+/* SPI clock used by the SPI library and spidev backends at divider 4, matches fosc/4 on a 16MHz AVR
+   Other dividers scale it, so divider 8 gives DS1306_SPI_CLOCK / 2 */
+#ifndef DS1306_SPI_CLOCK
+#define DS1306_SPI_CLOCK		4000000
+#endif
+
+/* Linux spidev backend
+   init(ce) opens /dev/spidev<DS1306_SPIDEV_BUS>.<ce> unless DS1306::setDevice() named another device.
+   Bytes are queued as up to DS1306_SPIDEV_SEGMENTS transfers, with up to DS1306_SPIDEV_BUFFER bytes
+   to send, and handed to the kernel as one SPI_IOC_MESSAGE. */
+#ifndef DS1306_SPIDEV_BUS
+#define DS1306_SPIDEV_BUS		0
+#endif
+#ifndef DS1306_SPIDEV_SEGMENTS
+#define DS1306_SPIDEV_SEGMENTS	16
+#endif
+#ifndef DS1306_SPIDEV_BUFFER
+#define DS1306_SPIDEV_BUFFER	256
+#endif
+
+/* SPI clock divider each DS1306 starts with (see DS1306::setClockDivider), fosc / 4 on AVR
+   The DS1306 is specified to 2MHz at 5V and 600kHz at 2V, so slower parts or supplies may need more */
+#ifndef DS1306_SPI_DIVIDER
+#define DS1306_SPI_DIVIDER		4
+#endif
+
+/* Pins used by the soft SPI backend */
+#ifndef DS1306_SOFT_SCK
+#define DS1306_SOFT_SCK			13
+#endif
+#ifndef DS1306_SOFT_MOSI
+#define DS1306_SOFT_MOSI		11
+#endif
+#ifndef DS1306_SOFT_MISO
+#define DS1306_SOFT_MISO		12
+#endif
+
+/* Number of queued transactions held by DS1306Async */
+#ifndef DS1306_ASYNC_QUEUE
+#define DS1306_ASYNC_QUEUE		8
+#endif
+
+/* When 1 (AVR backend only), DS1306Async installs the SPI transfer complete interrupt handler
+   (SPI_STC_vect) and runs the queue from it. When 0, call DS1306Async::service() from loop(). */
+#ifndef DS1306_ASYNC_ISR
+#define DS1306_ASYNC_ISR		0
+#endif
+
+/* Number of alarm events held by DS1306Events, a power of two no greater than 128 */
+#ifndef DS1306_EVENT_QUEUE
+#define DS1306_EVENT_QUEUE		8
+#endif
+
+/* Number of planned transactions DS1306Transaction records for getPlanned() */
+#ifndef DS1306_TRANSACTION_PLAN
+#define DS1306_TRANSACTION_PLAN	8
+#endif
+
+/* Number of devices a DS1306Bus can manage */
+#ifndef DS1306_MAX_DEVICES
+#define DS1306_MAX_DEVICES		4
+#endif
+
+/* Bus ownership for interrupt handlers
+   When 1, every DS1306 transaction holds a bus lock, shared by all DS1306 objects as they share the
+   SPI bus. DS1306::requestRead / requestWrite may then be called from interrupt handlers: a request
+   that finds the bus free runs at once, one that finds it busy is queued, and whoever releases the
+   bus runs it. Interrupts are masked only for the few instructions that take the lock or a queue
+   slot, never across a transfer. When 0 the lock and queue compile to nothing. */
+#ifndef DS1306_BUS_LOCK
+#define DS1306_BUS_LOCK			0
+#endif
+
+/* Number of requests queued while the bus is busy, a power of two no greater than 128 */
+#ifndef DS1306_DEFER_QUEUE
+#define DS1306_DEFER_QUEUE		4
+#endif
+
+/* Bus instrumentation
+   When 1, each DS1306 counts bus transactions, chip enable assertions, bytes and SPI busy-wait loops,
+   broken down by public method (see DS1306::getStats). Costs DS1306_API_COUNT x 20 bytes of RAM
+   per DS1306. When 0 the instrumentation compiles to nothing. */
+#ifndef DS1306_STATS
+#define DS1306_STATS			0
+#endif
+
+/* Hour form written by setTime, setAlarm and setEpoch
+   DS1306_HOURS_RUNTIME	Chosen per object by the writeHours24 constructor argument (default)
+   DS1306_HOURS_24		Always 24 hour form, fixed at compile time
+   DS1306_HOURS_12		Always 12 hour form, fixed at compile time
+   A fixed form removes the writeHours24 member, the DS1306(bool) constructor and the unused
+   encode branch. */
+#define DS1306_HOURS_RUNTIME	0
+#define DS1306_HOURS_24			24
+#define DS1306_HOURS_12			12
+
+#ifndef DS1306_HOURS
+#define DS1306_HOURS			DS1306_HOURS_RUNTIME
+#endif
+
+/* 12 hour form decoding
+   When 0, hour registers read back by getTime, getAlarm and getSnapshot are taken to be in 24 hour
+   form, as they are when the clock is only ever set through this library with DS1306_HOURS_24, and
+   hours12 / ampm are returned as 0. DS1306RawTime still decodes either form. */
+#ifndef DS1306_DECODE_12
+#define DS1306_DECODE_12		1
+#endif
+
+#if !DS1306_DECODE_12 && DS1306_HOURS != DS1306_HOURS_24
+#error "DS1306_DECODE_12 0 requires DS1306_HOURS DS1306_HOURS_24"
+#endif
+
+/* Optional features, 0 compiles the feature's API out of DS1306 and DS1306Transaction
+   DS1306_ALARMS		Alarm methods, DS1306Events and DS1306Scheduler
+   DS1306_TRICKLE		Trickle charge methods
+   getSnapshot() still reads the whole block, leaving the fields of a disabled feature zeroed. */
+#ifndef DS1306_ALARMS
+#define DS1306_ALARMS			1
+#endif
+#ifndef DS1306_TRICKLE
+#define DS1306_TRICKLE			1
+#endif
+
+/* Port register pin access, available on AVR */
+#if defined(ARDUINO) && defined(__AVR__)
+#define DS1306_FAST_PINS		1
+#else
+#define DS1306_FAST_PINS		0
+#endif
+
+/* Chip enable fixed at compile time (AVR only)
+   Define DS1306_CE_PORT (for example PORTB) and DS1306_CE_BIT (for example 2, digital 10 on Uno) to
+   drive chip enable with single bit set / clear instructions rather than through a port pointer held
+   in RAM. init() must still be passed the matching pin number. Only one DS1306 can be used, so
+   DS1306Bus is unavailable. */
+#if DS1306_FAST_PINS && defined(DS1306_CE_PORT) && defined(DS1306_CE_BIT)
+#define DS1306_FIXED_CE			1
+#else
+#define DS1306_FIXED_CE			0
+#endif
+
+/* Constant tables live in flash on AVR */
+#if defined(ARDUINO) && defined(__AVR__)
+#include <avr/pgmspace.h>
+#define DS1306_PROGMEM			PROGMEM
+#define DS1306_PGM_BYTE(p)		pgm_read_byte(p)
+#define DS1306_PGM_WORD(p)		pgm_read_word(p)
+#else
+#define DS1306_PROGMEM
+#define DS1306_PGM_BYTE(p)		(*(p))
+#define DS1306_PGM_WORD(p)		(*(p))
+#endif
+
+#endif /* __DS1306_CONFIG_ */
@@ -0,0 +1,321 @@
+/*
+ * File			DS1306Emulator.cpp
+ *
+ * Synopsis		Software model of the DS1306 register file and SPI slave interface
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#include <string.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+
+// First reserved register following the TCR
+#define DS1306_EMU_RESERVED		0x12
+
+// Writable bits of the control register (EOSC, WP, 1HZ, AIE1, AIE0)
+#define DS1306_EMU_CR_MASK		0xC7
+
+// Oscillator disable bit of the control register
+#define DS1306_EMU_CR_EOSC		7
+
+// Constructor, emulator starts in power on state
+DS1306Emulator::DS1306Emulator() : clockDivider(4), fastestDivider(0)
+{
+	reset();
+}
+
+// Return emulator to power on state
+// The clock reads 00-01-01 00:00:00 (24 hour), day of week 1, oscillator running and write protected
+void DS1306Emulator::reset()
+{
+	memset(regs, 0, sizeof(regs));
+	regs[DS1306_DATETIME + 3] = 0x01;
+	regs[DS1306_DATETIME + 4] = 0x01;
+	regs[DS1306_DATETIME + 5] = 0x01;
+	regs[DS1306_CR] = (1 << DS1306_CR_WP);
+
+	selected = false;
+	addressed = false;
+	writing = false;
+	pointer = 0;
+
+	resetCounters();
+}
+
+// Raise chip enable, starting a new transaction
+void DS1306Emulator::select()
+{
+	selected = true;
+	addressed = false;
+	transactions++;
+}
+
+// Clock one byte through the SPI interface
+// The first byte of each transaction is the address, subsequent bytes are data
+// Returns the byte shifted out by the chip (zero for address and write bytes)
+unsigned char DS1306Emulator::transfer(unsigned char in)
+{
+	if (!selected) return 0;
+
+	bytes++;
+
+	if (!addressed) {
+		addressed = true;
+		writing = (in & DS1306_WRITE_OFFSET) ? true : false;
+		pointer = in & ~DS1306_WRITE_OFFSET;
+		return 0;
+	}
+
+	unsigned char out = 0;
+	if (writing) {
+		store(pointer, in);
+	} else {
+		out = load(pointer);
+		if (clockDivider < fastestDivider) {
+			// Clock too fast for the chip, the master samples each bit a bit late
+			out = (unsigned char) ((out >> 1) | (out << 7));
+			errors++;
+		}
+	}
+	pointer = nextAddress(pointer);
+
+	return out;
+}
+
+// Lower chip enable, ending the transaction
+void DS1306Emulator::deselect()
+{
+	selected = false;
+	addressed = false;
+}
+
+// Advance the clock by one second, then evaluate both alarms
+// Does nothing if the oscillator is disabled
+void DS1306Emulator::tick()
+{
+	if (regs[DS1306_CR] & (1 << DS1306_EMU_CR_EOSC)) return;
+
+	unsigned char *t = &regs[DS1306_DATETIME];
+
+	t[0] = incrementBCD(t[0]);
+	if (t[0] == 0x60) {
+		t[0] = 0;
+		t[1] = incrementBCD(t[1]);
+		if (t[1] == 0x60) {
+			t[1] = 0;
+			if (t[2] & 0x40) {
+				// 12 hour mode, 11 -> 12 flips AM/PM, 12 -> 1
+				unsigned char hour = t[2] & 0x1F;
+				if (hour == 0x11) {
+					t[2] = (t[2] ^ 0x20) & ~0x1F;
+					t[2] |= 0x12;
+					if (!(t[2] & 0x20)) tickDay();
+				} else if (hour == 0x12) {
+					t[2] = (t[2] & ~0x1F) | 0x01;
+				} else {
+					t[2] = (t[2] & ~0x1F) | incrementBCD(hour);
+				}
+			} else {
+				// 24 hour mode
+				if (t[2] == 0x23) {
+					t[2] = 0;
+					tickDay();
+				} else {
+					t[2] = incrementBCD(t[2]);
+				}
+			}
+		}
+	}
+
+	if (alarmMatches(DS1306_ALARM0)) regs[DS1306_SR] |= (1 << DS1306_SR_IRQF0);
+	if (alarmMatches(DS1306_ALARM1)) regs[DS1306_SR] |= (1 << DS1306_SR_IRQF1);
+}
+
+// INT0 is asserted while IRQF0 and AIE0 are both set
+bool DS1306Emulator::getInt0()
+{
+	return ((regs[DS1306_SR] & (1 << DS1306_SR_IRQF0)) && (regs[DS1306_CR] & (1 << DS1306_CR_AIE0))) ? true : false;
+}
+
+// INT1 is asserted while IRQF1 and AIE1 are both set
+bool DS1306Emulator::getInt1()
+{
+	return ((regs[DS1306_SR] & (1 << DS1306_SR_IRQF1)) && (regs[DS1306_CR] & (1 << DS1306_CR_AIE1))) ? true : false;
+}
+
+// Read a register directly, with no side effects
+unsigned char DS1306Emulator::peek(unsigned char address)
+{
+	return regs[address & (DS1306_EMU_REGISTERS - 1)];
+}
+
+// Write a register directly, ignoring write protection and read only semantics
+void DS1306Emulator::poke(unsigned char address, unsigned char value)
+{
+	regs[address & (DS1306_EMU_REGISTERS - 1)] = value;
+}
+
+// Number of transactions (chip enable cycles) since last reset
+unsigned long DS1306Emulator::getTransactionCount()
+{
+	return transactions;
+}
+
+// Number of bytes clocked (address and data) since last reset
+unsigned long DS1306Emulator::getByteCount()
+{
+	return bytes;
+}
+
+// Reset bus cost counters
+void DS1306Emulator::resetCounters()
+{
+	transactions = 0;
+	bytes = 0;
+	errors = 0;
+}
+
+// SPI clock divider the master is using, called by the driver on each transaction
+void DS1306Emulator::setClockDivider(unsigned char divider)
+{
+	clockDivider = divider;
+}
+
+// Smallest divider (fastest clock) read back correctly, 0 to accept every rate
+// Persists across reset(), as it models the board rather than the chip's state
+void DS1306Emulator::setFastestDivider(unsigned char divider)
+{
+	fastestDivider = divider;
+}
+
+// Data bytes corrupted by an excessive clock rate since the counters were reset
+unsigned long DS1306Emulator::getErrorCount()
+{
+	return errors;
+}
+
+// Read a register as seen over SPI
+unsigned char DS1306Emulator::load(unsigned char address)
+{
+	touchAlarm(address);
+	if (address >= DS1306_EMU_RESERVED && address < DS1306_USER_START) return 0;
+	return regs[address];
+}
+
+// Write a register as seen over SPI
+void DS1306Emulator::store(unsigned char address, unsigned char value)
+{
+	touchAlarm(address);
+
+	if (regs[DS1306_CR] & (1 << DS1306_CR_WP)) {
+		// Write protected, only the WP bit itself may change
+		if (address == DS1306_CR) {
+			regs[DS1306_CR] = (regs[DS1306_CR] & ~(1 << DS1306_CR_WP)) | (value & (1 << DS1306_CR_WP));
+		}
+		return;
+	}
+
+	if (address == DS1306_CR) {
+		regs[DS1306_CR] = value & DS1306_EMU_CR_MASK;
+	} else if (address == DS1306_SR) {
+		// Read only
+	} else if (address >= DS1306_EMU_RESERVED && address < DS1306_USER_START) {
+		// Reserved
+	} else {
+		regs[address] = value;
+	}
+}
+
+// Accessing any register of an alarm clears that alarm's interrupt flag
+void DS1306Emulator::touchAlarm(unsigned char address)
+{
+	if (address >= DS1306_ALARM0 && address < DS1306_ALARM0 + DS1306_SIZE_ALARM) {
+		regs[DS1306_SR] &= ~(1 << DS1306_SR_IRQF0);
+	} else if (address >= DS1306_ALARM1 && address < DS1306_ALARM1 + DS1306_SIZE_ALARM) {
+		regs[DS1306_SR] &= ~(1 << DS1306_SR_IRQF1);
+	}
+}
+
+// Burst address auto increment, wrapping within clock or user memory space
+unsigned char DS1306Emulator::nextAddress(unsigned char address)
+{
+	if (address == DS1306_USER_START - 1) return DS1306_DATETIME;
+	if (address == DS1306_USER_END) return DS1306_USER_START;
+	return address + 1;
+}
+
+// Advance day of week and date, carrying into month and year
+void DS1306Emulator::tickDay()
+{
+	unsigned char *t = &regs[DS1306_DATETIME];
+
+	t[3] = (t[3] >= 7) ? 1 : t[3] + 1;
+
+	if (fromBCD(t[4]) >= daysInMonth(fromBCD(t[5]), fromBCD(t[6]))) {
+		t[4] = 0x01;
+		if (t[5] == 0x12) {
+			t[5] = 0x01;
+			t[6] = (t[6] == 0x99) ? 0x00 : incrementBCD(t[6]);
+		} else {
+			t[5] = incrementBCD(t[5]);
+		}
+	} else {
+		t[4] = incrementBCD(t[4]);
+	}
+}
+
+// True if the alarm at base matches the current time
+// Each field matches if equal or if the alarm field has DS1306_ANY set
+bool DS1306Emulator::alarmMatches(unsigned char base)
+{
+	const unsigned char *a = &regs[base];
+	const unsigned char *t = &regs[DS1306_DATETIME];
+
+	if (!(a[0] & DS1306_ANY) && a[0] != t[0]) return false;
+	if (!(a[1] & DS1306_ANY) && a[1] != t[1]) return false;
+	if (!(a[2] & DS1306_ANY) && hourTo24(a[2]) != hourTo24(t[2])) return false;
+	if (!(a[3] & DS1306_ANY) && a[3] != t[3]) return false;
+	return true;
+}
+
+// Convert an hour register (12 or 24 hour form) to a binary 24 hour value
+unsigned char DS1306Emulator::hourTo24(unsigned char hourByte)
+{
+	if (hourByte & 0x40) {
+		unsigned char hour = fromBCD(hourByte & 0x1F);
+		if (hour == 12) hour = 0;
+		return (hourByte & 0x20) ? hour + 12 : hour;
+	} else {
+		return fromBCD(hourByte & 0x3F);
+	}
+}
+
+// Days in a month (binary month 1 - 12, year 00 - 99 representing 2000 - 2099)
+unsigned char DS1306Emulator::daysInMonth(unsigned char month, unsigned char year)
+{
+	switch (month) {
+		case 2	:	return (year & 0x03) ? 28 : 29;
+		case 4	:
+		case 6	:
+		case 9	:
+		case 11	:	return 30;
+		default	:	return 31;
+	}
+}
+
+// Increment a BCD value by one (no range check)
+unsigned char DS1306Emulator::incrementBCD(unsigned char value)
+{
+	return ((value & 0x0F) == 0x09) ? (value & 0xF0) + 0x10 : value + 1;
+}
+
+// Convert a BCD value to binary
+unsigned char DS1306Emulator::fromBCD(unsigned char value)
+{
+	return ((value >> 4) * 10) + (value & 0x0F);
+}
@@ -0,0 +1,114 @@
+/*
+ * File			DS1306Emulator.h
+ *
+ * Synopsis		Software model of the DS1306 register file and SPI slave interface
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			The emulator models the full 0x00 - 0x7F register space of the DS1306 as seen over SPI.
+ * 			It is used as the bus when the library is built off target (no ARDUINO define), allowing
+ * 			the driver to be compiled, tested and profiled on a host.
+ *
+ * 			Attach an emulator to a DS1306 instance with DS1306::attach() prior to calling init().
+ *
+ * 			Each transaction is select(), an address byte, any number of data bytes, then deselect().
+ * 			Address bytes with DS1306_WRITE_OFFSET set are writes. The address pointer auto increments
+ * 			on each data byte, wrapping 0x1F -> 0x00 in clock space and 0x7F -> 0x20 in user memory.
+ *
+ * 			Chip behavior modeled:
+ * 				- When WP is set in CR, all writes are ignored except to the WP bit itself
+ * 				- SR is read only; IRQF0 / IRQF1 are cleared when any alarm 0 / alarm 1 register is
+ * 				  read or written
+ * 				- Registers 0x12 - 0x1F are reserved, read as zero and ignore writes
+ * 				- tick() advances the clock one second (BCD, 12 or 24 hour) and evaluates both alarms,
+ * 				  honoring DS1306_ANY in any alarm field
+ * 				- Optionally, a maximum SPI clock rate (setFastestDivider). The driver reports the divider
+ * 				  it is using on each transaction; above the maximum rate, data read from the chip comes
+ * 				  back rotated by one bit, as if sampled a bit late. Writes are unaffected.
+ *
+ * 			Transaction and byte counters are kept so bus cost per API call can be measured.
+ */
+#ifndef __DS1306_EMULATOR_
+#define __DS1306_EMULATOR_
+
+/* Number of registers in the emulated address space */
+#define DS1306_EMU_REGISTERS	0x80
+
+class DS1306Emulator
+{
+	public:
+
+	// Constructor, emulator starts in power on state
+	DS1306Emulator();
+
+	// Return emulator to power on state (clock zeroed, write protected, counters reset)
+	void reset();
+
+	// SPI slave interface
+	void select();
+	unsigned char transfer(unsigned char in);
+	void deselect();
+
+	// Advance the clock by one second and evaluate alarms
+	void tick();
+
+	// State of the (active low) interrupt lines, true means asserted
+	bool getInt0();
+	bool getInt1();
+
+	// Direct register access, bypassing SPI semantics (for test setup and inspection)
+	unsigned char peek(unsigned char address);
+	void poke(unsigned char address, unsigned char value);
+
+	// SPI clock rate, the divider in use (set by the driver) and the smallest tolerated (0 for any)
+	void setClockDivider(unsigned char divider);
+	void setFastestDivider(unsigned char divider);
+	unsigned long getErrorCount();
+
+	// Bus cost counters
+	unsigned long getTransactionCount();
+	unsigned long getByteCount();
+	void resetCounters();
+
+	private:
+
+	// Register file
+	unsigned char regs[DS1306_EMU_REGISTERS];
+
+	// Transaction state
+	bool selected;				// CE is high
+	bool addressed;				// Address byte has been received for this transaction
+	bool writing;				// Current transaction is a write
+	unsigned char pointer;		// Current address pointer
+
+	// SPI clock rate
+	unsigned char clockDivider;
+	unsigned char fastestDivider;
+
+	// Counters
+	unsigned long transactions;
+	unsigned long bytes;
+	unsigned long errors;		// Bytes read back corrupted by an excessive clock rate
+
+	// Register access honoring chip semantics
+	unsigned char load(unsigned char address);
+	void store(unsigned char address, unsigned char value);
+	void touchAlarm(unsigned char address);
+	unsigned char nextAddress(unsigned char address);
+
+	// Clock support
+	void tickDay();
+	bool alarmMatches(unsigned char base);
+	unsigned char hourTo24(unsigned char hourByte);
+	unsigned char daysInMonth(unsigned char month, unsigned char year);
+	unsigned char incrementBCD(unsigned char value);
+	unsigned char fromBCD(unsigned char value);
+};
+
+#endif /* __DS1306_EMULATOR_ */
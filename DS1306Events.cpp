@@ -0,0 +1,133 @@
+/*
+ * File			DS1306Events.cpp
+ *
+ * Synopsis		Interrupt driven capture of DS1306 alarm events
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "DS1306Events.h"
+
+#if DS1306_ALARMS
+// Multi-byte state shared with the interrupt handlers must be accessed with interrupts masked
+#ifdef ARDUINO
+#define DS1306_EVENTS_LOCK()		noInterrupts()
+#define DS1306_EVENTS_UNLOCK()		interrupts()
+#else
+#define DS1306_EVENTS_LOCK()
+#define DS1306_EVENTS_UNLOCK()
+#endif
+
+#define DS1306_EVENT_MASK			(DS1306_EVENT_QUEUE - 1)
+
+// Constructor
+DS1306Events::DS1306Events(DS1306 *rtc) : rtc(rtc), clock(0), head(0), tail(0), pendingClear(0), overflows(0)
+{
+#ifdef ARDUINO
+	microsSource = micros;
+#else
+	microsSource = 0;
+#endif
+}
+
+// Timestamp events with the RAM time of clock, 0 to stop
+void DS1306Events::setClock(DS1306SoftClock *clock)
+{
+	this->clock = clock;
+}
+
+// Provide the microsecond time source used to timestamp events
+void DS1306Events::setMicrosSource(unsigned long (*source)())
+{
+	microsSource = source;
+}
+
+// Alarm 0 interrupt (INT0 falling edge)
+void DS1306Events::onInt0()
+{
+	capture(0);
+}
+
+// Alarm 1 interrupt (INT1 rising edge)
+void DS1306Events::onInt1()
+{
+	capture(1);
+}
+
+// Remove the oldest event, returns false (event untouched) if there is none
+bool DS1306Events::getEvent(ds1306event *event)
+{
+	unsigned char t = tail;
+	if (t == head) return false;
+
+	*event = events[t];
+	tail = (t + 1) & DS1306_EVENT_MASK;
+	return true;
+}
+
+// Number of events waiting
+unsigned char DS1306Events::available()
+{
+	return (head - tail) & DS1306_EVENT_MASK;
+}
+
+// Clear the alarm flags of alarms that have fired since the last call
+// Both flags are cleared in one transaction, by a burst across the boundary of the alarm registers
+void DS1306Events::service()
+{
+	DS1306_EVENTS_LOCK();
+	unsigned char pending = pendingClear;
+	pendingClear = 0;
+	DS1306_EVENTS_UNLOCK();
+
+	if (pending == 0x03) {
+		rtc->clearAlarmBothState();
+	} else if (pending) {
+		rtc->clearAlarmState(pending >> 1);
+	}
+}
+
+// Events dropped because the buffer was full
+unsigned int DS1306Events::getOverflows()
+{
+	DS1306_EVENTS_LOCK();
+	unsigned int count = overflows;
+	DS1306_EVENTS_UNLOCK();
+	return count;
+}
+
+// Reset the overflow count
+void DS1306Events::resetOverflows()
+{
+	DS1306_EVENTS_LOCK();
+	overflows = 0;
+	DS1306_EVENTS_UNLOCK();
+}
+
+// Record an event, called in interrupt context
+// The slot is filled before head is advanced, so the consumer never sees a partial event
+void DS1306Events::capture(unsigned char alarm)
+{
+	pendingClear |= (1 << alarm);
+
+	unsigned char h = head;
+	unsigned char next = (h + 1) & DS1306_EVENT_MASK;
+	if (next == tail) {
+		overflows++;
+		return;
+	}
+
+	events[h].alarm = alarm;
+	events[h].epoch = clock ? clock->peekEpoch() : 0;
+	events[h].microseconds = microsSource ? microsSource() : 0;
+	head = next;
+}
+
+#endif
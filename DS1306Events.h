@@ -0,0 +1,94 @@
+/*
+ * File			DS1306Events.h
+ *
+ * Synopsis		Interrupt driven capture of DS1306 alarm events
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Wire the DS1306 INT0 output (active low) and, if used, INT1 (active high) to interrupt
+ * 			capable pins. Create a DS1306Events for an initialized DS1306 and call onInt0() / onInt1()
+ * 			from the handlers for those pins, attached on the FALLING and RISING edge respectively.
+ *
+ * 			The handlers never use the SPI bus. Each records which alarm fired and when into a single
+ * 			producer / single consumer ring buffer, holding up to DS1306_EVENT_QUEUE - 1 events (see
+ * 			DS1306Config.h). The timestamp holds the RAM time of a DS1306SoftClock when one is given to
+ * 			setClock() (otherwise 0) and a micros() reading (host builds: see setMicrosSource()).
+ *
+ * 			From loop(), getEvent() removes the oldest event without blocking, returning false when
+ * 			there is none. service() clears the alarm flags recorded since the last call, in a single
+ * 			transaction for both alarms; until a flag is cleared its INT line stays asserted and that
+ * 			alarm cannot signal again. Events arriving while the buffer is full are dropped and counted
+ * 			by getOverflows().
+ *
+ * 			The alarm flags live in SR, which is read only; as with DS1306::clearAlarmState the chip
+ * 			clears them when the alarm registers are accessed.
+ */
+#ifndef __DS1306_EVENTS_
+#define __DS1306_EVENTS_
+
+#include "DS1306.h"
+#include "DS1306SoftClock.h"
+
+/* Alarm events need the alarm API, see DS1306_ALARMS in DS1306Config.h */
+#if DS1306_ALARMS
+#if (DS1306_EVENT_QUEUE & (DS1306_EVENT_QUEUE - 1)) || DS1306_EVENT_QUEUE > 128
+#error DS1306_EVENT_QUEUE must be a power of two no greater than 128
+#endif
+
+/* A captured alarm event */
+typedef struct {
+	unsigned char alarm;		// 0 or 1
+	unsigned long epoch;		// Soft clock time when captured, 0 without a soft clock
+	unsigned long microseconds;	// micros() when captured
+} ds1306event;
+
+class DS1306Events
+{
+	public:
+
+	// Constructor, rtc must be initialized before service() is called
+	DS1306Events(DS1306 *rtc);
+
+	// Timestamp sources
+	void setClock(DS1306SoftClock *clock);
+	void setMicrosSource(unsigned long (*source)());
+
+	// Call from the INT0 / INT1 pin interrupt handlers
+	void onInt0();
+	void onInt1();
+
+	// Consumer side, call from loop()
+	bool getEvent(ds1306event *event);
+	unsigned char available();
+	void service();
+
+	// Events dropped because the buffer was full
+	unsigned int getOverflows();
+	void resetOverflows();
+
+	private:
+
+	DS1306 *rtc;
+	DS1306SoftClock *clock;
+	unsigned long (*microsSource)();
+
+	// Ring buffer, head is written only by the interrupt handlers and tail only by the consumer
+	ds1306event events[DS1306_EVENT_QUEUE];
+	volatile unsigned char head;
+	volatile unsigned char tail;
+
+	volatile unsigned char pendingClear;	// Bit per alarm whose flag is awaiting service()
+	volatile unsigned int overflows;
+
+	void capture(unsigned char alarm);
+};
+
+#endif
+
+#endif /* __DS1306_EVENTS_ */
@@ -0,0 +1,187 @@
+/*
+ * File			DS1306Iso.cpp
+ *
+ * Synopsis		ISO 8601 text for DS1306 times, without printf
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#include "DS1306Iso.h"
+#include "DS1306BCD.h"
+
+// Last day of each month in BCD, February in a common year
+static const unsigned char lastDay[12] DS1306_PROGMEM = {
+	0x31, 0x28, 0x31, 0x30, 0x31, 0x30, 0x31, 0x31, 0x30, 0x31, 0x30, 0x31
+};
+
+// Format from the registers, hours in 24 hour form whichever form the register holds
+unsigned char DS1306Iso::format(char *buf, const DS1306RawTime *time)
+{
+	return formatBCD(buf, time->regs, DS1306RawTime::hourOrder(time->regs[2]), 0);
+}
+
+// Format a decoded time from its 24 hour form hours
+unsigned char DS1306Iso::format(char *buf, const ds1306time *time)
+{
+	unsigned char regs[DS1306_SIZE_DATETIME];
+	regs[0] = DS1306BCD::encode(time->seconds);
+	regs[1] = DS1306BCD::encode(time->minutes);
+	regs[4] = DS1306BCD::encode(time->day);
+	regs[5] = DS1306BCD::encode(time->month);
+	regs[6] = DS1306BCD::encode(time->year);
+	return formatBCD(buf, regs, DS1306BCD::encode(time->hours), 0);
+}
+
+// Format from the registers in 12 hour form, whichever form the register holds
+unsigned char DS1306Iso::format12(char *buf, const DS1306RawTime *time)
+{
+	unsigned char hourByte = time->regs[2];
+	unsigned char hours;
+	char ampm;
+
+	if (hourByte & 0x40) {
+		hours = hourByte & 0x1F;
+		ampm = (hourByte & 0x20) ? 'P' : 'A';
+	} else {
+		hours = toHour12(hourByte & 0x3F, &ampm);
+	}
+	return formatBCD(buf, time->regs, hours, ampm);
+}
+
+// Format a decoded time in 12 hour form, from its 24 hour form hours
+unsigned char DS1306Iso::format12(char *buf, const ds1306time *time)
+{
+	unsigned char regs[DS1306_SIZE_DATETIME];
+	char ampm;
+
+	regs[0] = DS1306BCD::encode(time->seconds);
+	regs[1] = DS1306BCD::encode(time->minutes);
+	regs[4] = DS1306BCD::encode(time->day);
+	regs[5] = DS1306BCD::encode(time->month);
+	regs[6] = DS1306BCD::encode(time->year);
+	unsigned char hours = toHour12(DS1306BCD::encode(time->hours), &ampm);
+	return formatBCD(buf, regs, hours, ampm);
+}
+
+// Parse into registers, hours in 24 hour form or (hours24 false) 12 hour form, day of week calculated
+unsigned char DS1306Iso::parse(const char *str, DS1306RawTime *time, bool hours24)
+{
+	unsigned char regs[DS1306_SIZE_DATETIME];
+	unsigned char century;
+	unsigned char hours;
+	char ampm = 0;
+
+	// Fixed layout, each test fails on the terminating 0 before reading past it
+	if (!getDigits(&str[0], &century) || century != 0x20 || !getDigits(&str[2], &regs[6]) || str[4] != '-' ||
+		!getDigits(&str[5], &regs[5]) || str[7] != '-' || !getDigits(&str[8], &regs[4]) ||
+		(str[10] != 'T' && str[10] != ' ') || !getDigits(&str[11], &hours) || str[13] != ':' ||
+		!getDigits(&str[14], &regs[1]) || str[16] != ':' || !getDigits(&str[17], &regs[0])) {
+		return 0;
+	}
+	unsigned char len = 19;
+
+	// Optional AM / PM
+	const char *suffix = &str[(str[19] == ' ') ? 20 : 19];
+	if ((suffix[0] == 'A' || suffix[0] == 'a' || suffix[0] == 'P' || suffix[0] == 'p') &&
+		(suffix[1] == 'M' || suffix[1] == 'm')) {
+		ampm = (suffix[0] == 'P' || suffix[0] == 'p') ? 'P' : 'A';
+		len = suffix + 2 - str;
+	}
+
+	// Valid BCD compares in numeric order, so ranges are checked without decoding
+	unsigned char month = regs[5];
+	if (month < 0x01 || month > 0x12 || regs[1] > 0x59 || regs[0] > 0x59) return 0;
+
+	unsigned char last = DS1306_PGM_BYTE(&lastDay[DS1306BCD::decode(month) - 1]);
+	if (month == 0x02 && !(DS1306BCD::decode(regs[6]) & 0x03)) last = 0x29;
+	if (regs[4] < 0x01 || regs[4] > last) return 0;
+
+	if (ampm) {
+		if (hours < 0x01 || hours > 0x12) return 0;
+		hours |= 0x40 | ((ampm == 'P') ? 0x20 : 0);
+		regs[2] = hours24 ? DS1306RawTime::hourOrder(hours) : hours;
+	} else {
+		if (hours > 0x23) return 0;
+		if (hours24) {
+			regs[2] = hours;
+		} else {
+			regs[2] = 0x40 | toHour12(hours, &ampm);
+			if (ampm == 'P') regs[2] |= 0x20;
+		}
+	}
+
+	for (unsigned char i = 0; i < DS1306_SIZE_DATETIME; i++) {
+		time->regs[i] = regs[i];
+	}
+	time->regs[3] = time->calculateDow();
+	return len;
+}
+
+// Parse into a decoded time, ready for DS1306::setTime
+unsigned char DS1306Iso::parse(const char *str, ds1306time *time)
+{
+	DS1306RawTime raw;
+	unsigned char len = parse(str, &raw, true);
+	if (len) raw.decode(time);
+	return len;
+}
+
+// Write 20YY-MM-DD, the separator, HH:MM:SS and, for 12 hour form (ampm set), the AM / PM suffix
+unsigned char DS1306Iso::formatBCD(char *buf, const unsigned char *regs, unsigned char hours, char ampm)
+{
+	char *p = buf;
+
+	p = putDigits(p, 0x20);
+	p = putDigits(p, regs[6]);
+	*p++ = '-';
+	p = putDigits(p, regs[5] & 0x1F);
+	*p++ = '-';
+	p = putDigits(p, regs[4] & 0x3F);
+	*p++ = ampm ? ' ' : 'T';
+	p = putDigits(p, hours);
+	*p++ = ':';
+	p = putDigits(p, regs[1] & 0x7F);
+	*p++ = ':';
+	p = putDigits(p, regs[0] & 0x7F);
+	if (ampm) {
+		*p++ = ' ';
+		*p++ = ampm;
+		*p++ = 'M';
+	}
+	*p = 0;
+	return p - buf;
+}
+
+// Each BCD nibble is one digit
+char *DS1306Iso::putDigits(char *p, unsigned char bcd)
+{
+	p[0] = '0' + (bcd >> 4);
+	p[1] = '0' + (bcd & 0x0F);
+	return p + 2;
+}
+
+// 12 hour form of a 24 hour BCD hour, subtracting BCD 12 with a decimal adjust for PM
+unsigned char DS1306Iso::toHour12(unsigned char hour, char *ampm)
+{
+	*ampm = (hour >= 0x12) ? 'P' : 'A';
+	if (hour >= 0x12) {
+		hour -= 0x12;
+		if ((hour & 0x0F) > 0x09) hour -= 0x06;
+	}
+	return hour ? hour : 0x12;
+}
+
+// Two ASCII digits as a BCD byte
+bool DS1306Iso::getDigits(const char *p, unsigned char *bcd)
+{
+	unsigned char high = p[0] - '0';
+	if (high > 9) return false;
+	unsigned char low = p[1] - '0';
+	if (low > 9) return false;
+	*bcd = (high << 4) | low;
+	return true;
+}
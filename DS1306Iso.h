@@ -0,0 +1,68 @@
+/*
+ * File			DS1306Iso.h
+ *
+ * Synopsis		ISO 8601 text for DS1306 times, without printf
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			DS1306Iso::format() writes a time as YYYY-MM-DDTHH:MM:SS into a caller buffer of at least
+ * 			DS1306_ISO_SIZE bytes, and format12() as YYYY-MM-DD hh:MM:SS AM (or PM) into one of at
+ * 			least DS1306_ISO_SIZE_12. Both add a terminating 0 and return the length written.
+ *
+ * 			Given a DS1306RawTime (from DS1306::getRawTime) each BCD register nibble becomes a digit by
+ * 			adding '0', with no decimal conversion, whichever hour form the register holds. A ds1306time
+ * 			is formatted from its binary fields instead. Neither uses the heap, printf or division.
+ *
+ * 			parse() reads the same forms back, with 'T' or a space between date and time, and an
+ * 			optional AM / PM suffix (with or without a space before it) making the hour 12 hour form.
+ * 			It returns the number of characters read, so text may follow, or 0 if the text is not a
+ * 			valid time between 2000 and 2099, leaving the time untouched. The ds1306time it fills,
+ * 			day of week included (DS1306_SUNDAY = 1), can be passed straight to DS1306::setTime; a
+ * 			DS1306RawTime is filled digit by digit, in 24 or 12 hour register form as hours24 selects.
+ */
+#ifndef __DS1306_ISO_
+#define __DS1306_ISO_
+
+#include "DS1306.h"
+#include "DS1306RawTime.h"
+
+/* Buffer sizes, including the terminating 0 */
+#define DS1306_ISO_SIZE			20		// YYYY-MM-DDTHH:MM:SS
+#define DS1306_ISO_SIZE_12		23		// YYYY-MM-DD hh:MM:SS AM
+
+class DS1306Iso
+{
+	public:
+
+	// Format a time, returns the length written (excluding the terminating 0)
+	static unsigned char format(char *buf, const DS1306RawTime *time);
+	static unsigned char format(char *buf, const ds1306time *time);
+	static unsigned char format12(char *buf, const DS1306RawTime *time);
+	static unsigned char format12(char *buf, const ds1306time *time);
+
+	// Parse a time, returns the number of characters read or 0 if invalid
+	static unsigned char parse(const char *str, DS1306RawTime *time, bool hours24 = true);
+	static unsigned char parse(const char *str, ds1306time *time);
+
+	private:
+
+	// Lay out text from BCD fields
+	static unsigned char formatBCD(char *buf, const unsigned char *regs, unsigned char hours, char ampm);
+
+	// Two digits from a BCD byte
+	static char *putDigits(char *p, unsigned char bcd);
+
+	// 12 hour BCD hour of a 24 hour BCD hour, setting ampm to 'A' or 'P'
+	static unsigned char toHour12(unsigned char hour, char *ampm);
+
+	// Two ASCII digits as a BCD byte, false unless both are digits
+	static bool getDigits(const char *p, unsigned char *bcd);
+};
+
+#endif /* __DS1306_ISO_ */
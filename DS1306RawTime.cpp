@@ -0,0 +1,373 @@
+/*
+ * File			DS1306RawTime.cpp
+ *
+ * Synopsis		Undecoded view of the DS1306 time/date registers
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#include "DS1306RawTime.h"
+
+// Days before the first of each month in a non leap year
+static const unsigned int daysBeforeMonth[12] DS1306_PROGMEM = {
+	0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+// Days from 2000-01-01 to January 1st of year (00 - 99)
+// Within the DS1306's range (2000 - 2099) every fourth year from 2000 is a leap year
+static unsigned int daysBeforeYear(unsigned char year)
+{
+	return 365U * year + ((year + 3) >> 2);
+}
+
+// Hour in 24 hour form, regardless of the form held in the register
+unsigned char DS1306RawTime::getHours() const
+{
+	unsigned char hourByte = regs[2];
+	if (hourByte & 0x40) {
+		unsigned char hour12 = DS1306BCD::decode(hourByte & 0x1F);
+		if (hour12 == 12) hour12 = 0;
+		return (hourByte & 0x20) ? hour12 + 12 : hour12;
+	} else {
+		return DS1306BCD::decode(hourByte & 0x3F);
+	}
+}
+
+// Hour in 12 hour form, regardless of the form held in the register
+unsigned char DS1306RawTime::getHours12() const
+{
+	if (regs[2] & 0x40) return DS1306BCD::decode(regs[2] & 0x1F);
+
+	unsigned char hour24 = DS1306BCD::decode(regs[2] & 0x3F);
+	if (hour24 == 0) return 12;
+	return (hour24 > 12) ? hour24 - 12 : hour24;
+}
+
+// AM/PM indicator, 'A' or 'P'
+char DS1306RawTime::getAmPm() const
+{
+	if (regs[2] & 0x40) return (regs[2] & 0x20) ? 'P' : 'A';
+	return (regs[2] >= 0x12) ? 'P' : 'A';
+}
+
+// Decode all fields, producing the same result as DS1306::getTime
+void DS1306RawTime::decode(ds1306time *time) const
+{
+	DS1306::decodeTimePacket(regs, time);
+}
+
+// Seconds since 2000-01-01 00:00:00, computed from the registers with no division
+// Returns 0 if the month register is out of range
+unsigned long DS1306RawTime::getEpoch() const
+{
+	unsigned char month = getMonth();
+	if (month < 1 || month > 12) return 0;
+
+	return (((unsigned long) dayNumber() * 24 + getHours()) * 60 + getMinutes()) * 60 + getSeconds();
+}
+
+// Set the registers from seconds since 2000-01-01 00:00:00 (up to DS1306_EPOCH_MAX)
+// Hours are stored in 24 hour form, or 12 hour form when hours24 is false
+// Day of week follows the suggested numbering (DS1306_SUNDAY = 1), 2000-01-01 being a Saturday
+// Quotients use reciprocal multiplication with a short correction instead of 32 bit division
+void DS1306RawTime::setEpoch(unsigned long epoch, bool hours24)
+{
+	// Days, estimated from the top 16 bits (65536 / 86400 ~= 49710 / 65536), never over estimates
+	unsigned int days = (unsigned int) (((epoch >> 16) * 49710UL) >> 16);
+	unsigned long rem = epoch - (unsigned long) days * 86400UL;
+	while (rem >= 86400UL) {
+		rem -= 86400UL;
+		days++;
+	}
+
+	setTimeOfDay(rem, hours24);
+	setDayNumber(days);
+}
+
+// Compare chronologically with other, returning <0 if this is earlier, 0 if equal, >0 if later
+// BCD bytes order the same way as the values they encode, so no decode is required
+int DS1306RawTime::compare(const DS1306RawTime *other) const
+{
+	const unsigned char *a = regs;
+	const unsigned char *b = other->regs;
+
+	if (a[6] != b[6]) return (int) a[6] - (int) b[6];
+	if ((a[5] & 0x3F) != (b[5] & 0x3F)) return (int) (a[5] & 0x3F) - (int) (b[5] & 0x3F);
+	if ((a[4] & 0x3F) != (b[4] & 0x3F)) return (int) (a[4] & 0x3F) - (int) (b[4] & 0x3F);
+
+	unsigned char ha = hourOrder(a[2]);
+	unsigned char hb = hourOrder(b[2]);
+	if (ha != hb) return (int) ha - (int) hb;
+
+	if ((a[1] & 0x7F) != (b[1] & 0x7F)) return (int) (a[1] & 0x7F) - (int) (b[1] & 0x7F);
+	return (int) (a[0] & 0x7F) - (int) (b[0] & 0x7F);
+}
+
+// Map an hour register to its 24 hour BCD value, so 12 and 24 hour forms compare directly
+// In 12 hour form 12 maps to 0 and PM adds BCD 12, with a decimal adjust of the low nibble
+unsigned char DS1306RawTime::hourOrder(unsigned char hourByte)
+{
+	if (!(hourByte & 0x40)) return hourByte & 0x3F;
+
+	unsigned char hour = hourByte & 0x1F;
+	if (hour == 0x12) hour = 0;
+	if (hourByte & 0x20) {
+		hour += 0x12;
+		if ((hour & 0x0F) > 0x09) hour += 0x06;
+	}
+	return hour;
+}
+
+// Packed key, ((((year * 12 + month - 1) * 31 + day - 1) * 24 + hour) << 12) | minutes << 6 | seconds
+// Every field ranks below the one before it, so integer order is chronological order
+// The day-hour count is at most 892799 and fits the top 20 bits
+unsigned long DS1306RawTime::getKey() const
+{
+	unsigned int days = ((unsigned int) getYear() * 12 + getMonth() - 1) * 31 + getDay() - 1;
+	unsigned long hours = (unsigned long) days * 24 + getHours();
+	return (hours << 12) | ((unsigned int) getMinutes() << 6) | getSeconds();
+}
+
+// Set the registers from a packed key, hours in 24 hour form or 12 hour form when hours24 is false
+// The day of week is calculated from the date
+void DS1306RawTime::setKey(unsigned long key, bool hours24)
+{
+	// Day-hour count / 24 as (count / 8) / 3, (x * 21845) >> 16 never over estimates x / 3
+	unsigned long count = key >> 12;
+	unsigned int days = (unsigned int) (((count >> 3) * 21845UL) >> 16);
+	unsigned char hours = (unsigned char) (count - (unsigned long) days * 24);
+	while (hours >= 24) {
+		hours -= 24;
+		days++;
+	}
+
+	// Days / 31 and months / 12 likewise, with (x * 2114) >> 16 and (x * 5461) >> 16
+	unsigned int months = (unsigned int) (((unsigned long) days * 2114UL) >> 16);
+	unsigned char day = days - months * 31;
+	while (day >= 31) {
+		day -= 31;
+		months++;
+	}
+	unsigned char year = (unsigned char) (((unsigned long) months * 5461UL) >> 16);
+	unsigned char month = months - year * 12;
+	while (month >= 12) {
+		month -= 12;
+		year++;
+	}
+
+	setTimeOfDay((unsigned long) hours * 3600 + ((key >> 6) & 0x3F) * 60 + (key & 0x3F), hours24);
+	regs[4] = DS1306BCD::encode(day + 1);
+	regs[5] = DS1306BCD::encode(month + 1);
+	regs[6] = DS1306BCD::encode(year);
+	regs[3] = calculateDow();
+}
+
+// Packed key of a decoded time, from its 24 hour form hours
+unsigned long DS1306RawTime::makeKey(const ds1306time *time)
+{
+	return DS1306_TIME_KEY(time->year, time->month, time->day, time->hours, time->minutes, time->seconds);
+}
+
+// Move the time by seconds (negative to go back)
+// Only the time of day registers are rewritten unless the day changes
+void DS1306RawTime::addSeconds(long seconds)
+{
+	long time = (long) getHours() * 3600 + getMinutes() * 60 + getSeconds() + seconds;
+	long days = 0;
+
+	if (time < 0 || time >= 86400L) {
+		days = time / 86400L;
+		time -= days * 86400L;
+		if (time < 0) {
+			time += 86400L;
+			days--;
+		}
+	}
+
+	setTimeOfDay(time, !(regs[2] & 0x40));
+	if (days) addDays(days);
+}
+
+// Move the date by days (negative to go back), updating the day of week
+void DS1306RawTime::addDays(long days)
+{
+	setDayNumber((unsigned int) (dayNumber() + days));
+}
+
+// Seconds from other to this time, positive when this time is later
+long DS1306RawTime::secondsSince(const DS1306RawTime *other) const
+{
+	return (long) (getEpoch() - other->getEpoch());
+}
+
+// Day of week of the date held, 2000-01-01 being a Saturday
+// x / 7 == (x * 18725) >> 17 for x < 36600
+unsigned char DS1306RawTime::calculateDow() const
+{
+	unsigned int weekday = dayNumber() + 6;
+	weekday -= (unsigned int) (((unsigned long) weekday * 18725UL) >> 17) * 7;
+	return weekday + 1;
+}
+
+// Days since 2000-01-01 of the date held
+unsigned int DS1306RawTime::dayNumber() const
+{
+	unsigned char year = getYear();
+	unsigned char month = getMonth();
+	if (month < 1 || month > 12) return 0;
+
+	unsigned int days = daysBeforeYear(year) + DS1306_PGM_WORD(&daysBeforeMonth[month - 1]) + getDay() - 1;
+	if (month > 2 && !(year & 0x03)) days++;
+	return days;
+}
+
+// Set day of week, day, month and year from days since 2000-01-01
+void DS1306RawTime::setDayNumber(unsigned int days)
+{
+	// Day of week, x / 7 == (x * 18725) >> 17 for x < 36600
+	unsigned int weekday = days + 6;
+	weekday -= (unsigned int) (((unsigned long) weekday * 18725UL) >> 17) * 7;
+
+	// Year, estimated from 2^20 / 365.25 ~= 2871 then corrected by at most one
+	unsigned char year = (unsigned char) (((unsigned long) days * 2871UL) >> 20);
+	if (daysBeforeYear(year) > days) year--;
+	if (year < 99 && daysBeforeYear(year + 1) <= days) year++;
+
+	// Month and day by scanning the month table
+	unsigned int doy = days - daysBeforeYear(year);
+	unsigned char leap = (year & 0x03) ? 0 : 1;
+	unsigned char month = 11;
+	while (month > 0 && doy < DS1306_PGM_WORD(&daysBeforeMonth[month]) + (month >= 2 ? leap : 0)) month--;
+	unsigned char day = doy - DS1306_PGM_WORD(&daysBeforeMonth[month]) - (month >= 2 ? leap : 0) + 1;
+
+	regs[3] = weekday + 1;
+	regs[4] = DS1306BCD::encode(day);
+	regs[5] = DS1306BCD::encode(month + 1);
+	regs[6] = DS1306BCD::encode(year);
+}
+
+// Set seconds, minutes and hours from seconds since midnight (below 86400)
+// x / 3600 == (x * 37283) >> 27 for x < 86400 and x / 60 == (x * 17477) >> 20 for x < 3600
+void DS1306RawTime::setTimeOfDay(unsigned long seconds, bool hours24)
+{
+	unsigned char hours = (unsigned char) ((seconds * 37283UL) >> 27);
+	unsigned int secs = (unsigned int) (seconds - hours * 3600UL);
+	unsigned char minutes = (unsigned char) (((unsigned long) secs * 17477UL) >> 20);
+	secs -= minutes * 60;
+
+	regs[0] = DS1306BCD::encode(secs);
+	regs[1] = DS1306BCD::encode(minutes);
+	if (hours24) {
+		regs[2] = DS1306BCD::encode(hours);
+	} else {
+		unsigned char hours12 = (hours >= 12) ? hours - 12 : hours;
+		if (hours12 == 0) hours12 = 12;
+		regs[2] = 0x40 | (hours >= 12 ? 0x20 : 0x00) | DS1306BCD::encode(hours12);
+	}
+}
+
+#if DS1306_ALARMS
+// Seconds until the alarm next fires, DS1306_ALARM_NEVER if it never can
+unsigned long DS1306RawTime::secondsToAlarm(const ds1306alarm *alarm, bool hours24) const
+{
+	return alarmDelay(getHours(), getMinutes(), getSeconds(), getDow(), alarm, hours24);
+}
+
+// Time at which the alarm next fires, in the hour form held, false (next untouched) if it never can
+bool DS1306RawTime::nextAlarm(const ds1306alarm *alarm, DS1306RawTime *next, bool hours24) const
+{
+	unsigned long delay = secondsToAlarm(alarm, hours24);
+	if (delay == DS1306_ALARM_NEVER) return false;
+
+	*next = *this;
+	next->addSeconds(delay);
+
+	// Keep the register's day of week numbering, which addSeconds() does not know
+	unsigned char dow = getDow() - 1 + next->dayNumber() - dayNumber();
+	next->regs[3] = (dow % 7) + 1;
+	return true;
+}
+
+// Seconds from a decoded time until the alarm next fires, DS1306_ALARM_NEVER if it never can
+unsigned long DS1306RawTime::secondsToAlarm(const ds1306time *time, const ds1306alarm *alarm, bool hours24)
+{
+	return alarmDelay(time->hours, time->minutes, time->seconds, time->dow, alarm, hours24);
+}
+
+// The chip fires an alarm in the second its time registers come to match every field not
+// DS1306_ANY, so the next firing is the first match strictly after the current second
+// Within a day the first match at or after a time is found field by field: the current hour if it
+// matches and a later minute and second in it do, else the next matching hour with its first
+// matching minute and second. The day of week then gives the number of whole days to add.
+unsigned long DS1306RawTime::alarmDelay(unsigned char hours, unsigned char minutes, unsigned char seconds, unsigned char dow,
+	const ds1306alarm *alarm, bool hours24)
+{
+	bool anySeconds = alarm->seconds & DS1306_ANY;
+	bool anyMinutes = alarm->minutes & DS1306_ANY;
+	bool anyHours = (hours24 ? alarm->hours : alarm->hours12) & DS1306_ANY;
+	bool anyDow = alarm->dow & DS1306_ANY;
+
+	unsigned char alarmHours = alarm->hours;
+	if (!hours24 && !anyHours) {
+		if (alarm->hours12 < 1 || alarm->hours12 > 12) return DS1306_ALARM_NEVER;
+		alarmHours = ((alarm->hours12 == 12) ? 0 : alarm->hours12) + ((alarm->ampm == 'P') ? 12 : 0);
+	}
+
+	if ((!anySeconds && alarm->seconds > 59) || (!anyMinutes && alarm->minutes > 59) ||
+		(!anyHours && alarmHours > 23) || (!anyDow && (alarm->dow < 1 || alarm->dow > 7))) {
+		return DS1306_ALARM_NEVER;
+	}
+
+	// First match of the day, at 00:00:00 or after
+	unsigned long first = (anyHours ? 0 : alarmHours * 3600UL) + (anyMinutes ? 0 : alarm->minutes * 60) +
+		(anySeconds ? 0 : alarm->seconds);
+
+	// First match later today, starting from the next second
+	unsigned long now = hours * 3600UL + minutes * 60 + seconds;
+	unsigned long today = DS1306_ALARM_NEVER;
+	unsigned char s = seconds + 1;
+	unsigned char m = minutes;
+	unsigned char h = hours;
+	if (s == 60) {
+		s = 0;
+		if (++m == 60) {
+			m = 0;
+			h++;
+		}
+	}
+
+	if (h < 24) {
+		if (anyHours || alarmHours == h) {
+			// This hour, this minute
+			if ((anyMinutes || alarm->minutes == m) && (anySeconds || alarm->seconds >= s)) {
+				today = h * 3600UL + m * 60 + (anySeconds ? s : alarm->seconds);
+			} else {
+				// This hour, a later minute
+				unsigned char later = anyMinutes ? m + 1 : alarm->minutes;
+				if (later > m && later < 60) today = h * 3600UL + later * 60 + (anySeconds ? 0 : alarm->seconds);
+			}
+		}
+		if (today == DS1306_ALARM_NEVER) {
+			// A later hour
+			unsigned char later = anyHours ? h + 1 : alarmHours;
+			if (later > h && later < 24) {
+				today = later * 3600UL + (anyMinutes ? 0 : alarm->minutes * 60) + (anySeconds ? 0 : alarm->seconds);
+			}
+		}
+	}
+
+	if (today != DS1306_ALARM_NEVER && (anyDow || alarm->dow == dow)) return today - now;
+
+	// A later day, tomorrow or the next with a matching day of week, up to a week ahead
+	unsigned char days = 1;
+	if (!anyDow) {
+		days = (alarm->dow + 7 - dow) % 7;
+		if (days == 0) days = 7;
+	}
+	return days * 86400UL + first - now;
+}
+#endif
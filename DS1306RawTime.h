@@ -0,0 +1,133 @@
+/*
+ * File			DS1306RawTime.h
+ *
+ * Synopsis		Undecoded view of the DS1306 time/date registers
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			DS1306::getRawTime fills a DS1306RawTime with the 7 BCD time/date registers exactly as read
+ * 			from the chip. Individual fields are decoded only when their accessor is called, so callers
+ * 			that need only the seconds, or only want to know whether the time has changed, skip the
+ * 			work of decoding the rest.
+ *
+ * 			compare() orders two raw times chronologically directly on the BCD bytes, handling a mix
+ * 			of 12 and 24 hour register forms, without decoding. Day of week is not compared.
+ *
+ * 			decode() produces the same ds1306time as DS1306::getTime.
+ *
+ * 			getEpoch() / setEpoch() convert between the registers and seconds since 2000-01-01 00:00:00
+ * 			(the DS1306 covers 2000 - 2099, so 0 - DS1306_EPOCH_MAX) without any 32 bit division.
+ *
+ * 			getKey() packs the time into an unsigned long whose integer order is chronological order,
+ * 			so logged times can be sorted and range checked with plain integer comparison. A pure
+ * 			bitfield of the six fields needs 33 bits, so year, month, day and hour are combined as
+ * 			a mixed radix day-hour count in the top 20 bits, with minutes and seconds as 6 bit fields
+ * 			below it. Building a key is a few small multiplies from the BCD registers; DS1306_TIME_KEY()
+ * 			gives the key of a constant time at compile time. Day of week is not part of the key.
+ *
+ * 			addSeconds() / addDays() move the time by a duration (negative to go back) working on
+ * 			the registers, touching only the time of day when the day does not change.
+ * 			secondsSince() is the difference between two times in seconds, calculateDow() the day of
+ * 			week of the date held. Results must stay within 2000 - 2099.
+ *
+ * 			secondsToAlarm() says how long after this time an alarm (from DS1306::getAlarm() or filled
+ * 			in by hand, any field DS1306_ANY) next fires, the chip matching each second as it ticks,
+ * 			so never 0 and at most a week. nextAlarm() gives the time it fires, with the day of week
+ * 			numbered as in this time. Both work field by field in constant time rather than stepping
+ * 			through seconds. hours24 selects the alarm's hours (true) or hours12 / ampm (false), as
+ * 			writeHours24 does for DS1306::setAlarm(); the time itself may be held in either form.
+ * 			An alarm with a field out of range never fires and gives DS1306_ALARM_NEVER.
+ */
+#ifndef __DS1306_RAWTIME_
+#define __DS1306_RAWTIME_
+
+#include "DS1306.h"
+#include "DS1306BCD.h"
+
+/* Packed time key, see getKey(); arguments are binary, mo and d from 1 */
+#define DS1306_TIME_KEY(y, mo, d, h, mi, s)	\
+	((((((unsigned long) (y) * 12 + (mo) - 1) * 31 + (d) - 1) * 24 + (h)) << 12) | ((unsigned long) (mi) << 6) | (s))
+
+/* Key of 2099-12-31 23:59:59, the largest there is */
+#define DS1306_KEY_MAX			DS1306_TIME_KEY(99, 12, 31, 23, 59, 59)
+
+/* Result of secondsToAlarm() for an alarm that can never fire */
+#define DS1306_ALARM_NEVER		0xFFFFFFFFUL
+
+class DS1306RawTime
+{
+	friend class DS1306Iso;
+
+	public:
+
+	// Time/date registers 0x00 - 0x06 as read from the chip
+	unsigned char regs[DS1306_SIZE_DATETIME];
+
+	// Field accessors, each decodes only its own register
+	unsigned char getSeconds() const { return DS1306BCD::decode(regs[0] & 0x7F); }
+	unsigned char getMinutes() const { return DS1306BCD::decode(regs[1] & 0x7F); }
+	unsigned char getHours() const;
+	unsigned char getHours12() const;
+	char getAmPm() const;
+	unsigned char getDow() const { return regs[3] & 0x07; }
+	unsigned char getDay() const { return DS1306BCD::decode(regs[4] & 0x3F); }
+	unsigned char getMonth() const { return DS1306BCD::decode(regs[5] & 0x3F); }
+	unsigned char getYear() const { return DS1306BCD::decode(regs[6]); }
+
+	// Full decode, equivalent to DS1306::getTime
+	void decode(ds1306time *time) const;
+
+	// Seconds since 2000-01-01 00:00:00
+	unsigned long getEpoch() const;
+	void setEpoch(unsigned long epoch, bool hours24 = true);
+
+	// Chronological comparison on the raw registers, returns <0, 0, >0
+	int compare(const DS1306RawTime *other) const;
+	bool equals(const DS1306RawTime *other) const { return compare(other) == 0; }
+
+	// Packed key, integer order is chronological order
+	unsigned long getKey() const;
+	void setKey(unsigned long key, bool hours24 = true);
+	static unsigned long makeKey(const ds1306time *time);
+
+	// Arithmetic, keeping the hour form held in the register
+	void addSeconds(long seconds);
+	void addDays(long days);
+	long secondsSince(const DS1306RawTime *other) const;
+
+	// Day of week of the date held (DS1306_SUNDAY = 1), whatever the register says
+	unsigned char calculateDow() const;
+
+#if DS1306_ALARMS
+	// When an alarm next fires after this time
+	unsigned long secondsToAlarm(const ds1306alarm *alarm, bool hours24 = true) const;
+	bool nextAlarm(const ds1306alarm *alarm, DS1306RawTime *next, bool hours24 = true) const;
+	static unsigned long secondsToAlarm(const ds1306time *time, const ds1306alarm *alarm, bool hours24 = true);
+#endif
+
+	private:
+
+	// Days since 2000-01-01, 0 if the month register is out of range
+	unsigned int dayNumber() const;
+
+	// Set the date registers (and day of week) from days since 2000-01-01, or the time of day
+	void setDayNumber(unsigned int days);
+	void setTimeOfDay(unsigned long seconds, bool hours24);
+
+#if DS1306_ALARMS
+	// Seconds from hours:minutes:seconds on day of week dow to the next firing of alarm
+	static unsigned long alarmDelay(unsigned char hours, unsigned char minutes, unsigned char seconds, unsigned char dow,
+		const ds1306alarm *alarm, bool hours24);
+#endif
+
+	// Hour register mapped to 24 hour BCD, for 12 or 24 hour forms
+	static unsigned char hourOrder(unsigned char hourByte);
+};
+
+#endif /* __DS1306_RAWTIME_ */
@@ -0,0 +1,191 @@
+/*
+ * File			DS1306Records.cpp
+ *
+ * Synopsis		Record store over the DS1306 user memory (0x20 - 0x7F)
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <string.h>
+#endif
+#include "DS1306Records.h"
+
+// Bytes of user memory
+#define DS1306_RECORD_SPACE		(DS1306_USER_END - DS1306_USER_START + 1)
+
+// Constructor
+DS1306Records::DS1306Records(DS1306 *rtc) : rtc(rtc), count(0)
+{
+}
+
+// Validate a layout: 1 to DS1306_RECORD_MAX_SLOTS slots, unique ids, capacities of 1 - 127 and
+// index plus all slots fitting within user memory
+bool DS1306Records::checkLayout(const ds1306slot *slots, unsigned char count)
+{
+	if (count < 1 || count > DS1306_RECORD_MAX_SLOTS) return false;
+
+	int used = DS1306_RECORD_INDEX_HEADER + count * DS1306_RECORD_INDEX_ENTRY;
+	for (unsigned char i = 0; i < count; i++) {
+		if (slots[i].capacity < 1 || slots[i].capacity >= DS1306_RECORD_VARIABLE) return false;
+		for (unsigned char j = 0; j < i; j++) {
+			if (slots[j].id == slots[i].id) return false;
+		}
+		used += DS1306_RECORD_SLOT_HEADER + slots[i].capacity;
+	}
+
+	return (used <= DS1306_RECORD_SPACE) ? true : false;
+}
+
+// Write the index and an empty (zero length) record into every slot, in a single burst
+// Returns false, changing nothing, if the layout is invalid
+bool DS1306Records::format(const ds1306slot *slots, unsigned char count)
+{
+	if (!checkLayout(slots, count)) return false;
+
+	unsigned char image[DS1306_RECORD_SPACE];
+	unsigned char *entries = &image[DS1306_RECORD_INDEX_HEADER];
+	memset(image, 0, sizeof(image));
+
+	for (unsigned char i = 0; i < count; i++) {
+		entries[i * DS1306_RECORD_INDEX_ENTRY] = slots[i].id;
+		entries[i * DS1306_RECORD_INDEX_ENTRY + 1] = slots[i].capacity | (slots[i].variable ? DS1306_RECORD_VARIABLE : 0);
+	}
+	image[0] = DS1306_RECORD_MAGIC;
+	image[1] = count;
+	image[2] = crc8(0, entries, count * DS1306_RECORD_INDEX_ENTRY);
+
+	load(entries, count);
+
+	// Empty record headers, zero length with a valid CRC
+	for (unsigned char i = 0; i < count; i++) {
+		unsigned char header[2] = { ids[i], 0 };
+		image[addresses[i] - DS1306_USER_START + 1] = crc8(0, header, 2);
+	}
+
+	rtc->write(DS1306_USER_START, image, addresses[count - 1] - DS1306_USER_START + DS1306_RECORD_SLOT_HEADER);
+	return true;
+}
+
+// Load the index with a single burst read
+// Returns false if user memory does not hold a valid index
+bool DS1306Records::begin()
+{
+	unsigned char header[DS1306_RECORD_INDEX_HEADER];
+	unsigned char entries[DS1306_RECORD_MAX_SLOTS * DS1306_RECORD_INDEX_ENTRY];
+
+	count = 0;
+	rtc->readSplit(DS1306_USER_START, header, DS1306_RECORD_INDEX_HEADER, entries, sizeof(entries));
+
+	if (header[0] != DS1306_RECORD_MAGIC || header[1] < 1 || header[1] > DS1306_RECORD_MAX_SLOTS) return false;
+	if (crc8(0, entries, header[1] * DS1306_RECORD_INDEX_ENTRY) != header[2]) return false;
+
+	load(entries, header[1]);
+
+	// Reject an index whose slots would run past the end of user memory
+	unsigned char last = count - 1;
+	if (addresses[last] + DS1306_RECORD_SLOT_HEADER + (capacities[last] & ~DS1306_RECORD_VARIABLE) > DS1306_USER_END + 1) {
+		count = 0;
+		return false;
+	}
+
+	return true;
+}
+
+// Read a record into buf (size bytes available) with a single burst
+// Returns the record length, or DS1306_RECORD_NOT_FOUND / DS1306_RECORD_CRC_ERROR / DS1306_RECORD_TOO_SMALL
+// The payload lands directly in buf; on error buf contents are undefined
+int DS1306Records::read(unsigned char id, void *buf, int size)
+{
+	int slot = find(id);
+	if (slot < 0) return DS1306_RECORD_NOT_FOUND;
+
+	unsigned char capacity = capacities[slot] & ~DS1306_RECORD_VARIABLE;
+	int fetch = (size < capacity) ? size : capacity;
+	unsigned char header[DS1306_RECORD_SLOT_HEADER];
+
+	rtc->readSplit(addresses[slot], header, DS1306_RECORD_SLOT_HEADER, (unsigned char *) buf, fetch);
+
+	unsigned char len = header[0];
+	if (len > capacity) return DS1306_RECORD_CRC_ERROR;
+	if (len > fetch) return DS1306_RECORD_TOO_SMALL;
+
+	unsigned char check[2] = { id, len };
+	if (crc8(crc8(0, check, 2), (const unsigned char *) buf, len) != header[1]) return DS1306_RECORD_CRC_ERROR;
+
+	return len;
+}
+
+// Write a record with a single burst covering its header and len bytes of payload
+// Fixed slots must be written at full capacity, variable slots at up to capacity
+// Returns false if there is no such slot or the length is not acceptable
+bool DS1306Records::write(unsigned char id, const void *buf, int len)
+{
+	int slot = find(id);
+	if (slot < 0) return false;
+
+	unsigned char capacity = capacities[slot] & ~DS1306_RECORD_VARIABLE;
+	bool variable = (capacities[slot] & DS1306_RECORD_VARIABLE) ? true : false;
+	if (len < 0 || len > capacity || (!variable && len != capacity)) return false;
+
+	unsigned char check[2] = { id, (unsigned char) len };
+	unsigned char header[DS1306_RECORD_SLOT_HEADER] = { (unsigned char) len, crc8(crc8(0, check, 2), (const unsigned char *) buf, len) };
+
+	rtc->writeSplit(addresses[slot], header, DS1306_RECORD_SLOT_HEADER, (const unsigned char *) buf, len);
+	return true;
+}
+
+// Number of slots in the loaded index (0 if none loaded)
+unsigned char DS1306Records::getSlotCount()
+{
+	return count;
+}
+
+// Payload capacity of a slot, or DS1306_RECORD_NOT_FOUND
+int DS1306Records::getCapacity(unsigned char id)
+{
+	int slot = find(id);
+	if (slot < 0) return DS1306_RECORD_NOT_FOUND;
+	return capacities[slot] & ~DS1306_RECORD_VARIABLE;
+}
+
+// CRC-8, Dallas/Maxim polynomial (reflected 0x8C), continuing from crc
+unsigned char DS1306Records::crc8(unsigned char crc, const unsigned char *data, int len)
+{
+	for (int i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (unsigned char bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+		}
+	}
+	return crc;
+}
+
+// Index of the slot with the given id in the loaded index, or -1
+int DS1306Records::find(unsigned char id)
+{
+	for (unsigned char i = 0; i < count; i++) {
+		if (ids[i] == id) return i;
+	}
+	return -1;
+}
+
+// Populate the RAM index from index entries, computing each slot's address
+void DS1306Records::load(const unsigned char *entries, unsigned char count)
+{
+	unsigned char address = DS1306_USER_START + DS1306_RECORD_INDEX_HEADER + count * DS1306_RECORD_INDEX_ENTRY;
+
+	for (unsigned char i = 0; i < count; i++) {
+		ids[i] = entries[i * DS1306_RECORD_INDEX_ENTRY];
+		capacities[i] = entries[i * DS1306_RECORD_INDEX_ENTRY + 1];
+		addresses[i] = address;
+		address += DS1306_RECORD_SLOT_HEADER + (capacities[i] & ~DS1306_RECORD_VARIABLE);
+	}
+	this->count = count;
+}
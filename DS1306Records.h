@@ -0,0 +1,103 @@
+/*
+ * File			DS1306Records.h
+ *
+ * Synopsis		Record store over the DS1306 user memory (0x20 - 0x7F)
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			User memory is divided into an index followed by record slots. Each slot has a one byte id
+ * 			and a capacity, and is either fixed (always written at full capacity) or variable (any
+ * 			length up to capacity). Describe the layout with an array of ds1306slot and call format()
+ * 			once; checkLayout() validates a layout without touching the chip.
+ *
+ * 			begin() reads the index in a single burst and keeps it in RAM, after which finding a record
+ * 			costs no bus traffic. read() fetches a record in one burst directly into the caller's
+ * 			buffer and write() stores it in one burst, touching only that record.
+ *
+ * 			Layout in user memory:
+ *
+ * 			Index	magic (DS1306_RECORD_MAGIC), slot count, CRC-8 of the slot entries,
+ * 					then per slot: id, capacity (bit 7 set for variable slots)
+ * 			Slot	length, CRC-8 (over id, length and payload), payload (capacity bytes)
+ *
+ * 			CRC-8 uses the Dallas/Maxim polynomial (x^8 + x^5 + x^4 + 1).
+ */
+#ifndef __DS1306_RECORDS_
+#define __DS1306_RECORDS_
+
+#include "DS1306.h"
+
+/* Index identification byte */
+#define DS1306_RECORD_MAGIC		0xD6
+
+/* Maximum number of slots in a layout */
+#define DS1306_RECORD_MAX_SLOTS	16
+
+/* Sizes of the index header, each index entry and each slot header */
+#define DS1306_RECORD_INDEX_HEADER	3
+#define DS1306_RECORD_INDEX_ENTRY	2
+#define DS1306_RECORD_SLOT_HEADER	2
+
+/* Variable length flag in an index entry's capacity byte */
+#define DS1306_RECORD_VARIABLE	0x80
+
+/* Record read results (non-negative results are the record length) */
+#define DS1306_RECORD_NOT_FOUND	-1		// No slot with that id, or store not loaded
+#define DS1306_RECORD_CRC_ERROR	-2		// Stored record failed its CRC check
+#define DS1306_RECORD_TOO_SMALL	-3		// Caller's buffer is smaller than the stored record
+
+/* Description of a record slot */
+typedef struct {
+	unsigned char id;			// Record identifier, unique within a layout
+	unsigned char capacity;		// Payload bytes reserved
+	bool variable;				// True if the record may be shorter than capacity
+} ds1306slot;
+
+class DS1306Records
+{
+	public:
+
+	// Constructor, rtc must be initialized before use
+	DS1306Records(DS1306 *rtc);
+
+	// Validate a layout, true if it fits in user memory with unique ids
+	static bool checkLayout(const ds1306slot *slots, unsigned char count);
+
+	// Write a new index and empty records, destroying the previous contents of user memory
+	bool format(const ds1306slot *slots, unsigned char count);
+
+	// Load the index from the chip, false if user memory holds no valid index
+	bool begin();
+
+	// Record access
+	int read(unsigned char id, void *buf, int size);
+	bool write(unsigned char id, const void *buf, int len);
+
+	// Layout queries (from the loaded index)
+	unsigned char getSlotCount();
+	int getCapacity(unsigned char id);
+
+	// CRC-8, Dallas/Maxim polynomial
+	static unsigned char crc8(unsigned char crc, const unsigned char *data, int len);
+
+	private:
+
+	DS1306 *rtc;
+
+	// Loaded index
+	unsigned char count;
+	unsigned char ids[DS1306_RECORD_MAX_SLOTS];
+	unsigned char capacities[DS1306_RECORD_MAX_SLOTS];	// Including DS1306_RECORD_VARIABLE flag
+	unsigned char addresses[DS1306_RECORD_MAX_SLOTS];	// Address of each slot header
+
+	int find(unsigned char id);
+	void load(const unsigned char *entries, unsigned char count);
+};
+
+#endif /* __DS1306_RECORDS_ */
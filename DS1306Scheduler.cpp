@@ -0,0 +1,233 @@
+/*
+ * File			DS1306Scheduler.cpp
+ *
+ * Synopsis		Any number of software alarms multiplexed onto one DS1306 hardware alarm
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#include "DS1306Scheduler.h"
+#include "DS1306RawTime.h"
+
+#if DS1306_ALARMS
+// Entry position markers, outside any heap index while capacity is at most DS1306_SCHEDULE_MAX
+#define DS1306_SCHEDULE_FREE	0xFFFF		// Entry is unused
+#define DS1306_SCHEDULE_RUNNING	0xFFFE		// Entry's task is being called from service()
+#define DS1306_SCHEDULE_NONE	0xFFFF		// End of the free chain
+
+// Heap storage is spread across the entries array, heap position i lives in entries[i].heap
+#define HEAP(i)					(entries[i].heap)
+
+// Constructor, capacity is limited to DS1306_SCHEDULE_MAX so no heap index meets a marker
+DS1306Scheduler::DS1306Scheduler(DS1306 *rtc, ds1306schedule *entries, unsigned int capacity, unsigned char alarm) :
+	rtc(rtc), entries(entries), capacity((capacity > DS1306_SCHEDULE_MAX) ? DS1306_SCHEDULE_MAX : capacity),
+	alarm(alarm), count(0), freeHead(DS1306_SCHEDULE_NONE), programmed(DS1306_SCHEDULE_NEVER)
+{
+}
+
+// Prepare the storage and hardware alarm, discarding anything scheduled
+void DS1306Scheduler::begin()
+{
+	count = 0;
+	freeHead = DS1306_SCHEDULE_NONE;
+	for (unsigned int i = capacity; i > 0; i--) {
+		release(i - 1);
+	}
+
+	rtc->disableAlarm(alarm);
+	rtc->clearAlarmState(alarm);
+	programmed = DS1306_SCHEDULE_NEVER;
+}
+
+// Schedule task to run whenever the time matches pattern
+// Returns a handle for cancel(), or 0 if every entry is in use
+unsigned int DS1306Scheduler::add(const ds1306alarm *pattern, ds1306task task, void *context)
+{
+	if (freeHead == DS1306_SCHEDULE_NONE) return 0;
+
+	unsigned int entry = freeHead;
+	freeHead = (unsigned int) entries[entry].next;
+
+	entries[entry].pattern = *pattern;
+	entries[entry].task = task;
+	entries[entry].context = context;
+	entries[entry].next = nextFire(pattern, rtc->getEpoch());
+	heapInsert(entry);
+
+	arm(false);
+	return entry + 1;
+}
+
+// Remove a scheduled task, may be called from the task itself
+// Returns false if handle does not identify a scheduled task
+bool DS1306Scheduler::cancel(unsigned int handle)
+{
+	if (handle < 1 || handle > capacity) return false;
+
+	unsigned int entry = handle - 1;
+	unsigned int position = entries[entry].position;
+	if (position == DS1306_SCHEDULE_FREE) return false;
+
+	if (position != DS1306_SCHEDULE_RUNNING) {
+		heapRemove(position);
+		release(entry);
+		arm(false);
+	} else {
+		// service() will not reschedule an entry that is no longer marked running
+		release(entry);
+	}
+	return true;
+}
+
+// Run every task whose time has come, then re-arm the hardware alarm (also clearing its flag)
+// Returns the number of tasks run
+unsigned int DS1306Scheduler::service()
+{
+	unsigned int fired = 0;
+	unsigned long now = rtc->getEpoch();
+	bool force = true;
+
+	for (;;) {
+		while (count && entries[HEAP(0)].next <= now) {
+			unsigned int entry = HEAP(0);
+			heapRemove(0);
+			entries[entry].position = DS1306_SCHEDULE_RUNNING;
+
+			if (entries[entry].task) entries[entry].task(entry + 1, entries[entry].context);
+			fired++;
+
+			if (entries[entry].position == DS1306_SCHEDULE_RUNNING) {
+				entries[entry].next = nextFire(&entries[entry].pattern, now);
+				heapInsert(entry);
+			}
+		}
+
+		arm(force);
+		force = false;
+
+		// A deadline passed while arming would not fire for a week, so catch it now
+		now = rtc->getEpoch();
+		if (!count || entries[HEAP(0)].next > now) break;
+	}
+
+	return fired;
+}
+
+// Number of scheduled tasks
+unsigned int DS1306Scheduler::getCount()
+{
+	return count;
+}
+
+// Nearest fire time, or DS1306_SCHEDULE_NEVER if nothing is scheduled
+unsigned long DS1306Scheduler::getNext()
+{
+	return count ? entries[HEAP(0)].next : DS1306_SCHEDULE_NEVER;
+}
+
+// Earliest time strictly after after that matches pattern, or DS1306_SCHEDULE_NEVER
+// Worked out in closed form by DS1306RawTime::secondsToAlarm()
+unsigned long DS1306Scheduler::nextFire(const ds1306alarm *pattern, unsigned long after)
+{
+	DS1306RawTime raw;
+	raw.setEpoch(after);
+
+	unsigned long delay = raw.secondsToAlarm(pattern);
+	return (delay == DS1306_ALARM_NEVER) ? DS1306_SCHEDULE_NEVER : after + delay;
+}
+
+// Add an entry to the heap
+void DS1306Scheduler::heapInsert(unsigned int entry)
+{
+	heapPlace(count, entry);
+	siftUp(count++);
+}
+
+// Remove the entry at a heap position, replacing it with the last entry
+void DS1306Scheduler::heapRemove(unsigned int position)
+{
+	count--;
+	if (position == count) return;
+
+	heapPlace(position, HEAP(count));
+	siftUp(position);
+	siftDown(position);
+}
+
+// Move an entry towards the root while it fires before its parent
+void DS1306Scheduler::siftUp(unsigned int position)
+{
+	unsigned int entry = HEAP(position);
+	unsigned long next = entries[entry].next;
+
+	while (position > 0) {
+		unsigned int parent = (position - 1) >> 1;
+		if (entries[HEAP(parent)].next <= next) break;
+		heapPlace(position, HEAP(parent));
+		position = parent;
+	}
+	heapPlace(position, entry);
+}
+
+// Move an entry towards the leaves while a child fires before it
+void DS1306Scheduler::siftDown(unsigned int position)
+{
+	unsigned int entry = HEAP(position);
+	unsigned long next = entries[entry].next;
+
+	for (;;) {
+		unsigned int child = (position << 1) + 1;
+		if (child >= count) break;
+		if (child + 1 < count && entries[HEAP(child + 1)].next < entries[HEAP(child)].next) child++;
+		if (next <= entries[HEAP(child)].next) break;
+		heapPlace(position, HEAP(child));
+		position = child;
+	}
+	heapPlace(position, entry);
+}
+
+// Store an entry at a heap position, keeping the entry's record of its position
+void DS1306Scheduler::heapPlace(unsigned int position, unsigned int entry)
+{
+	HEAP(position) = entry;
+	entries[entry].position = position;
+}
+
+// Return an entry to the free chain
+void DS1306Scheduler::release(unsigned int entry)
+{
+	entries[entry].position = DS1306_SCHEDULE_FREE;
+	entries[entry].next = freeHead;
+	freeHead = entry;
+}
+
+// Program the nearest deadline into the hardware alarm if it has changed (always when forced)
+// Writing the alarm registers also clears the alarm's flag
+void DS1306Scheduler::arm(bool force)
+{
+	unsigned long target = count ? entries[HEAP(0)].next : DS1306_SCHEDULE_NEVER;
+	if (!force && target == programmed) return;
+
+	if (target == DS1306_SCHEDULE_NEVER) {
+		if (programmed != DS1306_SCHEDULE_NEVER) rtc->disableAlarm(alarm);
+		if (force) rtc->clearAlarmState(alarm);
+		programmed = DS1306_SCHEDULE_NEVER;
+		return;
+	}
+
+	DS1306RawTime raw;
+	ds1306time time;
+	raw.setEpoch(target);
+	raw.decode(&time);
+
+	ds1306alarm setting = { time.seconds, time.minutes, time.hours, time.hours12, time.ampm, time.dow };
+	rtc->setAlarm(alarm, &setting);
+	if (programmed == DS1306_SCHEDULE_NEVER) rtc->enableAlarm(alarm);
+	programmed = target;
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * File			DS1306Scheduler.h
+ *
+ * Synopsis		Any number of software alarms multiplexed onto one DS1306 hardware alarm
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Create a DS1306Scheduler for an initialized DS1306, giving it an array of ds1306schedule
+ * 			entries (its capacity sets the number of alarms that can be scheduled) and the hardware
+ * 			alarm (0 or 1) it may use, then call begin().
+ *
+ * 			add() schedules a task on a ds1306alarm style pattern: seconds, minutes, hours (24 hour
+ * 			form, hours12 / ampm are ignored) and dow, any of which may be DS1306_ANY. Patterns repeat;
+ * 			a task stops when cancel() is called with its handle, which it may do from its own callback.
+ * 			Day of week follows the suggested numbering (DS1306_SUNDAY = 1), as written by setEpoch().
+ *
+ * 			Entries are kept in a min-heap on their next fire time, so add() and cancel() cost
+ * 			O(log n). The nearest deadline is always programmed into the hardware alarm and its
+ * 			interrupt is enabled, so the host can sleep until the INT line fires. Then call service(),
+ * 			which runs every task that is due and re-arms the alarm. A deadline more than a week away
+ * 			makes the hardware alarm fire early (it does not match the date); service() then finds
+ * 			nothing due and re-arms.
+ *
+ * 			An entry records its heap position in an unsigned int, with 0xFFFE and 0xFFFF reserved to
+ * 			mark running and free entries, so the capacity is limited to DS1306_SCHEDULE_MAX (65534)
+ * 			entries even where unsigned int is wider. A larger capacity is reduced to it.
+ *
+ * 			add() reads the time from the chip once. A deadline reached before add() has armed the
+ * 			alarm is run by the next service(), which re-reads the time after arming for the same
+ * 			reason. Tasks run from service(), so never from interrupt context.
+ */
+#ifndef __DS1306_SCHEDULER_
+#define __DS1306_SCHEDULER_
+
+#include "DS1306.h"
+
+/* The scheduler needs the alarm API, see DS1306_ALARMS in DS1306Config.h */
+#if DS1306_ALARMS
+/* Most entries a scheduler can manage, positions above it are free / running markers */
+#define DS1306_SCHEDULE_MAX		0xFFFE
+
+/* Next fire time of a pattern that can never match */
+#define DS1306_SCHEDULE_NEVER	0xFFFFFFFFUL
+
+/* Task callback, receives the schedule handle and the caller's context */
+typedef void (*ds1306task)(unsigned int handle, void *context);
+
+/* Scheduler entry storage, provided by the caller and managed by DS1306Scheduler */
+typedef struct {
+	ds1306alarm pattern;		// When the task fires
+	unsigned long next;			// Next fire time, seconds since 2000-01-01 00:00:00
+	ds1306task task;
+	void *context;
+	unsigned int position;		// Heap index of this entry, or a free / running marker
+	unsigned int heap;			// Heap storage, entry index at heap position of this array index
+} ds1306schedule;
+
+class DS1306Scheduler
+{
+	public:
+
+	// Constructor, entries provides capacity slots of storage
+	DS1306Scheduler(DS1306 *rtc, ds1306schedule *entries, unsigned int capacity, unsigned char alarm = 0);
+
+	// Prepare the storage and hardware alarm, discarding anything scheduled
+	void begin();
+
+	// Schedule a task, returns a handle or 0 if the storage is full
+	unsigned int add(const ds1306alarm *pattern, ds1306task task, void *context = 0);
+	bool cancel(unsigned int handle);
+
+	// Run every task that is due and re-arm the hardware alarm, returns the number of tasks run
+	unsigned int service();
+
+	// Queries
+	unsigned int getCount();
+	unsigned long getNext();
+
+	// Earliest time after after (seconds since 2000-01-01 00:00:00) matching pattern
+	static unsigned long nextFire(const ds1306alarm *pattern, unsigned long after);
+
+	private:
+
+	DS1306 *rtc;
+	ds1306schedule *entries;
+	unsigned int capacity;
+	unsigned char alarm;
+
+	unsigned int count;			// Entries in the heap
+	unsigned int freeHead;		// First free entry, free entries are chained through next
+	unsigned long programmed;	// Fire time in the hardware alarm, DS1306_SCHEDULE_NEVER if disabled
+
+	// Heap maintenance
+	void heapInsert(unsigned int entry);
+	void heapRemove(unsigned int position);
+	void siftUp(unsigned int position);
+	void siftDown(unsigned int position);
+	void heapPlace(unsigned int position, unsigned int entry);
+	void release(unsigned int entry);
+
+	void arm(bool force);
+};
+
+#endif
+
+#endif /* __DS1306_SCHEDULER_ */
@@ -0,0 +1,181 @@
+/*
+ * File			DS1306SoftClock.cpp
+ *
+ * Synopsis		RAM copy of the DS1306 time, advanced by the chip's 1Hz output
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "DS1306SoftClock.h"
+#include "DS1306RawTime.h"
+
+// Multi-byte state shared with the interrupt handler must be read with interrupts masked
+#ifdef ARDUINO
+#define DS1306_SOFTCLOCK_LOCK()		noInterrupts()
+#define DS1306_SOFTCLOCK_UNLOCK()	interrupts()
+#else
+#define DS1306_SOFTCLOCK_LOCK()
+#define DS1306_SOFTCLOCK_UNLOCK()
+#endif
+
+// Constructor
+DS1306SoftClock::DS1306SoftClock(DS1306 *rtc) : rtc(rtc), epoch(0), pulseMicros(0), pulses(0), phaseKnown(false),
+	resyncInterval(0), dowOffset(0), synced(false), ramReads(0), chipReads(0)
+{
+#ifdef ARDUINO
+	microsSource = micros;
+#else
+	microsSource = 0;
+#endif
+}
+
+// Enable the chip's 1Hz output and take the initial reading
+// The clock is re-read from the chip after every resyncInterval pulses, 0 disables re-syncing
+void DS1306SoftClock::begin(unsigned long resyncInterval)
+{
+	this->resyncInterval = resyncInterval;
+	rtc->set1HzState(true);
+	sync();
+}
+
+// Advance the RAM clock by one second, call from the 1Hz edge interrupt
+void DS1306SoftClock::onPulse()
+{
+	epoch++;
+	pulses++;
+	phaseKnown = true;
+	if (microsSource) pulseMicros = microsSource();
+}
+
+// Read the time from the chip into RAM
+// If a pulse arrives while the chip is being read the reading may be stale, so it is retaken
+void DS1306SoftClock::sync()
+{
+	DS1306RawTime raw;
+	unsigned long before, after;
+
+	do {
+		DS1306_SOFTCLOCK_LOCK();
+		before = pulses;
+		DS1306_SOFTCLOCK_UNLOCK();
+
+		rtc->getRawTime(&raw);
+		chipReads++;
+
+		DS1306_SOFTCLOCK_LOCK();
+		after = pulses;
+		if (before == after) {
+			epoch = raw.getEpoch();
+			pulses = 0;
+
+			// Pulse phase carries over a re-sync, only the first sync starts with it unknown
+			if (!synced) phaseKnown = false;
+		}
+		DS1306_SOFTCLOCK_UNLOCK();
+	} while (before != after);
+
+	// Remember how the chip numbers days, epoch conversion uses DS1306_SUNDAY = 1
+	DS1306RawTime computed;
+	computed.setEpoch(raw.getEpoch());
+	dowOffset = (raw.getDow() + 7 - computed.getDow()) % 7;
+
+	synced = true;
+}
+
+// Retrieve current time, from RAM unless a re-sync is due
+void DS1306SoftClock::getTime(ds1306time *time)
+{
+	DS1306RawTime raw;
+	raw.setEpoch(getEpoch());
+	raw.regs[3] = (raw.regs[3] - 1 + dowOffset) % 7 + 1;
+	raw.decode(time);
+}
+
+// Retrieve current time as seconds since 2000-01-01 00:00:00
+unsigned long DS1306SoftClock::getEpoch()
+{
+	unsigned int milliseconds;
+	return getEpoch(&milliseconds);
+}
+
+// Retrieve current time as seconds since 2000-01-01 00:00:00, with milliseconds into that second
+// milliseconds is 0 until the first pulse following a sync, and is capped at 999
+unsigned long DS1306SoftClock::getEpoch(unsigned int *milliseconds)
+{
+	syncIfDue();
+
+	DS1306_SOFTCLOCK_LOCK();
+	unsigned long seconds = epoch;
+	unsigned long since = pulseMicros;
+	bool known = phaseKnown;
+	DS1306_SOFTCLOCK_UNLOCK();
+
+	*milliseconds = 0;
+	if (known && microsSource) {
+		unsigned long elapsed = (microsSource() - since) / 1000;
+		*milliseconds = (elapsed > 999) ? 999 : (unsigned int) elapsed;
+	}
+
+	return seconds;
+}
+
+// Current time as a compact timestamp (see DS1306Stamp.h), ticks from the sub-second phase
+void DS1306SoftClock::getStamp(ds1306stamp *stamp)
+{
+	unsigned int milliseconds;
+	stamp->seconds = getEpoch(&milliseconds);
+	stamp->ticks = (unsigned char) (((unsigned long) milliseconds << 8) / 1000);
+}
+
+// Current RAM time as seconds since 2000-01-01 00:00:00, never touching the bus
+// Intended for interrupt handlers, where interrupts are already masked; elsewhere use getEpoch()
+unsigned long DS1306SoftClock::peekEpoch()
+{
+	return epoch;
+}
+
+// Provide the microsecond time source used for sub-second resolution
+void DS1306SoftClock::setMicrosSource(unsigned long (*source)())
+{
+	microsSource = source;
+}
+
+// Number of time reads served from RAM
+unsigned long DS1306SoftClock::getRamReads()
+{
+	return ramReads;
+}
+
+// Number of time reads from the chip (initial sync and re-syncs)
+unsigned long DS1306SoftClock::getChipReads()
+{
+	return chipReads;
+}
+
+// Reset read counters
+void DS1306SoftClock::resetCounters()
+{
+	ramReads = 0;
+	chipReads = 0;
+}
+
+// Re-read the chip if never synced or the re-sync interval has elapsed, else count a RAM read
+void DS1306SoftClock::syncIfDue()
+{
+	DS1306_SOFTCLOCK_LOCK();
+	unsigned long elapsed = pulses;
+	DS1306_SOFTCLOCK_UNLOCK();
+
+	if (!synced || (resyncInterval && elapsed >= resyncInterval)) {
+		sync();
+	} else {
+		ramReads++;
+	}
+}
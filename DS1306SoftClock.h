@@ -0,0 +1,88 @@
+/*
+ * File			DS1306SoftClock.h
+ *
+ * Synopsis		RAM copy of the DS1306 time, advanced by the chip's 1Hz output
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Connect the DS1306 1Hz output to an interrupt capable pin, create a DS1306SoftClock for an
+ * 			initialized DS1306 and call begin(). begin() enables the 1Hz output and reads the time once.
+ * 			Call onPulse() from the interrupt handler for the pin (on the edge at which the chip's
+ * 			seconds advance). Time reads are then served from RAM without touching the SPI bus.
+ *
+ * 			The clock re-reads the chip after every resyncInterval pulses (0 disables re-syncing),
+ * 			on the next time read from the main loop; the interrupt handler never uses the bus.
+ *
+ * 			Sub-second resolution comes from micros() measured since the last pulse. Until the first
+ * 			pulse after begin() the sub-second phase is unknown and is reported as 0. On host builds
+ * 			there is no micros(); supply one with setMicrosSource() if sub-second values are needed.
+ *
+ * 			Day of week in returned times keeps the numbering found on the chip at the last sync.
+ */
+#ifndef __DS1306_SOFTCLOCK_
+#define __DS1306_SOFTCLOCK_
+
+#include "DS1306.h"
+
+class DS1306SoftClock
+{
+	public:
+
+	// Constructor, rtc must be initialized before begin() is called
+	DS1306SoftClock(DS1306 *rtc);
+
+	// Enable the 1Hz output and sync from the chip, re-syncing every resyncInterval seconds
+	void begin(unsigned long resyncInterval);
+
+	// Call from the 1Hz edge interrupt
+	void onPulse();
+
+	// Read the time from the chip now
+	void sync();
+
+	// Time reads, served from RAM unless a re-sync is due
+	void getTime(ds1306time *time);
+	unsigned long getEpoch();
+	unsigned long getEpoch(unsigned int *milliseconds);
+	void getStamp(ds1306stamp *stamp);
+
+	// RAM time with no re-sync, for use from interrupt handlers
+	unsigned long peekEpoch();
+
+	// Sub-second time source (defaults to micros() on Arduino)
+	void setMicrosSource(unsigned long (*source)());
+
+	// Read counters
+	unsigned long getRamReads();
+	unsigned long getChipReads();
+	void resetCounters();
+
+	private:
+
+	DS1306 *rtc;
+
+	// Updated from the interrupt handler
+	volatile unsigned long epoch;			// Seconds since 2000-01-01 00:00:00
+	volatile unsigned long pulseMicros;		// micros() at the last pulse
+	volatile unsigned long pulses;			// Pulses since the last sync
+	volatile bool phaseKnown;				// A pulse has been seen since the last sync
+
+	unsigned long resyncInterval;			// Pulses between re-syncs, 0 for never
+	unsigned char dowOffset;				// Correction from computed to chip day of week numbering
+	bool synced;
+
+	unsigned long (*microsSource)();
+
+	unsigned long ramReads;
+	unsigned long chipReads;
+
+	void syncIfDue();
+};
+
+#endif /* __DS1306_SOFTCLOCK_ */
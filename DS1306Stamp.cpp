@@ -0,0 +1,227 @@
+/*
+ * File			DS1306Stamp.cpp
+ *
+ * Synopsis		Compact timestamps and delta encoded timestamp logs
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#include "DS1306Stamp.h"
+
+// Largest difference a log entry can hold, and the largest whole seconds of it in ticks
+#define DS1306_STAMP_DELTA_MAX		0x0FFFFFFFUL
+#define DS1306_STAMP_SECONDS_MAX	(DS1306_STAMP_DELTA_MAX >> 8)
+
+// Store a stamp, least significant byte first
+void DS1306Stamp::encode(unsigned char *buf, const ds1306stamp *stamp, bool ticks)
+{
+	unsigned long seconds = stamp->seconds;
+	buf[0] = (unsigned char) seconds;
+	buf[1] = (unsigned char) (seconds >> 8);
+	buf[2] = (unsigned char) (seconds >> 16);
+	buf[3] = (unsigned char) (seconds >> 24);
+	if (ticks) buf[4] = stamp->ticks;
+}
+
+// Load a stamp, ticks are 0 unless stored
+void DS1306Stamp::decode(const unsigned char *buf, ds1306stamp *stamp, bool ticks)
+{
+	stamp->seconds = buf[0] | ((unsigned int) buf[1] << 8) | ((unsigned long) buf[2] << 16) | ((unsigned long) buf[3] << 24);
+	stamp->ticks = ticks ? buf[4] : 0;
+}
+
+// Store count stamps back to back, returns the bytes used
+unsigned int DS1306Stamp::encodeArray(unsigned char *buf, const ds1306stamp *stamps, unsigned int count, bool ticks)
+{
+	unsigned char size = ticks ? DS1306_STAMP_SIZE_TICKS : DS1306_STAMP_SIZE;
+	for (unsigned int i = 0; i < count; i++, buf += size) {
+		encode(buf, &stamps[i], ticks);
+	}
+	return count * size;
+}
+
+// Load count stamps stored back to back, returns the bytes used
+unsigned int DS1306Stamp::decodeArray(const unsigned char *buf, ds1306stamp *stamps, unsigned int count, bool ticks)
+{
+	unsigned char size = ticks ? DS1306_STAMP_SIZE_TICKS : DS1306_STAMP_SIZE;
+	for (unsigned int i = 0; i < count; i++, buf += size) {
+		decode(buf, &stamps[i], ticks);
+	}
+	return count * size;
+}
+
+// Constructor
+DS1306StampLog::DS1306StampLog(unsigned char *buf, unsigned int size, bool ticks) : buf(buf), size(size), ticks(ticks)
+{
+	clear();
+}
+
+// Append a stamp, as a difference from the last when it is no earlier and close enough
+// Returns false, leaving the log unchanged, if the entry does not fit
+bool DS1306StampLog::append(const ds1306stamp *stamp)
+{
+	unsigned char entry[DS1306_STAMP_ENTRY_MAX];
+	unsigned char len;
+	unsigned long delta;
+
+	if (count && difference(&last, stamp, &delta)) {
+		if (delta < 0x80UL) {
+			len = 1;
+		} else if (delta < 0x4000UL) {
+			entry[0] = 0x80 | (unsigned char) (delta >> 8);
+			len = 2;
+		} else if (delta < 0x200000UL) {
+			entry[0] = 0xC0 | (unsigned char) (delta >> 16);
+			entry[1] = (unsigned char) (delta >> 8);
+			len = 3;
+		} else {
+			entry[0] = 0xE0 | (unsigned char) (delta >> 24);
+			entry[1] = (unsigned char) (delta >> 16);
+			entry[2] = (unsigned char) (delta >> 8);
+			len = 4;
+		}
+		entry[len - 1] = (unsigned char) delta;
+	} else {
+		entry[0] = DS1306_STAMP_ABSOLUTE;
+		DS1306Stamp::encode(&entry[1], stamp, ticks);
+		len = 1 + (ticks ? DS1306_STAMP_SIZE_TICKS : DS1306_STAMP_SIZE);
+	}
+
+	if (length + len > size) return false;
+
+	for (unsigned char i = 0; i < len; i++) {
+		buf[length++] = entry[i];
+	}
+	last = *stamp;
+	if (!ticks) last.ticks = 0;
+	count++;
+	return true;
+}
+
+// Empty the log
+void DS1306StampLog::clear()
+{
+	length = 0;
+	count = 0;
+	rewind();
+}
+
+// Read from the first stamp again
+void DS1306StampLog::rewind()
+{
+	readPos = 0;
+}
+
+// Read the next stamp, false at the end of the log
+bool DS1306StampLog::next(ds1306stamp *stamp)
+{
+	if (readPos >= length || !decodeEntry(&readPos, &readLast)) return false;
+	*stamp = readLast;
+	return true;
+}
+
+// Take over len bytes of log already in the buffer, counting the stamps and finding the last
+// Returns false, leaving the log empty, if len exceeds the buffer or the bytes are not a valid log
+bool DS1306StampLog::setLength(unsigned int len)
+{
+	clear();
+	if (len > size) return false;
+
+	length = len;
+	unsigned int pos = 0;
+	while (pos < len) {
+		// A log starts with a full stamp
+		if (!count && buf[pos] != DS1306_STAMP_ABSOLUTE) break;
+		if (!decodeEntry(&pos, &last)) break;
+		count++;
+	}
+
+	if (pos != len) {
+		clear();
+		return false;
+	}
+	return true;
+}
+
+// Bytes of the buffer in use
+unsigned int DS1306StampLog::getLength()
+{
+	return length;
+}
+
+// Stamps in the log
+unsigned int DS1306StampLog::getCount()
+{
+	return count;
+}
+
+// Difference from one stamp to a later one, in seconds or in ticks when the log has ticks
+// Returns false if to is earlier or too far ahead for a difference entry
+bool DS1306StampLog::difference(const ds1306stamp *from, const ds1306stamp *to, unsigned long *delta)
+{
+	if (to->seconds < from->seconds) return false;
+	unsigned long seconds = to->seconds - from->seconds;
+
+	if (!ticks) {
+		*delta = seconds;
+		return seconds <= DS1306_STAMP_DELTA_MAX;
+	}
+
+	// One second more can still fit when to's ticks are below from's
+	if (seconds > DS1306_STAMP_SECONDS_MAX + 1) return false;
+	long step = (long) (seconds << 8) + to->ticks - from->ticks;
+	if (step < 0 || (unsigned long) step > DS1306_STAMP_DELTA_MAX) return false;
+	*delta = step;
+	return true;
+}
+
+// Move a stamp forward by a difference
+void DS1306StampLog::advance(ds1306stamp *stamp, unsigned long delta)
+{
+	if (!ticks) {
+		stamp->seconds += delta;
+		return;
+	}
+
+	delta += stamp->ticks;
+	stamp->seconds += delta >> 8;
+	stamp->ticks = (unsigned char) delta;
+}
+
+// Decode the entry at *pos, updating stamp (the previous stamp) and moving *pos past it
+// Returns false if the entry runs past the end of the log
+bool DS1306StampLog::decodeEntry(unsigned int *pos, ds1306stamp *stamp)
+{
+	unsigned int p = *pos;
+	unsigned char lead = buf[p++];
+
+	if (lead == DS1306_STAMP_ABSOLUTE) {
+		unsigned char len = ticks ? DS1306_STAMP_SIZE_TICKS : DS1306_STAMP_SIZE;
+		if (p + len > length) return false;
+		DS1306Stamp::decode(&buf[p], stamp, ticks);
+		*pos = p + len;
+		return true;
+	}
+
+	// Leading ones give the number of bytes that follow
+	unsigned char extra = 0;
+	unsigned char mask = 0x80;
+	while (lead & mask) {
+		extra++;
+		mask >>= 1;
+	}
+	if (extra > 3 || p + extra > length) return false;
+
+	unsigned long delta = lead & (mask - 1);
+	for (unsigned char i = 0; i < extra; i++) {
+		delta = (delta << 8) | buf[p++];
+	}
+
+	advance(stamp, delta);
+	*pos = p;
+	return true;
+}
@@ -0,0 +1,107 @@
+/*
+ * File			DS1306Stamp.h
+ *
+ * Synopsis		Compact timestamps and delta encoded timestamp logs
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A ds1306stamp holds seconds since 2000-01-01 00:00:00 and, optionally, ticks of 1/256
+ * 			second. DS1306::getStamp() fills one from a single time burst (ticks 0) and
+ * 			DS1306SoftClock::getStamp() from RAM, with ticks from its sub-second phase.
+ *
+ * 			DS1306Stamp stores a stamp in DS1306_STAMP_SIZE (4) bytes, or DS1306_STAMP_SIZE_TICKS (5)
+ * 			bytes with ticks, least significant byte first, for user memory, EEPROM or a serial link.
+ * 			encodeArray() / decodeArray() convert arrays of stamps in one call.
+ *
+ * 			DS1306StampLog appends stamps to a caller supplied buffer, each as the difference from
+ * 			the one before (in seconds, or ticks when the log has ticks):
+ *
+ * 			0xxxxxxx									difference below 2^7, 1 byte
+ * 			10xxxxxx xxxxxxxx							below 2^14, 2 bytes
+ * 			110xxxxx xxxxxxxx xxxxxxxx					below 2^21, 3 bytes
+ * 			1110xxxx xxxxxxxx xxxxxxxx xxxxxxxx			below 2^28, 4 bytes
+ * 			11111111 followed by a stamp				the first stamp, or a larger or backward step
+ *
+ * 			High bits come first. Events under two minutes apart (half a second with ticks) thus
+ * 			cost one byte. append() returns false, logging nothing, once the next entry does not fit.
+ * 			rewind() and next() read the stamps back in order; setLength() takes over a log already
+ * 			in the buffer, for example one read back from user memory, so it can be read or extended.
+ */
+#ifndef __DS1306_STAMP_
+#define __DS1306_STAMP_
+
+#include "DS1306.h"
+
+/* Encoded sizes */
+#define DS1306_STAMP_SIZE			4
+#define DS1306_STAMP_SIZE_TICKS		5
+
+/* Ticks per second */
+#define DS1306_STAMP_TICKS			256
+
+/* Log entry introducing a full stamp */
+#define DS1306_STAMP_ABSOLUTE		0xFF
+
+/* Largest log entry */
+#define DS1306_STAMP_ENTRY_MAX		(1 + DS1306_STAMP_SIZE_TICKS)
+
+class DS1306Stamp
+{
+	public:
+
+	// Single stamp, DS1306_STAMP_SIZE or DS1306_STAMP_SIZE_TICKS bytes
+	static void encode(unsigned char *buf, const ds1306stamp *stamp, bool ticks = false);
+	static void decode(const unsigned char *buf, ds1306stamp *stamp, bool ticks = false);
+
+	// Arrays of count stamps, returns the bytes used
+	static unsigned int encodeArray(unsigned char *buf, const ds1306stamp *stamps, unsigned int count, bool ticks = false);
+	static unsigned int decodeArray(const unsigned char *buf, ds1306stamp *stamps, unsigned int count, bool ticks = false);
+};
+
+class DS1306StampLog
+{
+	public:
+
+	// Constructor, the log occupies up to size bytes of buf
+	DS1306StampLog(unsigned char *buf, unsigned int size, bool ticks = false);
+
+	// Writing
+	bool append(const ds1306stamp *stamp);
+	void clear();
+
+	// Reading, from the first stamp
+	void rewind();
+	bool next(ds1306stamp *stamp);
+
+	// Take over len bytes of log already in the buffer, false if they are not a valid log
+	bool setLength(unsigned int len);
+
+	// Bytes used and stamps held
+	unsigned int getLength();
+	unsigned int getCount();
+
+	private:
+
+	unsigned char *buf;
+	unsigned int size;
+	bool ticks;					// Stamps include ticks, differences are in ticks
+
+	unsigned int length;		// Bytes used
+	unsigned int count;			// Stamps held
+	ds1306stamp last;			// Last stamp appended
+
+	unsigned int readPos;		// Reading position
+	ds1306stamp readLast;		// Last stamp read
+
+	bool difference(const ds1306stamp *from, const ds1306stamp *to, unsigned long *delta);
+	void advance(ds1306stamp *stamp, unsigned long delta);
+	bool decodeEntry(unsigned int *pos, ds1306stamp *stamp);
+};
+
+#endif /* __DS1306_STAMP_ */
@@ -0,0 +1,389 @@
+/*
+ * File			DS1306Transaction.cpp
+ *
+ * Synopsis		Staged register updates, committed as the fewest contiguous burst writes
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <string.h>
+#endif
+#include "DS1306Transaction.h"
+#include "DS1306RawTime.h"
+
+#define DS1306_WP_BIT			(1 << DS1306_CR_WP)
+
+// Constructor
+DS1306Transaction::DS1306Transaction(DS1306 *rtc) : rtc(rtc), cr(0), crKnown(false), planned(0), excludeCR(false),
+	crFillable(false), crFill(0), tcrBorrowed(false)
+{
+	memset(image, 0, sizeof(image));
+	memset(staged, 0, sizeof(staged));
+	memset(known, 0, sizeof(known));
+}
+
+// Stage len bytes of data for writing to consecutive registers from address
+// Returns false, staging nothing, if the range leaves the clock registers or user memory
+bool DS1306Transaction::stage(unsigned char address, const unsigned char *data, int len)
+{
+	if (!inRange(address, len)) return false;
+
+	for (int i = 0; i < len; i++, address++) {
+		image[address] = data[i];
+		setBit(staged, address, true);
+
+		// The image no longer holds the chip's value (CR's current value is held apart)
+		setBit(known, address, false);
+	}
+	return true;
+}
+
+// Stage a single register for writing
+bool DS1306Transaction::stage(unsigned char address, unsigned char value)
+{
+	return stage(address, &value, 1);
+}
+
+// Stage the current time
+// Time set uses hours (when writeHours24 = true), hours12/ampm (when writeHours24 = false)
+void DS1306Transaction::setTime(const ds1306time *time)
+{
+	unsigned char buf[DS1306_SIZE_DATETIME];
+	rtc->encodeTimePacket(buf, time);
+	stage(DS1306_DATETIME, buf, DS1306_SIZE_DATETIME);
+}
+
+// Stage the current time from seconds since 2000-01-01 00:00:00
+void DS1306Transaction::setEpoch(unsigned long epoch)
+{
+	DS1306RawTime raw;
+	raw.setEpoch(epoch, rtc->writeHours24);
+	stage(DS1306_DATETIME, raw.regs, DS1306_SIZE_DATETIME);
+}
+
+#if DS1306_ALARMS
+// Stage an alarm, alarm must be 0 or 1 else nothing is done
+void DS1306Transaction::setAlarm(int alarm, const ds1306alarm *time)
+{
+	if (alarm < 0 || alarm > 1) return;
+
+	unsigned char buf[DS1306_SIZE_ALARM];
+	rtc->encodeAlarmPacket(buf, time);
+	stage(alarm == 0 ? DS1306_ALARM0 : DS1306_ALARM1, buf, DS1306_SIZE_ALARM);
+}
+
+// Stage enabling or disabling an alarm interrupt, alarm must be 0 or 1 else nothing is done
+void DS1306Transaction::setAlarmEnabled(unsigned int alarm, bool enabled)
+{
+	if (alarm > 1) return;
+
+	unsigned char value = controlForUpdate();
+	value = enabled ? (value | (1 << alarm)) : (value & ~(1 << alarm));
+	stage(DS1306_CR, value);
+}
+#endif
+
+// Stage the 1Hz output state
+void DS1306Transaction::set1HzState(bool enabled)
+{
+	unsigned char value = controlForUpdate();
+	value = enabled ? (value | (1 << DS1306_CR_1HZ)) : (value & ~(1 << DS1306_CR_1HZ));
+	stage(DS1306_CR, value);
+}
+
+// Stage the write protection state
+void DS1306Transaction::setWriteProtection(bool on)
+{
+	unsigned char value = controlForUpdate();
+	value = on ? (value | DS1306_WP_BIT) : (value & ~DS1306_WP_BIT);
+	stage(DS1306_CR, value);
+}
+
+#if DS1306_TRICKLE
+// Stage enabling trickle charging
+// Must provide number of diodes (1 or 2) and KOhm resistance (2, 4 or 8), else false is returned
+bool DS1306Transaction::enableTrickleCharge(unsigned char numDiodes, unsigned char kRes)
+{
+	unsigned char byte;
+	if (!DS1306::encodeTrickleByte(numDiodes, kRes, &byte)) return false;
+
+	stage(DS1306_TCR, byte);
+	return true;
+}
+
+// Stage disabling trickle charging
+void DS1306Transaction::disableTrickleCharge()
+{
+	stage(DS1306_TCR, (unsigned char) 0);
+}
+#endif
+
+// Stage num elements of user memory, starting at addr
+// Will fail and return false if write does not fall within the bounds of user memory space
+bool DS1306Transaction::writeUser(unsigned char addr, const char *buf, int num)
+{
+	if (addr < DS1306_USER_START) return false;
+	return stage(addr, (const unsigned char *) buf, num);
+}
+
+// Read registers into the image with a single burst, so they can be used to bridge gaps
+// Staged registers keep their staged value. As with any access, reading alarm registers clears
+// the alarm flags on the chip.
+void DS1306Transaction::load(unsigned char address, int len)
+{
+	if (!inRange(address, len)) return;
+
+	rtc->cacheNoteAccess(address, len, false);
+	rtc->busBegin();
+	rtc->busSend(address);
+	for (int i = 0; i < len; i++, address++) {
+		unsigned char value = rtc->busTransfer(0x00);
+		if (address == DS1306_CR) {
+			cr = value;
+			crKnown = true;
+		} else if (!isStaged(address)) {
+			image[address] = value;
+			setBit(known, address, true);
+		}
+	}
+	rtc->busEnd();
+}
+
+// Forget every known register value, call if registers have changed behind the builder's back
+void DS1306Transaction::forget()
+{
+	memset(known, 0, sizeof(known));
+	crKnown = false;
+}
+
+// Work out the transactions commit() would use, without writing
+unsigned char DS1306Transaction::plan()
+{
+	return build(false);
+}
+
+// Write everything staged, returning the number of transactions used
+unsigned char DS1306Transaction::commit()
+{
+	return build(true);
+}
+
+// Drop everything staged
+void DS1306Transaction::discard()
+{
+	memset(staged, 0, sizeof(staged));
+	planned = 0;
+}
+
+// Number of transactions found by the last plan() or commit()
+unsigned char DS1306Transaction::getPlannedCount()
+{
+	return planned;
+}
+
+// Address and length of a planned transaction, in execution order
+// Only the first DS1306_TRANSACTION_PLAN transactions are recorded, false beyond that
+bool DS1306Transaction::getPlanned(unsigned char index, unsigned char *address, unsigned char *len)
+{
+	if (index >= planned || index >= DS1306_TRANSACTION_PLAN) return false;
+
+	*address = plannedAddress[index];
+	*len = plannedLen[index];
+	return true;
+}
+
+// Plan, and when execute is set perform, the writes for everything staged
+// Order: CR alone if it clears WP, bursts over the clock registers, bursts over user memory,
+// then CR alone if it sets WP
+unsigned char DS1306Transaction::build(bool execute)
+{
+	planned = 0;
+
+	// Current CR, from the image or the DS1306 cache
+	bool nowKnown = crKnown;
+	unsigned char now = cr;
+	if (!nowKnown && rtc->cacheEnabled && (rtc->cacheValid & (1 << DS1306_CACHE_CR))) {
+		nowKnown = true;
+		now = rtc->cache[DS1306_CACHE_CR];
+	}
+
+	// Current TCR may also come from the DS1306 cache, for this build only
+	tcrBorrowed = !getBit(staged, DS1306_TCR) && !getBit(known, DS1306_TCR) && rtc->cacheEnabled &&
+		(rtc->cacheValid & (1 << DS1306_CACHE_TCR));
+	if (tcrBorrowed) image[DS1306_TCR] = rtc->cache[DS1306_CACHE_TCR];
+
+	bool crStaged = getBit(staged, DS1306_CR);
+	bool clearing = crStaged && !(image[DS1306_CR] & DS1306_WP_BIT) && (!nowKnown || (now & DS1306_WP_BIT));
+	bool setting = crStaged && (image[DS1306_CR] & DS1306_WP_BIT);
+
+	excludeCR = false;
+	if (clearing) emit(DS1306_CR, 1, execute);
+
+	// While protected only WP was accepted, so CR goes in a burst again unless nothing else changes
+	excludeCR = setting || (clearing && nowKnown && !((image[DS1306_CR] ^ now) & ~DS1306_WP_BIT));
+	crFillable = clearing || nowKnown;
+	crFill = clearing ? image[DS1306_CR] : now;
+
+	buildSpace(DS1306_DATETIME, DS1306_TCR, execute);
+	buildSpace(DS1306_USER_START, DS1306_USER_END, execute);
+
+	if (setting) {
+		excludeCR = false;
+		emit(DS1306_CR, 1, execute);
+	}
+
+	if (execute) {
+		// Writes were accepted if WP was clear, or has been cleared first
+		bool accepted = clearing || (nowKnown && !(now & DS1306_WP_BIT));
+
+		for (unsigned char address = 0; address < DS1306_TRANSACTION_SPACE; address++) {
+			if (!getBit(staged, address)) continue;
+
+			if (address == DS1306_CR) {
+				cr = image[DS1306_CR];
+				crKnown = accepted;
+			} else if (address >= DS1306_ALARM0 && address != DS1306_SR) {
+				// Time registers move on by themselves, SR is read only
+				setBit(known, address, accepted);
+			}
+		}
+		memset(staged, 0, sizeof(staged));
+	}
+
+	return planned;
+}
+
+// Emit bursts covering the staged registers between low and high inclusive
+// A burst is extended over a gap when every register in the gap can be rewritten with its current value
+void DS1306Transaction::buildSpace(unsigned char low, unsigned char high, bool execute)
+{
+	unsigned char address = low;
+
+	while (address <= high) {
+		if (!isStaged(address)) {
+			address++;
+			continue;
+		}
+
+		unsigned char start = address;
+		unsigned char end = address;
+		for (unsigned char next = end + 1; next <= high; next++) {
+			if (!isStaged(next)) continue;
+
+			bool bridge = true;
+			for (unsigned char gap = end + 1; gap < next; gap++) {
+				if (!isFillable(gap)) {
+					bridge = false;
+					break;
+				}
+			}
+			if (!bridge) break;
+			end = next;
+		}
+
+		emit(start, end - start + 1, execute);
+		address = end + 1;
+	}
+}
+
+// Record a transaction, writing it when execute is set
+void DS1306Transaction::emit(unsigned char address, unsigned char len, bool execute)
+{
+	if (planned < DS1306_TRANSACTION_PLAN) {
+		plannedAddress[planned] = address;
+		plannedLen[planned] = len;
+	}
+	if (planned < 0xFF) planned++;
+
+	if (!execute) return;
+
+	rtc->cacheNoteAccess(address, len, true);
+	rtc->busBegin();
+	rtc->busSend(address | DS1306_WRITE_OFFSET);
+	for (unsigned char i = 0; i < len; i++) {
+		rtc->busSend(valueAt(address + i));
+	}
+	rtc->busEnd();
+}
+
+// Value to write to a register, its staged value or else its current value
+unsigned char DS1306Transaction::valueAt(unsigned char address)
+{
+	if (address == DS1306_CR && (excludeCR || !getBit(staged, DS1306_CR))) return crFill;
+	return image[address];
+}
+
+// True if the register is to be written as part of a burst
+bool DS1306Transaction::isStaged(unsigned char address)
+{
+	if (address == DS1306_CR && excludeCR) return false;
+	return getBit(staged, address);
+}
+
+// True if the register's current value is known, so it may be rewritten to bridge a gap
+// Writing an alarm register clears that alarm's IRQF, so alarm registers only bridge a gap
+// when a register of the same alarm is staged and the flag is cleared anyway
+bool DS1306Transaction::isFillable(unsigned char address)
+{
+	if (address < DS1306_ALARM0) return false;
+	if (address < DS1306_ALARM1) return isAlarmStaged(DS1306_ALARM0) && getBit(known, address);
+	if (address < DS1306_ALARM1 + DS1306_SIZE_ALARM) return isAlarmStaged(DS1306_ALARM1) && getBit(known, address);
+	if (address == DS1306_CR) return crFillable;
+	if (address == DS1306_SR) return true;
+	if (address == DS1306_TCR && tcrBorrowed) return true;
+	return getBit(known, address);
+}
+
+// True if any register of the alarm at base is staged
+bool DS1306Transaction::isAlarmStaged(unsigned char base)
+{
+	for (unsigned char address = base; address < base + DS1306_SIZE_ALARM; address++) {
+		if (getBit(staged, address)) return true;
+	}
+	return false;
+}
+
+// CR value to modify, the staged value if any else the current value (read once if unknown)
+unsigned char DS1306Transaction::controlForUpdate()
+{
+	if (getBit(staged, DS1306_CR)) return image[DS1306_CR];
+
+	if (!crKnown) {
+		cr = rtc->readControl(DS1306_CR);
+		crKnown = true;
+	}
+	return cr;
+}
+
+// True if len registers from address lie within the clock registers or within user memory
+bool DS1306Transaction::inRange(unsigned char address, int len)
+{
+	if (len < 1) return false;
+
+	int last = address + len - 1;
+	if (last <= DS1306_TCR) return true;
+	return (address >= DS1306_USER_START && last <= DS1306_USER_END) ? true : false;
+}
+
+// Read a register's bit from a bitmap
+bool DS1306Transaction::getBit(const unsigned char *bits, unsigned char address)
+{
+	return (bits[address >> 3] & (1 << (address & 0x07))) ? true : false;
+}
+
+// Set or clear a register's bit in a bitmap
+void DS1306Transaction::setBit(unsigned char *bits, unsigned char address, bool on)
+{
+	if (on) {
+		bits[address >> 3] |= (1 << (address & 0x07));
+	} else {
+		bits[address >> 3] &= ~(1 << (address & 0x07));
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * File			DS1306Transaction.h
+ *
+ * Synopsis		Staged register updates, committed as the fewest contiguous burst writes
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Create a DS1306Transaction for an initialized DS1306 and stage updates with the setters,
+ * 			which mirror those of DS1306 (setTime, setAlarm, setAlarmEnabled, set1HzState,
+ * 			setWriteProtection, enableTrickleCharge, writeUser ...) or with stage() for raw registers.
+ * 			Nothing is written until commit(). plan() works out the same transactions without
+ * 			writing, and getPlannedCount() / getPlanned() report them.
+ *
+ * 			Staged bytes are grouped into address contiguous bursts. Two bursts are merged when every
+ * 			register between them can be rewritten with its current value, taken from the builder's
+ * 			image (registers it has loaded with load() or written in an earlier commit) or, for CR
+ * 			and TCR, from the DS1306 control register cache. SR is read only, so it can always be
+ * 			bridged. The time registers are never used to bridge a gap, since the clock moves on.
+ * 			Nor are the registers of an alarm with nothing staged: any write to an alarm register
+ * 			clears that alarm's IRQF in SR, so rewriting one unchanged would lose a pending alarm.
+ * 			Staging time and CR, for instance, takes two transactions rather than one burst over
+ * 			both alarms. The known registers of an alarm with any register staged may be bridged,
+ * 			as its flag is cleared by the commit in any case.
+ * 			The clock registers (0x00 - 0x11) and user memory (0x20 - 0x7F) are never merged.
+ *
+ * 			While WP is set the chip only accepts the WP bit. A staged CR that clears WP (unless WP is
+ * 			known to be clear already) is written on its own first; one that sets WP is written on its
+ * 			own last, after everything it would otherwise block.
+ *
+ * 			setAlarmEnabled(), set1HzState() and setWriteProtection() modify CR; if CR is neither
+ * 			staged nor known it is read once when first needed. Call forget() if registers held in
+ * 			the image are changed other than through this builder.
+ */
+#ifndef __DS1306_TRANSACTION_
+#define __DS1306_TRANSACTION_
+
+#include "DS1306.h"
+
+/* Registers covered by the builder, 0x00 - 0x7F */
+#define DS1306_TRANSACTION_SPACE	0x80
+
+class DS1306Transaction
+{
+	public:
+
+	// Constructor, rtc must be initialized before commit() is called
+	DS1306Transaction(DS1306 *rtc);
+
+	// Raw staging, false (nothing staged) if the range leaves 0x00 - 0x11 or 0x20 - 0x7F
+	bool stage(unsigned char address, const unsigned char *data, int len);
+	bool stage(unsigned char address, unsigned char value);
+
+	// Staging setters, as their DS1306 counterparts
+	void setTime(const ds1306time *time);
+	void setEpoch(unsigned long epoch);
+#if DS1306_ALARMS
+	void setAlarm(int alarm, const ds1306alarm *time);
+	void setAlarmEnabled(unsigned int alarm, bool enabled);
+#endif
+	void set1HzState(bool enabled);
+	void setWriteProtection(bool on);
+#if DS1306_TRICKLE
+	bool enableTrickleCharge(unsigned char numDiodes, unsigned char kRes);
+	void disableTrickleCharge();
+#endif
+	bool writeUser(unsigned char addr, const char *buf, int num);
+
+	// Image of current register values, used to bridge gaps between bursts
+	void load(unsigned char address, int len);
+	void forget();
+
+	// Planning and execution, each returns the number of transactions
+	unsigned char plan();
+	unsigned char commit();
+	void discard();
+
+	// Transactions found by the last plan() or commit()
+	unsigned char getPlannedCount();
+	bool getPlanned(unsigned char index, unsigned char *address, unsigned char *len);
+
+	private:
+
+	DS1306 *rtc;
+
+	unsigned char image[DS1306_TRANSACTION_SPACE];			// Staged value, else current value when known
+	unsigned char staged[DS1306_TRANSACTION_SPACE / 8];	// Bit per register staged for writing
+	unsigned char known[DS1306_TRANSACTION_SPACE / 8];	// Bit per register whose image value is current
+
+	// Current CR, kept apart from the image since WP ordering compares it with a staged CR
+	unsigned char cr;
+	bool crKnown;
+
+	unsigned char planned;
+	unsigned char plannedAddress[DS1306_TRANSACTION_PLAN];
+	unsigned char plannedLen[DS1306_TRANSACTION_PLAN];
+
+	// Working state of build()
+	bool excludeCR;				// CR is written on its own, not as part of a burst
+	bool crFillable;			// CR's value is known when not staged or excluded
+	unsigned char crFill;		// That value
+	bool tcrBorrowed;			// TCR's image value was taken from the DS1306 cache
+
+	unsigned char build(bool execute);
+	void buildSpace(unsigned char low, unsigned char high, bool execute);
+	void emit(unsigned char address, unsigned char len, bool execute);
+	unsigned char valueAt(unsigned char address);
+	bool isStaged(unsigned char address);
+	bool isFillable(unsigned char address);
+	bool isAlarmStaged(unsigned char base);
+	unsigned char controlForUpdate();
+	static bool inRange(unsigned char address, int len);
+	static bool getBit(const unsigned char *bits, unsigned char address);
+	static void setBit(unsigned char *bits, unsigned char address, bool on);
+};
+
+#endif /* __DS1306_TRANSACTION_ */
@@ -0,0 +1,197 @@
+/*
+ * File			DS1306UserCache.cpp
+ *
+ * Synopsis		Write-back RAM mirror of the DS1306 user memory (0x20 - 0x7F)
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ */
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <string.h>
+#endif
+#include "DS1306UserCache.h"
+
+// Constructor
+DS1306UserCache::DS1306UserCache(DS1306 *rtc) : rtc(rtc), dirtyBytes(0), gap(DS1306_USERCACHE_GAP), flushCount(0),
+	pendingWrites(0), flushInterval(0), dirtySince(0)
+{
+#ifdef ARDUINO
+	millisSource = millis;
+#else
+	millisSource = 0;
+#endif
+	memset(mirror, 0, sizeof(mirror));
+	memset(dirty, 0, sizeof(dirty));
+	resetCounters();
+}
+
+// Load the mirror with a single burst read of user memory, discarding any unflushed writes
+void DS1306UserCache::begin()
+{
+	rtc->read(DS1306_USER_START, mirror, DS1306_USERCACHE_SIZE);
+	busTransactions++;
+	busBytes += 1 + DS1306_USERCACHE_SIZE;
+
+	memset(dirty, 0, sizeof(dirty));
+	dirtyBytes = 0;
+	pendingWrites = 0;
+}
+
+// Write num elements of user memory, starting at addr, into the mirror
+// Will fail and return false if write does not fall within the bounds of user memory space
+// May flush to the chip if an automatic flush policy is due
+bool DS1306UserCache::writeUser(unsigned char addr, const char *buf, int num)
+{
+	if (!inRange(addr, num)) return false;
+
+	unsigned char offset = addr - DS1306_USER_START;
+	if (dirtyBytes == 0 && millisSource) dirtySince = millisSource();
+
+	for (int i = 0; i < num; i++, offset++) {
+		mirror[offset] = buf[i];
+		if (!isDirtyByte(offset)) {
+			dirty[offset >> 3] |= (1 << (offset & 0x07));
+			dirtyBytes++;
+		}
+	}
+
+	requestedTransactions++;
+	requestedBytes += 1 + num;
+	pendingWrites++;
+
+	if (flushCount && pendingWrites >= flushCount) {
+		flush();
+	} else {
+		poll();
+	}
+	return true;
+}
+
+// Read num elements of user memory, starting at addr, from the mirror
+// Will fail and return false, leaving buf untouched, if read does not fall within the bounds of user memory space
+bool DS1306UserCache::readUser(unsigned char addr, char *buf, int num)
+{
+	if (!inRange(addr, num)) return false;
+
+	memcpy(buf, &mirror[addr - DS1306_USER_START], num);
+	requestedTransactions++;
+	requestedBytes += 1 + num;
+	return true;
+}
+
+// Write dirty bytes back to the chip
+// Dirty runs separated by up to gap clean bytes share a burst, so the number of bus transactions
+// (returned) is the number of dirty runs after merging
+unsigned char DS1306UserCache::flush()
+{
+	unsigned char transactions = 0;
+	unsigned char offset = 0;
+
+	while (dirtyBytes && offset < DS1306_USERCACHE_SIZE) {
+		// Skip whole clean bytes of the bitmap
+		if (!dirty[offset >> 3] && !(offset & 0x07)) {
+			offset += 8;
+			continue;
+		}
+		if (!isDirtyByte(offset)) {
+			offset++;
+			continue;
+		}
+
+		// Extend the run while the next dirty byte is within gap clean bytes of its end
+		unsigned char start = offset;
+		unsigned char end = offset;
+		for (offset++; offset < DS1306_USERCACHE_SIZE && offset - end <= gap + 1; offset++) {
+			if (isDirtyByte(offset)) end = offset;
+		}
+
+		unsigned char len = end - start + 1;
+		rtc->write(DS1306_USER_START + start, &mirror[start], len);
+		transactions++;
+		busBytes += 1 + len;
+	}
+
+	busTransactions += transactions;
+	memset(dirty, 0, sizeof(dirty));
+	dirtyBytes = 0;
+	pendingWrites = 0;
+	return transactions;
+}
+
+// Returns true if the mirror holds writes not yet flushed to the chip
+bool DS1306UserCache::isDirty()
+{
+	return dirtyBytes ? true : false;
+}
+
+// Set the number of clean bytes a single flush burst may span to join two dirty runs
+void DS1306UserCache::setGapThreshold(unsigned char gap)
+{
+	this->gap = gap;
+}
+
+// Flush automatically after this many writeUser() calls, 0 disables
+void DS1306UserCache::setFlushCount(unsigned int writes)
+{
+	flushCount = writes;
+}
+
+// Flush automatically once the oldest unflushed write is this many milliseconds old, 0 disables
+void DS1306UserCache::setFlushInterval(unsigned long ms)
+{
+	flushInterval = ms;
+}
+
+// Flush if the interval policy is due, call regularly from loop()
+void DS1306UserCache::poll()
+{
+	if (dirtyBytes && flushInterval && millisSource && millisSource() - dirtySince >= flushInterval) {
+		flush();
+	}
+}
+
+// Provide the millisecond time source used by the interval policy
+void DS1306UserCache::setMillisSource(unsigned long (*source)())
+{
+	millisSource = source;
+}
+
+// Bus transactions avoided compared with uncached readUser / writeUser calls
+unsigned long DS1306UserCache::getTransactionsSaved()
+{
+	return (requestedTransactions > busTransactions) ? requestedTransactions - busTransactions : 0;
+}
+
+// Bus bytes (address bytes included) avoided compared with uncached readUser / writeUser calls
+// Negative if loading the mirror and bridging gaps has so far cost more than it saved
+long DS1306UserCache::getBytesSaved()
+{
+	return (long) (requestedBytes - busBytes);
+}
+
+// Reset statistics
+void DS1306UserCache::resetCounters()
+{
+	requestedTransactions = 0;
+	requestedBytes = 0;
+	busTransactions = 0;
+	busBytes = 0;
+}
+
+// True if addr and num describe a non-empty range within user memory
+bool DS1306UserCache::inRange(unsigned char addr, int num)
+{
+	return (num > 0 && addr >= DS1306_USER_START && addr <= DS1306_USER_END && (addr + num - 1) <= DS1306_USER_END) ? true : false;
+}
+
+// True if the mirrored byte at offset is dirty
+bool DS1306UserCache::isDirtyByte(unsigned char offset)
+{
+	return (dirty[offset >> 3] & (1 << (offset & 0x07))) ? true : false;
+}
@@ -0,0 +1,101 @@
+/*
+ * File			DS1306UserCache.h
+ *
+ * Synopsis		Write-back RAM mirror of the DS1306 user memory (0x20 - 0x7F)
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 			Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			Create a DS1306UserCache for an initialized DS1306 and call begin(), which loads all 96 bytes
+ * 			of user memory in a single burst. readUser() and writeUser() then take the same arguments as
+ * 			their DS1306 counterparts but operate on RAM; written bytes are marked dirty.
+ *
+ * 			flush() writes the dirty bytes back to the chip. Dirty runs separated by no more than the
+ * 			gap threshold (setGapThreshold) clean bytes are merged into one burst, since resending a few
+ * 			clean bytes is cheaper than a further chip enable cycle and address byte. Call flush() as a
+ * 			barrier wherever the data must be on the chip, for example before sleeping.
+ *
+ * 			Writes can also be flushed automatically, after a number of writeUser() calls
+ * 			(setFlushCount) and/or once the oldest unflushed write reaches an age in milliseconds
+ * 			(setFlushInterval). The age is checked on each writeUser() and on poll(); call poll() from
+ * 			loop() if writes may stop arriving. On host builds there is no millis(), supply one with
+ * 			setMillisSource() to use the interval policy.
+ *
+ * 			All user memory access must go through the cache while it is in use, or call begin() again
+ * 			to reload it. Clock write protection must be off for flush() to take effect.
+ */
+#ifndef __DS1306_USERCACHE_
+#define __DS1306_USERCACHE_
+
+#include "DS1306.h"
+
+/* Bytes of user memory mirrored */
+#define DS1306_USERCACHE_SIZE	(DS1306_USER_END - DS1306_USER_START + 1)
+
+/* Default number of clean bytes a single flush burst may span */
+#define DS1306_USERCACHE_GAP	2
+
+class DS1306UserCache
+{
+	public:
+
+	// Constructor, rtc must be initialized before begin() is called
+	DS1306UserCache(DS1306 *rtc);
+
+	// Load the mirror from the chip, discarding any unflushed writes
+	void begin();
+
+	// User memory access, same arguments as DS1306::readUser / DS1306::writeUser
+	bool writeUser(unsigned char addr, const char *buf, int num);
+	bool readUser(unsigned char addr, char *buf, int num);
+
+	// Write dirty bytes back to the chip, returning the number of bus transactions used
+	unsigned char flush();
+	bool isDirty();
+
+	// Flush policy
+	void setGapThreshold(unsigned char gap);
+	void setFlushCount(unsigned int writes);
+	void setFlushInterval(unsigned long ms);
+	void poll();
+
+	// Millisecond time source for the interval policy (defaults to millis() on Arduino)
+	void setMillisSource(unsigned long (*source)());
+
+	// Statistics, comparing bus traffic with uncached DS1306::readUser / DS1306::writeUser calls
+	unsigned long getTransactionsSaved();
+	long getBytesSaved();
+	void resetCounters();
+
+	private:
+
+	DS1306 *rtc;
+
+	unsigned char mirror[DS1306_USERCACHE_SIZE];
+	unsigned char dirty[(DS1306_USERCACHE_SIZE + 7) / 8];	// Bit per mirrored byte
+	unsigned char dirtyBytes;		// Number of dirty bits set
+
+	unsigned char gap;				// Clean bytes a flush burst may span
+	unsigned int flushCount;		// writeUser() calls before an automatic flush, 0 for never
+	unsigned int pendingWrites;		// writeUser() calls since the last flush
+	unsigned long flushInterval;	// Age in ms of the oldest dirty byte before a flush, 0 for never
+	unsigned long dirtySince;		// Time the cache became dirty
+
+	unsigned long (*millisSource)();
+
+	// Traffic the uncached calls would have used, and traffic actually used
+	unsigned long requestedTransactions;
+	unsigned long requestedBytes;
+	unsigned long busTransactions;
+	unsigned long busBytes;
+
+	bool inRange(unsigned char addr, int num);
+	bool isDirtyByte(unsigned char offset);
+};
+
+#endif /* __DS1306_USERCACHE_ */
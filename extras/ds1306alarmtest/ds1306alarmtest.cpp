@@ -0,0 +1,229 @@
+/*
+ * File			ds1306alarmtest.cpp
+ *
+ * Synopsis		Brute force host check of the closed form alarm delay in DS1306RawTime
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306alarmtest extras/ds1306alarmtest/ds1306alarmtest.cpp *.cpp
+ *
+ * 			DS1306RawTime::secondsToAlarm() works out the next firing field by field. Here it is
+ * 			compared with matching the alarm against every second of a week, as the chip does while
+ * 			it ticks, for alarms built from each combination of DS1306_ANY and values at and beyond
+ * 			the edges of every field, at every second of the week, with the alarm given in 24 hour
+ * 			and in 12 hour form. The week is matched twice over so firings that wrap from day 7 back
+ * 			to day 1 are found. This takes around half a minute.
+ *
+ * 			nextAlarm() is then checked from random times held in either register form, with the
+ * 			chip's day of week numbering offset from the calendar's, DS1306Scheduler::nextFire()
+ * 			against the same delay, and finally the delay against DS1306Emulator ticking until the
+ * 			alarm flag rises. One line is printed per check:
+ *
+ * 			CHECK,<name>,<cases>,<failures>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306RawTime.h"
+#include "DS1306Scheduler.h"
+
+#if !DS1306_ALARMS
+#error "ds1306alarmtest needs DS1306_ALARMS set to 1"
+#endif
+
+#define WEEK			604800L
+
+// Random cases for nextAlarm() and the scheduler, and for the emulator
+#define TEST_RANDOM		20000
+#define TEST_EMULATED	300
+
+// Delay from each second of the week to the next match, found by matching every second
+unsigned long delays[WEEK];
+
+unsigned long failures = 0;
+
+// Print a check result
+void check(const char *name, unsigned long cases, unsigned long failed)
+{
+	printf("CHECK,%s,%lu,%lu\n", name, cases, failed);
+	failures += failed;
+}
+
+// True if the alarm matches a second of the week, day of week numbered from 1
+bool matches(const ds1306alarm *alarm, long second)
+{
+	long tod = second % 86400;
+	if (!(alarm->seconds & DS1306_ANY) && alarm->seconds != tod % 60) return false;
+	if (!(alarm->minutes & DS1306_ANY) && alarm->minutes != tod / 60 % 60) return false;
+	if (!(alarm->hours & DS1306_ANY) && alarm->hours != tod / 3600) return false;
+	if (!(alarm->dow & DS1306_ANY) && alarm->dow != second / 86400 + 1) return false;
+	return true;
+}
+
+// Fill in the delay table, scanning two weeks back from the end so a match next week is seen
+void simulate(const ds1306alarm *alarm)
+{
+	long next = -1;
+	for (long second = 2 * WEEK - 1; second >= 0; second--) {
+		if (second < WEEK) delays[second] = (next < 0) ? DS1306_ALARM_NEVER : (unsigned long) (next - second);
+		if (matches(alarm, second % WEEK)) next = second;
+	}
+}
+
+// The same alarm with its hours in 12 hour form, and the 24 hour field garbage
+void toHours12(const ds1306alarm *alarm, ds1306alarm *alarm12)
+{
+	*alarm12 = *alarm;
+	alarm12->hours = 0x55;
+	if (alarm->hours & DS1306_ANY) {
+		alarm12->hours12 = DS1306_ANY;
+	} else if (alarm->hours < 24) {
+		alarm12->hours12 = (alarm->hours % 12) ? (alarm->hours % 12) : 12;
+		alarm12->ampm = (alarm->hours >= 12) ? 'P' : 'A';
+	} else {
+		alarm12->hours12 = 13;
+		alarm12->ampm = 'A';
+	}
+}
+
+// Every alarm built from the field values, at every second of the week
+void checkClosedForm()
+{
+	static const unsigned char seconds[] = { DS1306_ANY, 0, 1, 29, 58, 59, 60 };
+	static const unsigned char minutes[] = { DS1306_ANY, 0, 1, 30, 59, 61 };
+	static const unsigned char hours[] = { DS1306_ANY, 0, 1, 11, 12, 13, 23, 24 };
+	static const unsigned char dows[] = { DS1306_ANY, 1, 4, 7, 0, 8 };
+	unsigned long cases = 0, failed24 = 0, failed12 = 0;
+
+	for (unsigned char a = 0; a < sizeof(seconds); a++) {
+		for (unsigned char b = 0; b < sizeof(minutes); b++) {
+			for (unsigned char c = 0; c < sizeof(hours); c++) {
+				for (unsigned char d = 0; d < sizeof(dows); d++) {
+					ds1306alarm alarm = { seconds[a], minutes[b], hours[c], 0, 0, dows[d] };
+					ds1306alarm alarm12;
+					toHours12(&alarm, &alarm12);
+					simulate(&alarm);
+
+					for (long second = 0; second < WEEK; second++) {
+						long tod = second % 86400;
+						ds1306time time = { (unsigned char) (tod % 60), (unsigned char) (tod / 60 % 60),
+							(unsigned char) (tod / 3600), 0, 0, (unsigned char) (second / 86400 + 1), 1, 1, 0 };
+						if (DS1306RawTime::secondsToAlarm(&time, &alarm) != delays[second]) failed24++;
+						if (DS1306RawTime::secondsToAlarm(&time, &alarm12, false) != delays[second]) failed12++;
+						cases++;
+					}
+				}
+			}
+		}
+	}
+	check("closed_form_24", cases, failed24);
+	check("closed_form_12", cases, failed12);
+}
+
+// A random time in range with a week to spare
+unsigned long randomEpoch()
+{
+	return ((unsigned long) rand() * 7919UL + rand()) % (DS1306_EPOCH_MAX - WEEK);
+}
+
+// A random alarm, valid fields or DS1306_ANY
+void randomAlarm(ds1306alarm *alarm, bool anySeconds)
+{
+	alarm->seconds = (anySeconds && rand() % 3 == 0) ? DS1306_ANY : rand() % 60;
+	alarm->minutes = (rand() % 3 == 0) ? DS1306_ANY : rand() % 60;
+	alarm->hours = (rand() % 2) ? DS1306_ANY : rand() % 24;
+	alarm->hours12 = 0;
+	alarm->ampm = 0;
+	alarm->dow = (rand() % 2) ? DS1306_ANY : rand() % 7 + 1;
+}
+
+// nextAlarm() from raw times in either hour form, and the scheduler's firing time
+void checkNextAlarm()
+{
+	unsigned long failedNext = 0, failedScheduler = 0;
+	srand(5);
+
+	for (int i = 0; i < TEST_RANDOM; i++) {
+		unsigned long epoch = randomEpoch();
+		DS1306RawTime raw, next;
+		raw.setEpoch(epoch, rand() & 1);
+
+		// The chip's day of week numbering need not be the calendar's
+		raw.regs[3] = (raw.regs[3] + 2) % 7 + 1;
+
+		ds1306alarm alarm;
+		randomAlarm(&alarm, true);
+		unsigned long delay = raw.secondsToAlarm(&alarm);
+		if (!raw.nextAlarm(&alarm, &next) || next.getEpoch() != epoch + delay ||
+			(next.regs[2] & 0x40) != (raw.regs[2] & 0x40) ||
+			(!(alarm.dow & DS1306_ANY) && next.getDow() != alarm.dow) ||
+			(!(alarm.hours & DS1306_ANY) && next.getHours() != alarm.hours)) {
+			failedNext++;
+		}
+
+		// The scheduler numbers days of week as the calendar does
+		DS1306RawTime calendar;
+		calendar.setEpoch(epoch);
+		if (DS1306Scheduler::nextFire(&alarm, epoch) != epoch + calendar.secondsToAlarm(&alarm)) failedScheduler++;
+	}
+	check("next_alarm", TEST_RANDOM, failedNext);
+	check("scheduler", TEST_RANDOM, failedScheduler);
+}
+
+// The delay against the emulator ticking until the alarm flag rises, alarms written in either hour form
+void checkEmulator()
+{
+	unsigned long failed = 0;
+
+	for (int i = 0; i < TEST_EMULATED; i++) {
+		bool hours24 = i & 1;
+		DS1306Emulator emu;
+		DS1306 rtc(hours24);
+		rtc.attach(&emu);
+		rtc.init(0);
+		rtc.setEpoch(randomEpoch());
+
+		ds1306alarm alarm;
+		randomAlarm(&alarm, false);
+		if (rand() % 4) alarm.dow = DS1306_ANY;
+		if (!hours24) {
+			ds1306alarm alarm24 = alarm;
+			toHours12(&alarm24, &alarm);
+		}
+		rtc.setAlarm(0, &alarm);
+		rtc.clearAlarmState(0);
+
+		DS1306RawTime now;
+		rtc.getRawTime(&now);
+		unsigned long delay = now.secondsToAlarm(&alarm, hours24);
+		unsigned long ticks = 0;
+		while (!(emu.peek(DS1306_SR) & 1) && ticks <= WEEK) {
+			emu.tick();
+			ticks++;
+		}
+		if (ticks != delay) failed++;
+	}
+	check("emulator", TEST_EMULATED, failed);
+}
+
+int main()
+{
+	checkClosedForm();
+	checkNextAlarm();
+	checkEmulator();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
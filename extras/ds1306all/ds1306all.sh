@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+# File			ds1306all.sh
+#
+# Synopsis		Build and run every host program under extras/ with the flags each one needs
+#
+# Author		Chris Bearman
+#
+# Version		1.0
+#
+# License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+# 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+#
+# Instructions
+# 			A host script, not a sketch. From the library directory run
+#
+# 			sh extras/ds1306all/ds1306all.sh
+#
+# 			Each program is built as its header describes, with the library sources, into a temporary
+# 			directory and then run without arguments (ds1306spidevbench against its emulator), and
+# 			extras/ds1306size/ds1306size.sh is run last. The programs and their extra flags are:
+#
+# 			ds1306locktest			-DDS1306_BUS_LOCK=1, linked with -lpthread
+# 			ds1306spidevbench		-DDS1306_BUS=DS1306_BUS_SPIDEV
+# 			all others				none
+#
+# 			Warnings are errors: CXXFLAGS defaults to -O2 -Wall -Wextra -Werror and can be set to
+# 			override it, as can CXX. A program's output is shown only when it fails. One line is
+# 			printed per build and per run:
+#
+# 			BUILD,<program>,<pass|fail>
+# 			RUN,<program>,<pass|fail>
+# 			END
+#
+# 			The exit status is 1 if anything failed to build or run. A new program under extras/ is
+# 			added to the list at the end of this script.
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-O2 -Wall -Wextra -Werror"}
+OUT=${TMPDIR:-/tmp}/ds1306all.$$
+FAILED=0
+
+mkdir -p "$OUT" || exit 1
+
+# Build a program, name then its extra flags, with the libraries to link in LIBS
+build() {
+	name=$1
+	shift
+	if $CXX $CXXFLAGS "$@" -I. -o "$OUT/$name" "extras/$name/$name.cpp" *.cpp $LIBS; then
+		echo "BUILD,$name,pass"
+		return 0
+	fi
+	echo "BUILD,$name,fail"
+	FAILED=1
+	return 1
+}
+
+# Run a command, printing its output only if it fails
+run() {
+	name=$1
+	shift
+	if "$@" > "$OUT/$name.log" 2>&1; then
+		echo "RUN,$name,pass"
+	else
+		cat "$OUT/$name.log"
+		echo "RUN,$name,fail"
+		FAILED=1
+	fi
+}
+
+# Build then run a program, name then its extra flags
+program() {
+	if build "$@"; then
+		run "$1" "$OUT/$1"
+	fi
+	LIBS=
+}
+
+program ds1306alarmtest
+program ds1306bcdbench
+program ds1306bench
+program ds1306epochbench
+program ds1306eventstest
+program ds1306hosttest
+program ds1306isobench
+LIBS=-lpthread
+program ds1306locktest -DDS1306_BUS_LOCK=1
+program ds1306probetest
+program ds1306recordstest
+program ds1306schedbench
+program ds1306spidevbench -DDS1306_BUS=DS1306_BUS_SPIDEV
+program ds1306stamptest
+program ds1306transactiontest
+program ds1306usercachetest
+run ds1306size sh extras/ds1306size/ds1306size.sh
+
+rm -rf "$OUT"
+echo "END"
+exit $FAILED
@@ -0,0 +1,312 @@
+/*
+ * File			ds1306bcdbench.cpp
+ *
+ * Synopsis		Exhaustive check and timing of DS1306BCD, and the time packet, against the division based codec
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306bcdbench extras/ds1306bcdbench/ds1306bcdbench.cpp *.cpp
+ *
+ * 			Every 8 bit input is encoded and decoded with both codecs and the results compared, and
+ * 			every value 0 - 99 is round tripped. DS1306::encodeTimePacket() and decodeTimePacket() are
+ * 			then compared with the packet code as it was before DS1306BCD, for a spread of times
+ * 			written in both hour forms, and a round trip of each (encode, then decode) is timed as a
+ * 			packet row. One line is printed per check, then one per benchmark:
+ *
+ * 			CHECK,<name>,<cases>,<mismatches>
+ * 			BENCH,<name>,<operations>,<ns per operation>,<checksum>
+ *
+ * 			The exit status is 1 if any check found a mismatch. Host CPUs divide in hardware, so the
+ * 			timings understate the gain on AVR, where division is a library call. The packet rows
+ * 			count one operation per round trip, the old packet code being kept out of line as the
+ * 			library's is, so that the two differ only in the codec. On a host the packet rows come out
+ * 			within noise of each other; any packet speedup is an AVR result.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306BCD.h"
+
+#if DS1306_HOURS != DS1306_HOURS_RUNTIME || !DS1306_DECODE_12
+#error "ds1306bcdbench needs the default DS1306_HOURS and DS1306_DECODE_12"
+#endif
+
+// Passes over the 256 inputs per benchmark
+#define BENCH_LOOPS		100000
+
+// Times in the packet set, and passes over it per benchmark
+#define PACKET_TIMES	1440
+#define PACKET_LOOPS	2000
+
+// Inputs, volatile so that the compiler cannot fold the conversions
+volatile unsigned char inputs[256];
+
+// Division based codec, as DS1306 shipped before DS1306BCD
+unsigned char oldEncode(unsigned char value)
+{
+	return (((value / 10) << 4) | (value % 10));
+}
+
+unsigned char oldDecode(unsigned char value)
+{
+	return ((((value & 0xF0) >> 4) * 10) + (value & 0x0F));
+}
+
+// Masked forms as DS1306 shipped them, passing DS1306_ANY through
+unsigned char oldEncodeMasked(unsigned char value, unsigned char mask)
+{
+	return ((value & DS1306_ANY) ? DS1306_ANY : oldEncode(value) & mask);
+}
+
+unsigned char oldDecodeMasked(unsigned char value, unsigned char mask)
+{
+	return ((value & DS1306_ANY) ? DS1306_ANY : oldDecode(value & mask));
+}
+
+// Time packet encode as DS1306 shipped it, out of line like the library's
+__attribute__((noinline)) void oldEncodePacket(unsigned char *buf, const ds1306time *time, bool hours24)
+{
+	buf[0] = oldEncodeMasked(time->seconds, 0x7F);
+	buf[1] = oldEncodeMasked(time->minutes, 0x7F);
+	if ((hours24 && (time->hours & DS1306_ANY)) || (!hours24 && (time->hours12 & DS1306_ANY))) {
+		buf[2] = DS1306_ANY;
+	} else if (hours24) {
+		buf[2] = oldEncodeMasked(time->hours, 0x3F);
+	} else {
+		buf[2] = oldEncodeMasked(time->hours12, 0x1F) | 0x40 | (time->ampm == 'P' ? 0x20 : 0x00);
+	}
+	buf[3] = oldEncodeMasked(time->dow, 0x07);
+	buf[4] = oldEncodeMasked(time->day, 0x3F);
+	buf[5] = oldEncodeMasked(time->month, 0x3F);
+	buf[6] = oldEncode(time->year);
+}
+
+// Time packet decode as DS1306 shipped it
+__attribute__((noinline)) void oldDecodePacket(const unsigned char *buf, ds1306time *time)
+{
+	time->seconds = oldDecodeMasked(buf[0], 0x7F);
+	time->minutes = oldDecodeMasked(buf[1], 0x7F);
+	if (buf[2] & DS1306_ANY) {
+		time->hours12 = DS1306_ANY;
+		time->hours = DS1306_ANY;
+		time->ampm = 0;
+	} else if (buf[2] & 0x40) {
+		time->hours12 = oldDecodeMasked(buf[2], 0x1F);
+		if (buf[2] & 0x20) {
+			time->hours = (time->hours12 == 12) ? 12 : 12 + time->hours12;
+			time->ampm = 'P';
+		} else {
+			time->hours = (time->hours12 == 12) ? 0 : time->hours12;
+			time->ampm = 'A';
+		}
+	} else {
+		time->hours = oldDecodeMasked(buf[2], 0x3F);
+		if (time->hours == 0) {
+			time->hours12 = 12;
+			time->ampm = 'A';
+		} else if (time->hours == 12) {
+			time->hours12 = 12;
+			time->ampm = 'P';
+		} else if (time->hours < 12) {
+			time->hours12 = time->hours;
+			time->ampm = 'A';
+		} else {
+			time->hours12 = time->hours - 12;
+			time->ampm = 'P';
+		}
+	}
+	time->dow = oldDecodeMasked(buf[3], 0x07);
+	time->day = oldDecodeMasked(buf[4], 0x3F);
+	time->month = oldDecodeMasked(buf[5], 0x3F);
+	time->year = oldDecode(buf[6]);
+}
+
+// The packet set, one time per minute of a day spread over the other fields
+ds1306time times[PACKET_TIMES];
+
+// Writers of each hour form, using the library's packet code
+DS1306 rtc24(true);
+DS1306 rtc12(false);
+
+// Nanoseconds from a monotonic clock
+unsigned long long nanos()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Compare a codec function against its reference over every 8 bit input, returns the mismatches
+unsigned int check(const char *name, unsigned char (*codec)(unsigned char), unsigned char (*reference)(unsigned char))
+{
+	unsigned int mismatches = 0;
+	for (unsigned int value = 0; value < 256; value++) {
+		if (codec(value) != reference(value)) mismatches++;
+	}
+	printf("CHECK,%s,256,%u\n", name, mismatches);
+	return mismatches;
+}
+
+// Encode then decode every value the registers hold, returns the mismatches
+unsigned int checkRoundTrip()
+{
+	unsigned int mismatches = 0;
+	for (unsigned char value = 0; value < 100; value++) {
+		unsigned char bcd = DS1306BCD::encode(value);
+		if ((bcd >> 4) > 9 || (bcd & 0x0F) > 9 || DS1306BCD::decode(bcd) != value) mismatches++;
+	}
+	printf("CHECK,round_trip,100,%u\n", mismatches);
+	return mismatches;
+}
+
+// Fill the packet set, every minute of the day with both hour forms filled in
+void fillTimes()
+{
+	for (unsigned int i = 0; i < PACKET_TIMES; i++) {
+		ds1306time *time = &times[i];
+		time->seconds = (i * 7) % 60;
+		time->minutes = i % 60;
+		time->hours = i / 60;
+		time->hours12 = (time->hours % 12) ? time->hours % 12 : 12;
+		time->ampm = (time->hours < 12) ? 'A' : 'P';
+		time->dow = 1 + i % 7;
+		time->day = 1 + i % 31;
+		time->month = 1 + i % 12;
+		time->year = i % 100;
+	}
+}
+
+// True if two decoded times match in every field
+bool sameTime(const ds1306time *a, const ds1306time *b)
+{
+	return a->seconds == b->seconds && a->minutes == b->minutes && a->hours == b->hours &&
+		a->hours12 == b->hours12 && a->ampm == b->ampm && a->dow == b->dow && a->day == b->day &&
+		a->month == b->month && a->year == b->year;
+}
+
+// Compare the library's packets with the old code's in one hour form, returns the mismatches
+unsigned int checkPacket(const char *name, DS1306 *rtc, bool hours24)
+{
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < PACKET_TIMES; i++) {
+		unsigned char buf[DS1306_SIZE_DATETIME], oldBuf[DS1306_SIZE_DATETIME];
+		ds1306time decoded, oldDecoded;
+		rtc->encodeTimePacket(buf, &times[i]);
+		oldEncodePacket(oldBuf, &times[i], hours24);
+		DS1306::decodeTimePacket(buf, &decoded);
+		oldDecodePacket(oldBuf, &oldDecoded);
+		bool same = true;
+		for (unsigned char j = 0; j < DS1306_SIZE_DATETIME; j++) {
+			if (buf[j] != oldBuf[j]) same = false;
+		}
+		if (!same || !sameTime(&decoded, &oldDecoded) || !sameTime(&decoded, &times[i])) mismatches++;
+	}
+	printf("CHECK,%s,%u,%u\n", name, PACKET_TIMES, mismatches);
+	return mismatches;
+}
+
+// Print a benchmark result line
+void report(const char *name, unsigned long operations, unsigned long long elapsed, unsigned long checksum)
+{
+	printf("BENCH,%s,%lu,%.2f,%lu\n", name, operations, (double) elapsed / operations, checksum);
+}
+
+// Sum of a decoded time's fields, for the checksum
+unsigned long sumTime(const ds1306time *time)
+{
+	return time->seconds + time->minutes + time->hours + time->hours12 + time->ampm + time->dow +
+		time->day + time->month + time->year;
+}
+
+// Round trip the packet set through the library in 24 hour form and print its result line
+void runPacket()
+{
+	unsigned long checksum = 0;
+	unsigned long long start = nanos();
+
+	for (unsigned int loop = 0; loop < PACKET_LOOPS; loop++) {
+		for (unsigned int i = 0; i < PACKET_TIMES; i++) {
+			unsigned char buf[DS1306_SIZE_DATETIME];
+			ds1306time decoded;
+			rtc24.encodeTimePacket(buf, &times[i]);
+			DS1306::decodeTimePacket(buf, &decoded);
+			checksum += sumTime(&decoded);
+		}
+	}
+
+	report("packet_round_trip", (unsigned long) PACKET_LOOPS * PACKET_TIMES, nanos() - start, checksum);
+}
+
+// The same round trips through the old packet code
+void runPacketDivision()
+{
+	unsigned long checksum = 0;
+	unsigned long long start = nanos();
+
+	for (unsigned int loop = 0; loop < PACKET_LOOPS; loop++) {
+		for (unsigned int i = 0; i < PACKET_TIMES; i++) {
+			unsigned char buf[DS1306_SIZE_DATETIME];
+			ds1306time decoded;
+			oldEncodePacket(buf, &times[i], true);
+			oldDecodePacket(buf, &decoded);
+			checksum += sumTime(&decoded);
+		}
+	}
+
+	report("packet_round_trip_division", (unsigned long) PACKET_LOOPS * PACKET_TIMES, nanos() - start, checksum);
+}
+
+// Run a codec over the inputs and print its result line
+void run(const char *name, unsigned char (*codec)(unsigned char))
+{
+	unsigned long checksum = 0;
+	unsigned long long start = nanos();
+
+	for (unsigned int loop = 0; loop < BENCH_LOOPS; loop++) {
+		for (unsigned int i = 0; i < 256; i++) {
+			checksum += codec(inputs[i]);
+		}
+	}
+
+	report(name, (unsigned long) BENCH_LOOPS * 256, nanos() - start, checksum);
+}
+
+int main()
+{
+	printf("# ds1306bcdbench\n");
+
+	unsigned int mismatches = 0;
+	mismatches += check("encode", DS1306BCD::encode, oldEncode);
+	mismatches += check("decode", DS1306BCD::decode, oldDecode);
+	mismatches += checkRoundTrip();
+	fillTimes();
+	mismatches += checkPacket("packet_24", &rtc24, true);
+	mismatches += checkPacket("packet_12", &rtc12, false);
+
+	// Encode inputs are binary values, decode inputs BCD values, as the registers hold
+	for (unsigned int i = 0; i < 256; i++) {
+		inputs[i] = i % 100;
+	}
+	run("encode", DS1306BCD::encode);
+	run("encode_division", oldEncode);
+
+	for (unsigned int i = 0; i < 256; i++) {
+		inputs[i] = DS1306BCD::encode(i % 100);
+	}
+	run("decode", DS1306BCD::decode);
+	run("decode_division", oldDecode);
+
+	runPacket();
+	runPacketDivision();
+
+	printf("END\n");
+	return mismatches ? 1 : 0;
+}
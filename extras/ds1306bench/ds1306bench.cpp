@@ -0,0 +1,352 @@
+/*
+ * File			ds1306bench.cpp
+ *
+ * Synopsis		Benchmark of the DS1306 packet codec and bus operations on the host
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306bench extras/ds1306bench/ds1306bench.cpp *.cpp
+ *
+ * 			Times the packet codec (time packets, hour bytes in 12 and 24 hour form, BCD) and the bus
+ * 			operations (time reads, user memory bulk transfers) against a DS1306Emulator, so that
+ * 			releases can be compared. Results are printed one per line, in a fixed format meant for
+ * 			scripts:
+ *
+ * 			BENCH,<name>,<iterations>,<elapsed us>,<ns per iteration>,<transactions>,<bytes>
+ *
+ * 			Transactions and bytes are bus totals for the benchmark, taken from the emulators, which
+ * 			count a transaction per chip select. Build with -DDS1306_STATS=1 to count bus setups (SPCR
+ * 			save / restore, SPI library transaction) from the library's instrumentation instead.
+ *
+ * 			The bus_time_<n> benchmarks read the time from n devices, each on its own emulator, in one
+ * 			DS1306Bus pass, and each_time_<n> with one getRawTime() per device. Their iterations are
+ * 			device reads, so ns per iteration is the cost per device as the chip count grows.
+ * 			bus_time_mixed_<n> alternates two clock dividers between the devices, so the bus is
+ * 			reconfigured between each of them. A DS1306Bus pass selects each chip just as often as
+ * 			separate reads do, saving only bus setups, so these rows show equal transactions unless
+ * 			built with DS1306_STATS; a comment line after the header says which count is shown.
+ * 			ns per iteration includes the loop and call overhead, which the "empty" benchmark
+ * 			measures on its own. Benchmark names are stable; new ones are only ever added.
+ * 			Benchmarks of an hour form compiled out by DS1306_HOURS are skipped, so the
+ * 			configurations of DS1306Config.h can be compared by building with each in turn
+ * 			(for example -DDS1306_HOURS=DS1306_HOURS_24). The run ends with a line reading END.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306BCD.h"
+#include "DS1306Bus.h"
+#include "DS1306Emulator.h"
+#include "DS1306RawTime.h"
+
+// Format version, printed in the header and bumped if a column ever changes meaning
+#define BENCH_FORMAT		1
+
+// Iterations per benchmark
+#define BENCH_CODEC_LOOPS	1000000
+#define BENCH_BUS_LOOPS		100000
+
+// One writer of each hour form, unless the form is fixed at compile time
+#if DS1306_HOURS == DS1306_HOURS_RUNTIME
+DS1306 clk24, clk12(false);
+#else
+DS1306 clk24, clk12;
+#endif
+#define BENCH_FORM24		(DS1306_HOURS != DS1306_HOURS_12)
+#define BENCH_FORM12		(DS1306_HOURS != DS1306_HOURS_24)
+
+DS1306Emulator emu;
+
+// Devices for the multiple device benchmarks, each on its own emulated chip
+DS1306 fleet[DS1306_MAX_DEVICES];
+DS1306Emulator fleetEmu[DS1306_MAX_DEVICES];
+DS1306Bus fleetBus[DS1306_MAX_DEVICES + 1];			// fleetBus[n] holds the first n devices
+DS1306RawTime fleetTimes[DS1306_MAX_DEVICES];
+unsigned char fleetCount;
+
+// Results are folded in here so the compiler cannot discard the work
+volatile unsigned char sink;
+
+// Sample data, prepared in main()
+#define BENCH_SAMPLES		8
+ds1306time samples[BENCH_SAMPLES];
+unsigned char packets24[BENCH_SAMPLES][DS1306_SIZE_DATETIME];
+unsigned char packets12[BENCH_SAMPLES][DS1306_SIZE_DATETIME];
+char userBuf[DS1306_USER_END - DS1306_USER_START + 1];
+
+// Nanoseconds from a monotonic clock
+unsigned long long nanos()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Bus totals so far, over every emulator
+// With DS1306_STATS set, transactions are bus setups counted by the library rather than chip selects
+void busCounters(unsigned long *transactions, unsigned long *bytes)
+{
+	*transactions = emu.getTransactionCount();
+	*bytes = emu.getByteCount();
+	for (unsigned char i = 0; i < DS1306_MAX_DEVICES; i++) {
+		*transactions += fleetEmu[i].getTransactionCount();
+		*bytes += fleetEmu[i].getByteCount();
+	}
+#if DS1306_STATS
+	ds1306stats stats;
+	clk24.getStatsTotal(&stats);
+	*transactions = stats.transactions;
+	clk12.getStatsTotal(&stats);
+	*transactions += stats.transactions;
+	for (unsigned char i = 0; i < DS1306_MAX_DEVICES; i++) {
+		fleet[i].getStatsTotal(&stats);
+		*transactions += stats.transactions;
+	}
+#endif
+}
+
+// Benchmark bodies, each called once per iteration with the iteration number
+void benchEmpty(unsigned int i)
+{
+	sink = i;
+}
+
+void benchBCDEncode(unsigned int i)
+{
+	sink = DS1306BCD::encode(i % 100);
+}
+
+void benchBCDDecode(unsigned int i)
+{
+	sink = DS1306BCD::decode(packets24[i % BENCH_SAMPLES][i % DS1306_SIZE_DATETIME]);
+}
+
+void benchHourEncode24(unsigned int i)
+{
+	const ds1306time *t = &samples[i % BENCH_SAMPLES];
+	sink = clk24.encodeHourByte(t->hours, t->hours12, t->ampm);
+}
+
+void benchHourEncode12(unsigned int i)
+{
+	const ds1306time *t = &samples[i % BENCH_SAMPLES];
+	sink = clk12.encodeHourByte(t->hours, t->hours12, t->ampm);
+}
+
+void benchHourDecode24(unsigned int i)
+{
+	unsigned char hour24, hour12;
+	char ampm;
+	DS1306::decodeHourByte(packets24[i % BENCH_SAMPLES][2], &hour24, &hour12, &ampm);
+	sink = hour24 ^ hour12 ^ ampm;
+}
+
+void benchHourDecode12(unsigned int i)
+{
+	unsigned char hour24, hour12;
+	char ampm;
+	DS1306::decodeHourByte(packets12[i % BENCH_SAMPLES][2], &hour24, &hour12, &ampm);
+	sink = hour24 ^ hour12 ^ ampm;
+}
+
+void benchTimeEncode24(unsigned int i)
+{
+	unsigned char buf[DS1306_SIZE_DATETIME];
+	clk24.encodeTimePacket(buf, &samples[i % BENCH_SAMPLES]);
+	sink = buf[2];
+}
+
+void benchTimeEncode12(unsigned int i)
+{
+	unsigned char buf[DS1306_SIZE_DATETIME];
+	clk12.encodeTimePacket(buf, &samples[i % BENCH_SAMPLES]);
+	sink = buf[2];
+}
+
+void benchTimeDecode24(unsigned int i)
+{
+	ds1306time t;
+	DS1306::decodeTimePacket(packets24[i % BENCH_SAMPLES], &t);
+	sink = t.hours;
+}
+
+void benchTimeDecode12(unsigned int i)
+{
+	ds1306time t;
+	DS1306::decodeTimePacket(packets12[i % BENCH_SAMPLES], &t);
+	sink = t.hours;
+}
+
+void benchGetTime(unsigned int)
+{
+	ds1306time t;
+	clk24.getTime(&t);
+	sink = t.seconds;
+}
+
+void benchSetTime(unsigned int i)
+{
+	clk24.setTime(&samples[i % BENCH_SAMPLES]);
+}
+
+void benchUserWrite8(unsigned int i)
+{
+	clk24.writeUser(DS1306_USER_START + (i % 12) * 8, userBuf, 8);
+}
+
+void benchUserRead8(unsigned int i)
+{
+	clk24.readUser(DS1306_USER_START + (i % 12) * 8, userBuf, 8);
+	sink = userBuf[0];
+}
+
+void benchUserWrite96(unsigned int)
+{
+	clk24.writeUser(DS1306_USER_START, userBuf, sizeof(userBuf));
+}
+
+void benchUserRead96(unsigned int)
+{
+	clk24.readUser(DS1306_USER_START, userBuf, sizeof(userBuf));
+	sink = userBuf[0];
+}
+
+// Multiple device bodies, each reading fleetCount devices
+void benchBusTime(unsigned int)
+{
+	fleetBus[fleetCount].getRawTimeAll(fleetTimes);
+	sink = fleetTimes[0].regs[0];
+}
+
+void benchEachTime(unsigned int)
+{
+	for (unsigned char d = 0; d < fleetCount; d++) {
+		fleet[d].getRawTime(&fleetTimes[d]);
+	}
+	sink = fleetTimes[0].regs[0];
+}
+
+// Run one benchmark and print its result line, each call of body counting as perCall iterations
+void run(const char *name, void (*body)(unsigned int), unsigned long iterations, unsigned char perCall = 1)
+{
+	unsigned long transactions, bytes;
+	busCounters(&transactions, &bytes);
+
+	unsigned long long start = nanos();
+	for (unsigned long i = 0; i < iterations / perCall; i++) {
+		body(i);
+	}
+	unsigned long long elapsed = nanos() - start;
+
+	unsigned long transactionsEnd, bytesEnd;
+	busCounters(&transactionsEnd, &bytesEnd);
+	iterations = (iterations / perCall) * perCall;
+	printf("BENCH,%s,%lu,%llu,%llu,%lu,%lu\n", name, iterations, elapsed / 1000, elapsed / iterations,
+		transactionsEnd - transactions, bytesEnd - bytes);
+}
+
+// Run the multiple device benchmarks over 1 to DS1306_MAX_DEVICES devices
+void runFleet()
+{
+	char name[32];
+
+	for (unsigned char n = 1; n <= DS1306_MAX_DEVICES; n++) {
+		fleetCount = n;
+		snprintf(name, sizeof(name), "bus_time_%u", n);
+		run(name, benchBusTime, BENCH_BUS_LOOPS, n);
+		snprintf(name, sizeof(name), "each_time_%u", n);
+		run(name, benchEachTime, BENCH_BUS_LOOPS, n);
+	}
+
+	// Alternate rates, so every device after the first reconfigures the bus
+	for (unsigned char d = 1; d < DS1306_MAX_DEVICES; d += 2) {
+		fleet[d].setClockDivider(DS1306_SPI_DIV8);
+	}
+	for (unsigned char n = 2; n <= DS1306_MAX_DEVICES; n++) {
+		fleetCount = n;
+		snprintf(name, sizeof(name), "bus_time_mixed_%u", n);
+		run(name, benchBusTime, BENCH_BUS_LOOPS, n);
+	}
+	for (unsigned char d = 1; d < DS1306_MAX_DEVICES; d += 2) {
+		fleet[d].setClockDivider(DS1306_SPI_DIVIDER);
+	}
+}
+
+int main()
+{
+	// Both RTC objects on the same emulated chip
+	clk24.attach(&emu);
+	clk12.attach(&emu);
+	clk24.init(0);
+	clk12.init(0);
+	clk24.setWriteProtection(false);
+	for (unsigned char d = 0; d < DS1306_MAX_DEVICES; d++) {
+		fleet[d].attach(&fleetEmu[d]);
+		fleet[d].init(d + 1);
+		for (unsigned char n = d + 1; n <= DS1306_MAX_DEVICES; n++) {
+			fleetBus[n].add(&fleet[d]);
+		}
+	}
+
+	// Sample times spread over the day, so both halves of the 12 hour form are covered
+	for (unsigned char i = 0; i < BENCH_SAMPLES; i++) {
+		ds1306time *t = &samples[i];
+		t->seconds = i * 7;
+		t->minutes = 59 - i * 3;
+		t->hours = i * 3 + 1;
+		t->hours12 = (t->hours % 12) ? (t->hours % 12) : 12;
+		t->ampm = (t->hours < 12) ? 'A' : 'P';
+		t->dow = (i % 7) + 1;
+		t->day = i * 3 + 1;
+		t->month = i + 1;
+		t->year = i * 11;
+		clk24.encodeTimePacket(packets24[i], t);
+		clk12.encodeTimePacket(packets12[i], t);
+	}
+	for (unsigned char i = 0; i < sizeof(userBuf); i++) {
+		userBuf[i] = i;
+	}
+
+	printf("# ds1306bench format %d\n", BENCH_FORMAT);
+	printf("# BENCH,name,iterations,elapsed_us,ns_per_iteration,transactions,bytes\n");
+#if DS1306_STATS
+	printf("# transactions are bus setups counted by DS1306_STATS\n");
+#else
+	printf("# transactions are chip selects, equal for bus_time_<n> and each_time_<n>; the bus setups\n");
+	printf("# DS1306Bus saves are counted only when built with -DDS1306_STATS=1\n");
+#endif
+
+	run("empty", benchEmpty, BENCH_CODEC_LOOPS);
+	run("bcd_encode", benchBCDEncode, BENCH_CODEC_LOOPS);
+	run("bcd_decode", benchBCDDecode, BENCH_CODEC_LOOPS);
+#if BENCH_FORM24
+	run("hour_encode_24", benchHourEncode24, BENCH_CODEC_LOOPS);
+	run("hour_decode_24", benchHourDecode24, BENCH_CODEC_LOOPS);
+	run("time_encode_24", benchTimeEncode24, BENCH_CODEC_LOOPS);
+	run("time_decode_24", benchTimeDecode24, BENCH_CODEC_LOOPS);
+#endif
+#if BENCH_FORM12
+	run("hour_encode_12", benchHourEncode12, BENCH_CODEC_LOOPS);
+	run("hour_decode_12", benchHourDecode12, BENCH_CODEC_LOOPS);
+	run("time_encode_12", benchTimeEncode12, BENCH_CODEC_LOOPS);
+	run("time_decode_12", benchTimeDecode12, BENCH_CODEC_LOOPS);
+#endif
+	run("get_time", benchGetTime, BENCH_BUS_LOOPS);
+	run("set_time", benchSetTime, BENCH_BUS_LOOPS);
+	run("user_write_8", benchUserWrite8, BENCH_BUS_LOOPS);
+	run("user_read_8", benchUserRead8, BENCH_BUS_LOOPS);
+	run("user_write_96", benchUserWrite96, BENCH_BUS_LOOPS);
+	run("user_read_96", benchUserRead96, BENCH_BUS_LOOPS);
+	runFleet();
+
+	printf("END\n");
+	return 0;
+}
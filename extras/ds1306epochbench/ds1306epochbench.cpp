@@ -0,0 +1,288 @@
+/*
+ * File			ds1306epochbench.cpp
+ *
+ * Synopsis		Exhaustive check and timing of the DS1306RawTime epoch conversions against a calendar loop
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306epochbench extras/ds1306epochbench/ds1306epochbench.cpp *.cpp
+ *
+ * 			getEpoch() and setEpoch() are checked against gmtime_r() on every day from 2000-01-01 to
+ * 			2099-12-31, at times of day either side of each hour, minute and day boundary, in both 12
+ * 			and 24 hour register forms, and on every second of the first day, 2000-02-29 and the last
+ * 			day. Run with the argument "full" to check every second of the century instead, which takes
+ * 			around a quarter of an hour. The calendar loop timed below is checked the same way.
+ *
+ * 			The benchmarks compare the library against the path it replaced: getTime() decoding every
+ * 			field, then a mktime style loop over years and months (and for setEpoch, 32 bit division
+ * 			and modulo to split the seconds, then encoding every field). One line is printed per check,
+ * 			then one per benchmark:
+ *
+ * 			CHECK,<name>,<cases>,<mismatches>
+ * 			BENCH,<name>,<operations>,<ns per operation>,<checksum>
+ * 			END
+ *
+ * 			The exit status is 1 if any check found a mismatch. Rows doing the same job print the same
+ * 			checksum.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306BCD.h"
+#include "DS1306RawTime.h"
+
+// Distinct times, and passes over them
+#define BENCH_TIMES		1024
+#define BENCH_LOOPS		2000
+
+// Seconds from 1970-01-01 to 2000-01-01, and days in the DS1306's century
+#define UNIX_2000		946684800UL
+#define CENTURY_DAYS	36525UL
+
+// Writers of each hour form, used only to encode packets
+DS1306 clk24, clk12(false);
+
+unsigned long epochs[BENCH_TIMES];
+DS1306RawTime raws[BENCH_TIMES];
+
+// Nanoseconds from a monotonic clock
+unsigned long long nanos()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Days in a month, every fourth year from 2000 being a leap year
+unsigned char monthDays(unsigned char month, unsigned char year)
+{
+	static const unsigned char days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	return (month == 2 && year % 4 == 0) ? 29 : days[month - 1];
+}
+
+// Seconds since 2000 from decoded fields, mktime style
+unsigned long calendarEpoch(const ds1306time *time)
+{
+	unsigned long days = 0;
+	for (unsigned char year = 0; year < time->year; year++) {
+		days += (year % 4 == 0) ? 366 : 365;
+	}
+	for (unsigned char month = 1; month < time->month; month++) {
+		days += monthDays(month, time->year);
+	}
+	days += time->day - 1;
+	return ((days * 24 + time->hours) * 60 + time->minutes) * 60 + time->seconds;
+}
+
+// Decoded fields from seconds since 2000, gmtime style
+void calendarTime(unsigned long epoch, ds1306time *time)
+{
+	unsigned long days = epoch / 86400;
+	unsigned long rem = epoch % 86400;
+
+	time->hours = rem / 3600;
+	time->minutes = rem / 60 % 60;
+	time->seconds = rem % 60;
+	time->hours12 = (time->hours % 12) ? (time->hours % 12) : 12;
+	time->ampm = (time->hours < 12) ? 'A' : 'P';
+	time->dow = (days + 6) % 7 + 1;
+
+	unsigned char year = 0;
+	while (days >= ((year % 4 == 0) ? 366U : 365U)) {
+		days -= (year % 4 == 0) ? 366 : 365;
+		year++;
+	}
+	unsigned char month = 1;
+	while (days >= monthDays(month, year)) {
+		days -= monthDays(month, year);
+		month++;
+	}
+	time->year = year;
+	time->month = month;
+	time->day = days + 1;
+}
+
+// Registers for a broken down UTC time, hours in 24 or 12 hour form
+void makeRegs(const struct tm *tm, bool hours24, DS1306RawTime *raw)
+{
+	raw->regs[0] = DS1306BCD::encode(tm->tm_sec);
+	raw->regs[1] = DS1306BCD::encode(tm->tm_min);
+	if (hours24) {
+		raw->regs[2] = DS1306BCD::encode(tm->tm_hour);
+	} else {
+		unsigned char hour12 = (tm->tm_hour % 12) ? (tm->tm_hour % 12) : 12;
+		raw->regs[2] = 0x40 | ((tm->tm_hour >= 12) ? 0x20 : 0) | DS1306BCD::encode(hour12);
+	}
+	raw->regs[3] = tm->tm_wday + 1;
+	raw->regs[4] = DS1306BCD::encode(tm->tm_mday);
+	raw->regs[5] = DS1306BCD::encode(tm->tm_mon + 1);
+	raw->regs[6] = DS1306BCD::encode(tm->tm_year - 100);
+}
+
+// True if registers hold the broken down time, in the given hour form
+bool sameTime(const DS1306RawTime *raw, const struct tm *tm, bool hours24)
+{
+	DS1306RawTime expected;
+	makeRegs(tm, hours24, &expected);
+	return !memcmp(raw->regs, expected.regs, DS1306_SIZE_DATETIME);
+}
+
+// Mismatch counts of each check
+struct checkCounts {
+	unsigned long cases;
+	unsigned long getEpoch;
+	unsigned long setEpoch;
+	unsigned long calendar;
+};
+
+// Check every conversion of one second, in both hour forms
+void checkSecond(unsigned long epoch, const struct tm *tm, checkCounts *counts)
+{
+	for (unsigned char form = 0; form < 2; form++) {
+		bool hours24 = form == 0;
+		DS1306RawTime raw;
+
+		makeRegs(tm, hours24, &raw);
+		if (raw.getEpoch() != epoch) counts->getEpoch++;
+
+		raw.setEpoch(epoch, hours24);
+		if (!sameTime(&raw, tm, hours24)) counts->setEpoch++;
+	}
+
+	ds1306time time;
+	calendarTime(epoch, &time);
+	if (time.year != tm->tm_year - 100 || time.month != tm->tm_mon + 1 || time.day != tm->tm_mday ||
+		time.hours != tm->tm_hour || time.minutes != tm->tm_min || time.seconds != tm->tm_sec ||
+		time.dow != tm->tm_wday + 1 || calendarEpoch(&time) != epoch) {
+		counts->calendar++;
+	}
+	counts->cases++;
+}
+
+// Check every second of one day, stepping the broken down time rather than calling gmtime_r each second
+void checkWholeDay(unsigned long day, checkCounts *counts)
+{
+	time_t utc = (time_t) (UNIX_2000 + day * 86400);
+	struct tm tm;
+	gmtime_r(&utc, &tm);
+
+	for (unsigned long second = 0; second < 86400; second++) {
+		tm.tm_hour = second / 3600;
+		tm.tm_min = second / 60 % 60;
+		tm.tm_sec = second % 60;
+		checkSecond(day * 86400 + second, &tm, counts);
+	}
+}
+
+// Check the conversions over the century, returns the mismatches
+unsigned long check(bool full)
+{
+	static const unsigned long times[] = { 0, 1, 59, 60, 3599, 3600, 43199, 43200, 46800, 86340, 86399 };
+	checkCounts counts;
+	memset(&counts, 0, sizeof(counts));
+
+	for (unsigned long day = 0; day < CENTURY_DAYS; day++) {
+		if (full || day == 0 || day == 59 || day == CENTURY_DAYS - 1) {
+			checkWholeDay(day, &counts);
+			continue;
+		}
+		for (unsigned char i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+			unsigned long epoch = day * 86400 + times[i];
+			time_t utc = (time_t) (UNIX_2000 + epoch);
+			struct tm tm;
+			gmtime_r(&utc, &tm);
+			checkSecond(epoch, &tm, &counts);
+		}
+	}
+
+	printf("CHECK,get_epoch,%lu,%lu\n", counts.cases * 2, counts.getEpoch);
+	printf("CHECK,set_epoch,%lu,%lu\n", counts.cases * 2, counts.setEpoch);
+	printf("CHECK,calendar,%lu,%lu\n", counts.cases, counts.calendar);
+
+	// The last second of the range, as documented
+	DS1306RawTime raw;
+	raw.setEpoch(DS1306_EPOCH_MAX);
+	unsigned long limit = (raw.getEpoch() == DS1306_EPOCH_MAX && raw.getYear() == 99 && raw.getMonth() == 12 &&
+		raw.getDay() == 31 && raw.getHours() == 23 && raw.getMinutes() == 59 && raw.getSeconds() == 59) ? 0 : 1;
+	printf("CHECK,epoch_max,1,%lu\n", limit);
+
+	return counts.getEpoch + counts.setEpoch + counts.calendar + limit;
+}
+
+// Benchmark bodies, each called once per operation with the time number, returning a checksum
+unsigned long benchGetEpoch(unsigned int i)
+{
+	return raws[i].getEpoch();
+}
+
+unsigned long benchGetEpochCalendar(unsigned int i)
+{
+	ds1306time time;
+	raws[i].decode(&time);
+	return calendarEpoch(&time);
+}
+
+unsigned long benchSetEpoch(unsigned int i)
+{
+	DS1306RawTime raw;
+	raw.setEpoch(epochs[i], i & 1);
+	return raw.regs[0] + raw.regs[2] + raw.regs[3] + raw.regs[4] + raw.regs[6];
+}
+
+unsigned long benchSetEpochCalendar(unsigned int i)
+{
+	DS1306RawTime raw;
+	ds1306time time;
+	calendarTime(epochs[i], &time);
+	((i & 1) ? clk24 : clk12).encodeTimePacket(raw.regs, &time);
+	return raw.regs[0] + raw.regs[2] + raw.regs[3] + raw.regs[4] + raw.regs[6];
+}
+
+// Run one benchmark and print its result line
+void run(const char *name, unsigned long (*body)(unsigned int))
+{
+	unsigned long checksum = 0;
+	unsigned long long start = nanos();
+
+	for (unsigned int loop = 0; loop < BENCH_LOOPS; loop++) {
+		for (unsigned int i = 0; i < BENCH_TIMES; i++) {
+			checksum += body(i);
+		}
+	}
+
+	unsigned long long elapsed = nanos() - start;
+	unsigned long operations = (unsigned long) BENCH_LOOPS * BENCH_TIMES;
+	printf("BENCH,%s,%lu,%.1f,%lu\n", name, operations, (double) elapsed / operations, checksum);
+}
+
+int main(int argc, char **argv)
+{
+	bool full = argc > 1 && !strcmp(argv[1], "full");
+
+	printf("# ds1306epochbench\n");
+	unsigned long mismatches = check(full);
+
+	// Times spread over the century, alternately in 24 and 12 hour register form
+	for (unsigned int i = 0; i < BENCH_TIMES; i++) {
+		epochs[i] = (unsigned long) i * 3078917UL;
+		raws[i].setEpoch(epochs[i], i & 1);
+	}
+
+	printf("# BENCH,name,operations,ns_per_operation,checksum\n");
+	run("get_epoch", benchGetEpoch);
+	run("get_epoch_calendar", benchGetEpochCalendar);
+	run("set_epoch", benchSetEpoch);
+	run("set_epoch_calendar", benchSetEpochCalendar);
+
+	printf("END\n");
+	return mismatches ? 1 : 0;
+}
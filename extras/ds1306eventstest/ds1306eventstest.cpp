@@ -0,0 +1,199 @@
+/*
+ * File			ds1306eventstest.cpp
+ *
+ * Synopsis		Host test of the DS1306Events ring buffer and flag clearing, against the emulator
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306eventstest extras/ds1306eventstest/ds1306eventstest.cpp *.cpp
+ *
+ * 			The ring buffer is filled to its DS1306_EVENT_QUEUE - 1 events and beyond, checking that
+ * 			the extra events are dropped and counted, then cycled past its end several times checking
+ * 			that events come out whole and in order. Alarms are then fired on DS1306Emulator and the
+ * 			handlers called while the emulator's INT lines are asserted; service() is checked to clear
+ * 			both flags in one transaction, one flag with the single alarm read, and repeated events of
+ * 			one alarm with one read, including the flag of an event dropped from a full buffer. One line
+ * 			is printed per check:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306Events.h"
+
+#if !DS1306_ALARMS
+#error "ds1306eventstest needs DS1306_ALARMS set to 1"
+#endif
+
+// Events the ring buffer holds
+#define QUEUE_EVENTS	(DS1306_EVENT_QUEUE - 1)
+
+DS1306Emulator emu;
+DS1306 rtc;
+
+// Microsecond source, advanced on every reading so that each event has its own stamp
+unsigned long now = 0;
+
+unsigned long testMicros()
+{
+	return ++now;
+}
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// Interrupt for an alarm, as the pin handler would make it
+void raise(DS1306Events *events, unsigned char alarm)
+{
+	if (alarm) {
+		events->onInt1();
+	} else {
+		events->onInt0();
+	}
+}
+
+// True if the oldest event is of the alarm and stamp given
+bool next(DS1306Events *events, unsigned char alarm, unsigned long microseconds)
+{
+	ds1306event event;
+	if (!events->getEvent(&event)) return false;
+	return event.alarm == alarm && event.microseconds == microseconds && event.epoch == 0;
+}
+
+// Filling, overflowing, draining and wrapping the ring buffer
+void checkRing()
+{
+	DS1306Events events(&rtc);
+	ds1306event event;
+
+	events.setMicrosSource(testMicros);
+	now = 0;
+	check("empty", events.available() == 0 && !events.getEvent(&event) && events.getOverflows() == 0);
+
+	for (unsigned char i = 0; i < QUEUE_EVENTS; i++) {
+		raise(&events, i & 1);
+	}
+	check("full", events.available() == QUEUE_EVENTS && events.getOverflows() == 0);
+
+	// Events beyond the last free slot are dropped, and the micros source is not read for them
+	raise(&events, 0);
+	raise(&events, 1);
+	check("overflow", events.available() == QUEUE_EVENTS && events.getOverflows() == 2 && now == QUEUE_EVENTS);
+
+	bool inOrder = true;
+	for (unsigned char i = 0; i < QUEUE_EVENTS; i++) {
+		if (!next(&events, i & 1, i + 1)) inOrder = false;
+	}
+	check("drain", inOrder && events.available() == 0 && !events.getEvent(&event));
+
+	events.resetOverflows();
+	check("reset_overflows", events.getOverflows() == 0);
+
+	// Push three, pop two, until head and tail have both passed the end of the buffer several times
+	unsigned long pushed = now, popped = now;
+	bool wrapped = true;
+	for (unsigned int round = 0; round < 4 * DS1306_EVENT_QUEUE; round++) {
+		for (unsigned char i = 0; i < 3 && events.available() < QUEUE_EVENTS; i++) {
+			raise(&events, ++pushed & 1);
+		}
+		for (unsigned char i = 0; i < 2; i++) {
+			popped++;
+			if (!next(&events, popped & 1, popped)) wrapped = false;
+		}
+	}
+	while (events.available()) {
+		popped++;
+		if (!next(&events, popped & 1, popped)) wrapped = false;
+	}
+	check("wrap", wrapped && popped == pushed && events.getOverflows() == 0);
+}
+
+// Flag clearing by service(), against alarms fired on the emulator
+void checkService()
+{
+	DS1306Events events(&rtc);
+	ds1306alarm any = { DS1306_ANY, DS1306_ANY, DS1306_ANY, DS1306_ANY, 0, DS1306_ANY };
+
+	rtc.setAlarm(0, &any);
+	rtc.setAlarm(1, &any);
+	rtc.enableBothAlarms();
+
+	// Both alarms fire, both handlers run, one burst read clears both flags
+	emu.tick();
+	check("fired", emu.getInt0() && emu.getInt1());
+	if (emu.getInt0()) events.onInt0();
+	if (emu.getInt1()) events.onInt1();
+	emu.resetCounters();
+	events.service();
+	check("clear_both", emu.getTransactionCount() == 1 && emu.getByteCount() == 3 &&
+		!(emu.peek(DS1306_SR) & ((1 << DS1306_SR_IRQF0) | (1 << DS1306_SR_IRQF1))) &&
+		!emu.getInt0() && !emu.getInt1());
+	check("both_events", events.available() == 2 && next(&events, 0, 0) && next(&events, 1, 0));
+
+	// Nothing pending, nothing on the bus
+	emu.resetCounters();
+	events.service();
+	check("clear_none", emu.getTransactionCount() == 0);
+
+	// Only alarm 1 serviced: its own single register read, alarm 0's flag left set
+	emu.tick();
+	events.onInt1();
+	emu.resetCounters();
+	events.service();
+	check("clear_alarm1", emu.getTransactionCount() == 1 && emu.getByteCount() == 2 && emu.getInt0() &&
+		!emu.getInt1());
+
+	// Repeated events of one alarm clear its flag once
+	events.onInt0();
+	events.onInt0();
+	events.onInt0();
+	emu.resetCounters();
+	events.service();
+	check("clear_batched", emu.getTransactionCount() == 1 && emu.getByteCount() == 2 && !emu.getInt0() &&
+		events.available() == 4);
+
+	// A full buffer still records the flag, so a dropped event's alarm is cleared too
+	while (events.available() < QUEUE_EVENTS) {
+		events.onInt0();
+	}
+	events.service();
+	emu.tick();
+	events.onInt1();
+	emu.resetCounters();
+	events.service();
+	check("clear_dropped", events.getOverflows() == 1 && emu.getTransactionCount() == 1 && !emu.getInt1() &&
+		emu.getInt0());
+
+	rtc.disableBothAlarms();
+}
+
+int main()
+{
+	rtc.attach(&emu);
+	rtc.init(0);
+	rtc.setWriteProtection(false);
+
+	checkRing();
+	checkService();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,563 @@
+/*
+ * File			ds1306hosttest.cpp
+ *
+ * Synopsis		The ds1306test checks, run on the host against DS1306Emulator
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306hosttest extras/ds1306hosttest/ds1306hosttest.cpp *.cpp
+ *
+ * 			Runs the test cases of examples/ds1306test, under the same names, with two DS1306 objects
+ * 			(24 and 12 hour writers) attached to one emulator. Where the sketch waits two seconds for
+ * 			an alarm, the emulator is ticked twice. The trickle charge cases run, as the emulator has
+ * 			no battery to damage. One line is printed per case, then the final result:
+ *
+ * 			RWC24.01 Read/Write/Compare Main Clock 24hr - Pass
+ * 			...
+ * 			Final result - Pass
+ *
+ * 			Give a run count as the only argument to repeat the suite that many times; only the first
+ * 			run is printed, followed by RUNS,<runs>,<runs per second>. The exit status is 1 if any case
+ * 			failed in any run. Needs the default configuration (runtime hour form, alarms and trickle
+ * 			charge compiled in).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+
+#if DS1306_HOURS != DS1306_HOURS_RUNTIME || !DS1306_ALARMS || !DS1306_TRICKLE
+#error "ds1306hosttest needs DS1306_HOURS_RUNTIME, DS1306_ALARMS and DS1306_TRICKLE"
+#endif
+
+// This test will test both the 24 and 12 hour write/read modes for the clock
+// using these two objects, on one emulated chip
+DS1306 clk24, clk12(false);
+DS1306Emulator emu;
+
+// Only the first run is printed
+bool verbose = true;
+
+// Print a case result (or any other text) when printing
+void say(const char *text)
+{
+	if (verbose) fputs(text, stdout);
+}
+
+// Convert a 12 hour + ampm to a 24 hour
+unsigned char convert_to_24(unsigned char hours12, char ampm)
+{
+	if (ampm == 'A') {
+		if (hours12 == 12) return 0;
+		return hours12;
+	} else if (ampm == 'P') {
+		if (hours12 == 12) return 12;
+		return hours12 + 12;
+	} else {
+		return 255;	// Error signal because of missing ampm
+	}
+}
+
+// Convert a 24 hour to a 12 hour format
+void convert_to_12(unsigned char hours24, unsigned char *hours12, char *ampm)
+{
+	if (hours24 == 0) {
+		*hours12 = 12;
+		*ampm = 'A';
+	} else if (hours24 == 12) {
+		*hours12 = 12;
+		*ampm = 'P';
+	} else if (hours24 < 12) {
+		*hours12 = hours24;
+		*ampm = 'A';
+	} else {
+		*hours12 = hours24 - 12;
+		*ampm = 'P';
+	}
+}
+
+// Compare two bytes, return true if the same, false otherwise.
+// Output error on false
+bool compare(unsigned char in, unsigned char out, const char *desc, bool *passflag, int aschar = false)
+{
+	if (in == out) return true;
+
+	if (*passflag) {
+		*passflag = false;
+		say("Fail\n");
+	}
+	if (verbose) {
+		if (aschar) {
+			printf("..Failure comparing %s - in=%c, out=%c\n", desc, in, out);
+		} else {
+			printf("..Failure comparing %s - in=%u, out=%u\n", desc, in, out);
+		}
+	}
+	return false;
+}
+
+// Print the name of a case
+void start(const char *tc, const char *desc)
+{
+	if (verbose) printf("%s %s - ", tc, desc);
+}
+
+// Print and return the result of a case without details
+bool result(bool pass)
+{
+	say(pass ? "Pass\n" : "Fail\n");
+	return pass;
+}
+
+// Routine to write and read the clock using 24 hour format
+// and check the two values against each other
+bool read_write_compare_clock24(const char *tc, unsigned char year, unsigned char month, unsigned char day, unsigned char hours, unsigned char mins, unsigned char secs, unsigned char dow)
+{
+	start(tc, "Read/Write/Compare Main Clock 24hr");
+
+	ds1306time ts_in, ts_out;
+	ts_in.year = year;
+	ts_in.month = month;
+	ts_in.day = day;
+	ts_in.dow = dow;
+	ts_in.hours = hours;
+	ts_in.minutes = mins;
+	ts_in.seconds = secs;
+
+	clk24.setTime(&ts_in);
+	clk24.getTime(&ts_out);
+
+	bool pass = true;
+
+	unsigned char hours12;
+	char ampm;
+
+	convert_to_12(ts_in.hours, &hours12, &ampm);
+
+	compare(ts_in.year, ts_out.year, "Year", &pass);
+	compare(ts_in.month, ts_out.month, "Month", &pass);
+	compare(ts_in.day, ts_out.day, "Day", &pass);
+	compare(ts_in.hours, ts_out.hours, "Hours", &pass);
+	compare(hours12, ts_out.hours12, "Hours (12)", &pass);
+	compare(ampm, ts_out.ampm, "AMPM Flag", &pass, true);
+	compare(ts_in.minutes, ts_out.minutes, "Minutes", &pass);
+	compare(ts_in.seconds, ts_out.seconds, "Seconds", &pass);
+	compare(ts_in.dow, ts_out.dow, "DOW", &pass);
+
+	if (pass) say("Pass\n");
+
+	return pass;
+}
+
+// Routine to write and read the clock using 12 hour format
+// and check the two values against each other
+bool read_write_compare_clock12(const char *tc, unsigned char year, unsigned char month, unsigned char day, unsigned char hours, char ampm, unsigned char mins, unsigned char secs, unsigned char dow)
+{
+	start(tc, "Read/Write/Compare Main Clock 12hr");
+
+	ds1306time ts_in, ts_out;
+	ts_in.year = year;
+	ts_in.month = month;
+	ts_in.day = day;
+	ts_in.dow = dow;
+	ts_in.hours12 = hours;
+	ts_in.ampm = ampm;
+	ts_in.minutes = mins;
+	ts_in.seconds = secs;
+
+	clk12.setTime(&ts_in);
+	clk12.getTime(&ts_out);
+
+	bool pass = true;
+
+	unsigned char hours24;
+
+	hours24 = convert_to_24(ts_in.hours12, ampm);
+
+	compare(ts_in.year, ts_out.year, "Year", &pass);
+	compare(ts_in.month, ts_out.month, "Month", &pass);
+	compare(ts_in.day, ts_out.day, "Day", &pass);
+	compare(ts_in.hours12, ts_out.hours12, "Hours", &pass);
+	compare(ts_in.ampm, ts_out.ampm, "AMPM Flag", &pass, true);
+	compare(hours24, ts_out.hours, "Hours (24)", &pass);
+	compare(ts_in.minutes, ts_out.minutes, "Minutes", &pass);
+	compare(ts_in.seconds, ts_out.seconds, "Seconds", &pass);
+	compare(ts_in.dow, ts_out.dow, "DOW", &pass);
+
+	if (pass) say("Pass\n");
+
+	return pass;
+}
+
+// Routine to write and read and alarm using 24 hour format
+// and check the two values against each other
+bool read_write_compare_alarm24(const char *tc, int alarm, unsigned char hours, unsigned char mins, unsigned char secs, unsigned char dow)
+{
+	start(tc, "Read/Write/Compare Alarm 24hr");
+
+	ds1306alarm ts_in, ts_out;
+	ts_in.dow = dow;
+	ts_in.hours = hours;
+	ts_in.minutes = mins;
+	ts_in.seconds = secs;
+
+	clk24.setAlarm(alarm, &ts_in);
+	clk24.getAlarm(alarm, &ts_out);
+
+	bool pass = true;
+
+	unsigned char hours12;
+	char ampm;
+
+	convert_to_12(ts_in.hours, &hours12, &ampm);
+
+	compare(ts_in.hours, ts_out.hours, "Hours", &pass);
+	if (ts_in.hours != DS1306_ANY) compare(hours12, ts_out.hours12, "Hours (12)", &pass);
+	if (ts_in.hours != DS1306_ANY) compare(ampm, ts_out.ampm, "AMPM Flag", &pass, true);
+	compare(ts_in.minutes, ts_out.minutes, "Minutes", &pass);
+	compare(ts_in.seconds, ts_out.seconds, "Seconds", &pass);
+	compare(ts_in.dow, ts_out.dow, "DOW", &pass);
+
+	if (pass) say("Pass\n");
+
+	return pass;
+}
+
+// Routine to write and read and alarm using 12 hour format
+// and check the two values against each other
+bool read_write_compare_alarm12(const char *tc, int alarm, unsigned char hours, char ampm, unsigned char mins, unsigned char secs, unsigned char dow)
+{
+	start(tc, "Read/Write/Compare Alarm 12hr");
+
+	ds1306alarm ts_in, ts_out;
+	ts_in.dow = dow;
+	ts_in.hours12 = hours;
+	ts_in.ampm = ampm;
+	ts_in.minutes = mins;
+	ts_in.seconds = secs;
+
+	clk12.setAlarm(alarm, &ts_in);
+	clk12.getAlarm(alarm, &ts_out);
+
+	bool pass = true;
+
+	unsigned char hours24;
+
+	hours24 = convert_to_24(ts_in.hours12, ampm);
+	compare(ts_in.hours12, ts_out.hours12, "Hours", &pass);
+	if (ts_in.hours12 != DS1306_ANY) compare(ts_in.ampm, ts_out.ampm, "AM PM Flag", &pass);
+	if (ts_in.hours12 != DS1306_ANY) compare(hours24, ts_out.hours, "Hours (24)", &pass);
+	compare(ts_in.minutes, ts_out.minutes, "Minutes", &pass);
+	compare(ts_in.seconds, ts_out.seconds, "Seconds", &pass);
+	compare(ts_in.dow, ts_out.dow, "DOW", &pass);
+
+	if (pass) say("Pass\n");
+
+	return pass;
+}
+
+// Validate that the two alarms do not match each other
+bool check_alarm_diff(const char *tc)
+{
+	ds1306alarm a0, a1;
+
+	start(tc, "Compare alarms are different");
+	clk24.getAlarm(0, &a0);
+	clk24.getAlarm(1, &a1);
+
+	return result(!(a0.hours == a1.hours &&
+		a0.minutes == a1.minutes &&
+		a0.seconds == a1.seconds &&
+		a0.dow == a1.dow));
+}
+
+// Run tests related to the primary clock
+int clocktests()
+{
+	int failures = 0;
+	// RWC24 series tests
+	// Write clock (24 hour mode), Read clock, compare written timestamp with read timestamp
+
+	// RWC24.01 - Lower bound (lowest supportable values)
+	if (!read_write_compare_clock24("RWC24.01", 0, 1, 1, 0, 0, 0, DS1306_SUNDAY)) failures++;
+
+	// RWC24.02 - Upper bound (maximum supportable values)
+	if (!read_write_compare_clock24("RWC24.02", 99, 12, 31, 23, 59, 59, DS1306_SATURDAY)) failures++;
+
+	// RWC24.03 - Check operation of 12th hour for PM decode, unique values for ALL fields
+	if (!read_write_compare_clock24("RWC24.03", 1, 2, 3, 12, 4, 5, DS1306_SATURDAY)) failures++;
+
+	// RWC12 series tests
+	// Write clock (12 hour mode), Read clock, compare written timestamp with read timestamp
+
+	// RWC12.01 - Lower bound (lowest supportable values)
+	if (!read_write_compare_clock12("RWC12.01", 0, 1, 1, 0, 'A', 0, 0, DS1306_SUNDAY)) failures++;
+
+	// RWC12.02 - Upper bound (maximum supportable values)
+	if (!read_write_compare_clock12("RWC12.02", 99, 12, 31, 11, 'P', 59, 59, DS1306_SATURDAY)) failures++;
+
+	// RWC12.03 - Check operation of 12th hour for PM decode, unique values for ALL fields
+	if (!read_write_compare_clock12("RWC12.03", 1, 2, 3, 9, 'P', 4, 5, DS1306_SATURDAY)) failures++;
+
+	return failures;
+}
+
+// Run tests related to primary alarm setting / retrieval
+int alarmtests1()
+{
+	int failures = 0;
+	// ALM24 series tests
+	// Write alarm (1 or 2), Read back, compare written and read values
+
+	// ALM24.01 - Lower bound (lowest supportable values)
+	if (!read_write_compare_alarm24("ALM24.01", 0, 0, 0, 0, DS1306_SUNDAY)) failures++;
+
+	// ALM24.02 - Upper bound (highest supportable values)
+	if (!read_write_compare_alarm24("ALM24.02", 0, 23, 59, 59, DS1306_SATURDAY)) failures++;
+
+	// ALM24.03 - Check operation of 12th hour for PM decode, unique values for ALL fields
+	if (!read_write_compare_alarm24("ALM24.03", 0, 12, 2, 3, DS1306_FRIDAY)) failures++;
+
+	// Repeat previous 3 tests for second alarm (alarm 1)
+	if (!read_write_compare_alarm24("ALM24.11", 1, 0, 0, 0, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm24("ALM24.12", 1, 23, 59, 59, DS1306_SATURDAY)) failures++;
+	if (!read_write_compare_alarm24("ALM24.13", 1, 12, 2, 3, DS1306_FRIDAY)) failures++;
+
+	// Do some testing of the ANY indicator in all fields, alternating alarm 1 and alarm 2
+	// to ensure that both alarms end up on different values for a further test
+	if (!read_write_compare_alarm24("ALM24.21", 0, DS1306_ANY, 1, 2, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm24("ALM24.22", 1, 1, DS1306_ANY, 2, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm24("ALM24.24", 0, 1, 2, DS1306_ANY, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm24("ALM24.23", 1, 1, 2, 3, DS1306_ANY)) failures++;
+
+	// ALM12 series tests
+	// Write alarm (1 or 2), Read back, compare written and read values
+
+	// ALM12.01 - Lower bound (lowest supportable values)
+	if (!read_write_compare_alarm12("ALM12.01", 0, 12, 'A', 0, 0, DS1306_SUNDAY)) failures++;
+
+	// ALM12.02 - Upper bound (highest supportable values)
+	if (!read_write_compare_alarm12("ALM12.02", 0, 11, 'P', 59, 59, DS1306_SATURDAY)) failures++;
+
+	// ALM12.03 - Check operation of 12th hour for PM decode, unique values for ALL fields
+	if (!read_write_compare_alarm12("ALM12.03", 0, 12, 'P', 2, 3, DS1306_FRIDAY)) failures++;
+
+	// Repeat previous 3 tests for second alarm (alarm 1)
+	if (!read_write_compare_alarm12("ALM12.11", 1, 0, 'A', 0, 0, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm12("ALM12.12", 1, 11, 'P', 59, 59, DS1306_SATURDAY)) failures++;
+	if (!read_write_compare_alarm12("ALM12.13", 1, 12, 'A', 2, 3, DS1306_FRIDAY)) failures++;
+
+	// Do some testing of the ANY indicator in all fields, alternating alarm 1 and alarm 2
+	// to ensure that both alarms end up on different values for a further test
+	if (!read_write_compare_alarm12("ALM12.21", 0, DS1306_ANY, '\0', 1, 2, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm12("ALM12.22", 1, 1, 'P', DS1306_ANY, 2, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm12("ALM12.24", 0, 1, 'A', 2, DS1306_ANY, DS1306_SUNDAY)) failures++;
+	if (!read_write_compare_alarm12("ALM12.23", 1, 1, 'P', 2, 3, DS1306_ANY)) failures++;
+
+	// Make sure that the alarms are set differently
+	if (!check_alarm_diff("ALMXX.01")) failures++;
+
+	return failures;
+}
+
+// Run tests related to alarm enable / disable / state and triggering
+int runalarmtests2(int alarmnumber, const char *prefix)
+{
+	int failures = 0;
+	char tc[16];
+
+	// Start off by setting alarm as on
+	snprintf(tc, sizeof(tc), "%s.01", prefix);
+	start(tc, "Set alarm to enabled");
+	clk24.enableAlarm(alarmnumber);
+	if (!result(clk24.getAlarmEnabled(alarmnumber))) failures++;
+
+	// Now set alarm as off
+	snprintf(tc, sizeof(tc), "%s.02", prefix);
+	start(tc, "Set alarm to disabled");
+	clk24.disableAlarm(alarmnumber);
+	if (!result(!clk24.getAlarmEnabled(alarmnumber))) failures++;
+
+	snprintf(tc, sizeof(tc), "%s.03", prefix);
+	start(tc, "Trigger alarm");
+	ds1306alarm a;
+	a.dow = DS1306_ANY;
+	a.hours = DS1306_ANY;
+	a.minutes = DS1306_ANY;
+	a.seconds = DS1306_ANY;
+
+	clk24.clearAlarmState(alarmnumber);
+	if (clk24.getAlarmState(alarmnumber)) {
+		say("Fail\n..Alarm did not clear\n");
+		failures++;
+	} else {
+		clk24.setAlarm(alarmnumber, &a);
+		emu.tick();
+		emu.tick();
+		if (!clk24.getAlarmState(alarmnumber)) {
+			say("Fail\n..Alarm did not trigger\n");
+			failures++;
+		} else {
+			say("Pass\n");
+		}
+	}
+	clk24.disableAlarm(alarmnumber);
+
+	return failures;
+}
+
+// Run functional alarm tests
+int alarmtests2()
+{
+	int failures = 0;
+
+	// Unlike the sketch, alarm 1 is tested too, as the emulator raises IRQF1 without a backup supply
+	failures += runalarmtests2(0, "AL0FN");
+	failures += runalarmtests2(1, "AL1FN");
+	return failures;
+}
+
+// Write a pattern to user memory, read it back and compare
+bool read_write_compare_user(const char *tc, const char *desc, const char *outbuf)
+{
+	char inbuf[96];
+
+	start(tc, desc);
+	memset(inbuf, 0, sizeof(inbuf));
+
+	clk24.writeUser(DS1306_USER_START, outbuf, 96);
+	clk24.readUser(DS1306_USER_START, inbuf, 96);
+
+	for (int i = 0; i < 96; i++) {
+		if (inbuf[i] != outbuf[i]) {
+			say("Fail\n");
+			if (verbose) printf("..Offset = 0x%X\n", i);
+			return false;
+		}
+	}
+	return result(true);
+}
+
+// Run user memory tests
+int usermemtests()
+{
+	int failures = 0;
+	char outbuf[96];
+	int i;
+
+	// Write an obvious test pattern into buf
+	for (i = 0; i < 96; i++) {
+		outbuf[i] = i;
+	}
+	if (!read_write_compare_user("USMEM.01", "Read/Write Sequential Pattern", outbuf)) failures++;
+
+	// Write a (pseudo) random value test pattern into buf
+	for (i = 0; i < 96; i++) {
+		outbuf[i] = rand() % 0x100;
+	}
+	if (!read_write_compare_user("USMEM.02", "Read/Write Random Pattern", outbuf)) failures++;
+
+	return failures;
+}
+
+// Run control register tests
+int crtests()
+{
+	int failures = 0;
+
+	start("CRRWP.01", "Write Protect Clock");
+	clk24.setWriteProtection(true);
+	if (!result(clk24.isWriteProtected())) failures++;
+
+	start("CRRWP.02", "Write Unprotect Clock");
+	clk24.setWriteProtection(false);
+	if (!result(!clk24.isWriteProtected())) failures++;
+
+	start("TCREN.01", "Enable Trickle Charge");
+	clk24.enableTrickleCharge(2, 8);
+	unsigned char diodes;
+	unsigned char resistance;
+	bool en = clk24.getTrickleChargeState(&diodes, &resistance);
+	if (!result(diodes == 2 && resistance == 8 && en)) {
+		if (verbose) printf("..Got %u diodes, resistance %u, %s\n", diodes, resistance, en ? "enabled" : "disabled");
+		failures++;
+	}
+
+	start("TCREN.02", "Disable Trickle Charge");
+	clk24.disableTrickleCharge();
+	en = clk24.getTrickleChargeState(&diodes, &resistance);
+	if (!result(diodes == 0 && resistance == 0 && !en)) {
+		if (verbose) printf("..Got %u diodes, resistance %u, %s\n", diodes, resistance, en ? "enabled" : "disabled");
+		failures++;
+	}
+
+	start("TCREN.03", "Enable 1KHZ Signal");
+	clk24.set1HzState(true);
+	if (!result(clk24.get1HzState())) failures++;
+
+	start("TCREN.04", "Disable 1KHZ Signal");
+	clk24.set1HzState(false);
+	if (!result(!clk24.get1HzState())) failures++;
+
+	return failures;
+}
+
+// Run every test once, returns the number of failures
+int runtests()
+{
+	int failures = 0;
+
+	failures += clocktests();
+	failures += alarmtests1();
+	failures += alarmtests2();
+	failures += usermemtests();
+	failures += crtests();
+	return failures;
+}
+
+// Nanoseconds from a monotonic clock
+unsigned long long nanos()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long runs = (argc > 1) ? strtoul(argv[1], 0, 10) : 1;
+	if (runs < 1) runs = 1;
+
+	clk24.attach(&emu);
+	clk12.attach(&emu);
+	clk12.init(0);
+	clk24.init(0);
+
+	printf("Test starting\n");
+	int failures = runtests();
+	printf("\nFinal result - %s\n", failures ? "Fail" : "Pass");
+	if (failures) printf("%d total failures\n", failures);
+
+	if (runs > 1) {
+		verbose = false;
+		unsigned long long start = nanos();
+		for (unsigned long run = 1; run < runs; run++) {
+			failures += runtests();
+		}
+		unsigned long long elapsed = nanos() - start;
+		printf("RUNS,%lu,%.0f\n", runs, (runs - 1) * 1e9 / (elapsed ? elapsed : 1));
+		if (failures) printf("%d total failures over all runs\n", failures);
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * File			ds1306isobench.cpp
+ *
+ * Synopsis		Throughput of DS1306Iso against snprintf / sscanf on the host
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306isobench extras/ds1306isobench/ds1306isobench.cpp *.cpp
+ *
+ * 			Each benchmark formats or parses BENCH_TIMES different times, BENCH_LOOPS times over, and
+ * 			one line is printed per benchmark:
+ *
+ * 			BENCH,<name>,<operations>,<ns per operation>,<checksum>
+ *
+ * 			The printf rows decode the registers first, as a sketch printing getTime() fields would.
+ * 			The checksum only keeps the work from being optimized away; rows doing the same job agree.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306RawTime.h"
+#include "DS1306Iso.h"
+
+// Distinct times, and passes over them
+#define BENCH_TIMES		1024
+#define BENCH_LOOPS		1000
+
+DS1306RawTime raws[BENCH_TIMES];
+ds1306time times[BENCH_TIMES];
+char texts[BENCH_TIMES][DS1306_ISO_SIZE];
+
+// Nanoseconds from a monotonic clock
+unsigned long long nanos()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Sum of the characters of a formatted time
+unsigned long sum(const char *buf)
+{
+	unsigned long total = 0;
+	while (*buf) total += (unsigned char) *buf++;
+	return total;
+}
+
+// Benchmark bodies, each called once per operation with the time number, returning a checksum
+unsigned long benchFormatRaw(unsigned int i)
+{
+	char buf[DS1306_ISO_SIZE];
+	DS1306Iso::format(buf, &raws[i]);
+	return sum(buf);
+}
+
+unsigned long benchFormatTime(unsigned int i)
+{
+	char buf[DS1306_ISO_SIZE];
+	DS1306Iso::format(buf, &times[i]);
+	return sum(buf);
+}
+
+unsigned long benchFormatSnprintf(unsigned int i)
+{
+	char buf[32];
+	ds1306time time;
+	raws[i].decode(&time);
+	snprintf(buf, sizeof(buf), "20%02u-%02u-%02uT%02u:%02u:%02u", time.year, time.month, time.day,
+		time.hours, time.minutes, time.seconds);
+	return sum(buf);
+}
+
+unsigned long benchFormat12Raw(unsigned int i)
+{
+	char buf[DS1306_ISO_SIZE_12];
+	DS1306Iso::format12(buf, &raws[i]);
+	return sum(buf);
+}
+
+unsigned long benchFormat12Snprintf(unsigned int i)
+{
+	char buf[32];
+	ds1306time time;
+	raws[i].decode(&time);
+	snprintf(buf, sizeof(buf), "20%02u-%02u-%02u %02u:%02u:%02u %cM", time.year, time.month, time.day,
+		time.hours12, time.minutes, time.seconds, time.ampm);
+	return sum(buf);
+}
+
+unsigned long benchParse(unsigned int i)
+{
+	ds1306time time;
+	DS1306Iso::parse(texts[i], &time);
+	return time.year + time.month + time.day + time.hours + time.minutes + time.seconds;
+}
+
+unsigned long benchParseSscanf(unsigned int i)
+{
+	unsigned int year, month, day, hours, minutes, seconds;
+	sscanf(texts[i], "%4u-%2u-%2uT%2u:%2u:%2u", &year, &month, &day, &hours, &minutes, &seconds);
+	return year - 2000 + month + day + hours + minutes + seconds;
+}
+
+// Run one benchmark and print its result line
+void run(const char *name, unsigned long (*body)(unsigned int))
+{
+	unsigned long checksum = 0;
+	unsigned long long start = nanos();
+
+	for (unsigned int loop = 0; loop < BENCH_LOOPS; loop++) {
+		for (unsigned int i = 0; i < BENCH_TIMES; i++) {
+			checksum += body(i);
+		}
+	}
+
+	unsigned long long elapsed = nanos() - start;
+	unsigned long operations = (unsigned long) BENCH_LOOPS * BENCH_TIMES;
+	printf("BENCH,%s,%lu,%.1f,%lu\n", name, operations, (double) elapsed / operations, checksum);
+}
+
+int main()
+{
+	// Times spread over the century, every fourth held in 12 hour register form
+	for (unsigned int i = 0; i < BENCH_TIMES; i++) {
+		raws[i].setEpoch((unsigned long) i * 3078917UL, i & 3);
+		raws[i].decode(&times[i]);
+		DS1306Iso::format(texts[i], &raws[i]);
+	}
+
+	printf("# ds1306isobench\n");
+	printf("# BENCH,name,operations,ns_per_operation,checksum\n");
+
+	run("format_raw", benchFormatRaw);
+	run("format_time", benchFormatTime);
+	run("format_snprintf", benchFormatSnprintf);
+	run("format12_raw", benchFormat12Raw);
+	run("format12_snprintf", benchFormat12Snprintf);
+	run("parse", benchParse);
+	run("parse_sscanf", benchParseSscanf);
+
+	printf("END\n");
+	return 0;
+}
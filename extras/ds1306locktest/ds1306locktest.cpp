@@ -0,0 +1,214 @@
+/*
+ * File			ds1306locktest.cpp
+ *
+ * Synopsis		Threaded test of the DS1306 bus lock and deferred request queue on the host
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -DDS1306_BUS_LOCK=1 -I. -o ds1306locktest extras/ds1306locktest/ds1306locktest.cpp \
+ * 				*.cpp -lpthread
+ *
+ * 			Threads stand in for interrupt handlers and the main loop, all sharing one emulated bus:
+ * 			two "interrupt" threads write and read back user memory with requestWrite() /
+ * 			requestRead(), three "loop" threads do the same with write() / read(), and one more
+ * 			reads across two devices through a DS1306Bus. A request that finds the bus taken is
+ * 			queued and run by whichever thread releases it, so the read back only matches the
+ * 			write if the queue keeps each requester's order and no transaction interleaves with
+ * 			another. One line is printed per check, then a summary:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			QUEUE,<requests refused with the queue full>,<completions run by another thread>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed. Building with -fsanitize=thread also checks the
+ * 			host atomics. On a single core the threads rarely collide, so the QUEUE counts may be low.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include "DS1306.h"
+#include "DS1306Bus.h"
+#include "DS1306Emulator.h"
+
+#if !DS1306_BUS_LOCK
+#error "ds1306locktest needs DS1306_BUS_LOCK set to 1"
+#endif
+
+// Iterations per thread
+#define TEST_LOOPS		200000
+
+// Threads of each kind, all released together
+#define TEST_ISRS		2
+#define TEST_LOOPERS	3
+#define TEST_THREADS	(TEST_ISRS + TEST_LOOPERS + 1)
+
+DS1306Emulator emu;
+DS1306 rtcA, rtcB;
+
+std::atomic<int> started(0);
+std::atomic<long> mismatches(0);
+std::atomic<long> refused(0);
+std::atomic<long> foreign(0);
+std::atomic<long> loopOps(0);
+
+// Per interrupt thread state, its buffers must stay valid until the read completes
+struct isrState {
+	int id;
+	DS1306 *rtc;
+	unsigned char written[6];
+	unsigned char readBack[6];
+	std::atomic<long> completed;
+};
+isrState isrs[TEST_ISRS];
+
+// Thread identity, to count completions run by a thread other than the requester
+thread_local int threadId = -1;
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// Hold each thread until all have started, so they contend from the first iteration
+void startTogether()
+{
+	started++;
+	while (started.load() < TEST_THREADS) {
+	}
+}
+
+// Completion of an interrupt thread's read
+void readDone(void *context)
+{
+	isrState *s = (isrState *) context;
+	if (threadId != s->id) foreign++;
+	if (memcmp(s->written, s->readBack, sizeof(s->written))) mismatches++;
+	s->completed++;
+}
+
+// Counts calls into an int
+void countCall(void *context)
+{
+	(*(int *) context)++;
+}
+
+// Interrupt handler stand-in, requests a write and a read back then waits outside the request
+void *isrThread(void *arg)
+{
+	isrState *s = (isrState *) arg;
+	unsigned char address = DS1306_USER_START + s->id * 8;
+	threadId = s->id;
+	startTogether();
+
+	for (long i = 0; i < TEST_LOOPS; i++) {
+		for (int j = 0; j < 6; j++) {
+			s->written[j] = (unsigned char) (i * 7 + j + s->id * 100);
+		}
+		while (!s->rtc->requestWrite(address, s->written, 6)) refused++;
+		while (!s->rtc->requestRead(address, s->readBack, 6, readDone, s)) refused++;
+		while (s->completed.load() <= i) {
+		}
+	}
+	return 0;
+}
+
+// Main loop stand-in, synchronous write and read back
+void *loopThread(void *arg)
+{
+	long id = (long) arg;
+	DS1306 *rtc = (id & 1) ? &rtcB : &rtcA;
+	unsigned char address = DS1306_USER_START + 0x20 + id * 12;
+	unsigned char written[12], readBack[12];
+	startTogether();
+
+	for (long i = 0; i < TEST_LOOPS; i++) {
+		for (int j = 0; j < 12; j++) {
+			written[j] = (unsigned char) (i + j * 3 + id);
+		}
+		rtc->write(address, written, 12);
+		rtc->read(address, readBack, 12);
+		if (memcmp(written, readBack, 12)) mismatches++;
+		loopOps++;
+	}
+	return 0;
+}
+
+// DS1306Bus user, holding the bus across both devices
+void *busThread(void *)
+{
+	DS1306Bus bus;
+	unsigned char data[2 * 16];
+	bus.add(&rtcA);
+	bus.add(&rtcB);
+	startTogether();
+
+	for (long i = 0; i < TEST_LOOPS / 4; i++) {
+		bus.read(DS1306_USER_END - 15, data, 16);
+	}
+	return 0;
+}
+
+int main()
+{
+	rtcA.attach(&emu);
+	rtcB.attach(&emu);
+	rtcA.init(1);
+	rtcB.init(2);
+	rtcA.setWriteProtection(false);
+
+	// With the bus free a request runs at once, before it returns
+	unsigned char values[3] = {1, 2, 3}, readBack[3];
+	int calls = 0;
+	check("idle_unlocked", !DS1306::isBusLocked());
+	check("idle_write", rtcA.requestWrite(DS1306_USER_START, values, 3, countCall, &calls) && calls == 1 &&
+		emu.peek(DS1306_USER_START + 2) == 3);
+	check("idle_read", rtcA.requestRead(DS1306_USER_START, readBack, 3, countCall, &calls) && calls == 2 &&
+		!memcmp(values, readBack, 3));
+
+	// Threads standing in for interrupt handlers and the main loop
+	pthread_t threads[TEST_THREADS];
+	for (int i = 0; i < TEST_ISRS; i++) {
+		isrs[i].id = i;
+		isrs[i].rtc = i ? &rtcB : &rtcA;
+		isrs[i].completed = 0;
+		pthread_create(&threads[i], 0, isrThread, &isrs[i]);
+	}
+	for (long i = 0; i < TEST_LOOPERS; i++) {
+		pthread_create(&threads[TEST_ISRS + i], 0, loopThread, (void *) i);
+	}
+	pthread_create(&threads[TEST_THREADS - 1], 0, busThread, 0);
+	for (int i = 0; i < TEST_THREADS; i++) {
+		pthread_join(threads[i], 0);
+	}
+
+	bool allCompleted = true;
+	for (int i = 0; i < TEST_ISRS; i++) {
+		if (isrs[i].completed.load() != TEST_LOOPS) allCompleted = false;
+	}
+	check("read_back", mismatches.load() == 0);
+	check("requests_completed", allCompleted);
+	check("loop_completed", loopOps.load() == (long) TEST_LOOPERS * TEST_LOOPS);
+	check("released", !DS1306::isBusLocked());
+
+	// The queue is empty again, so a request on the free bus still runs at once
+	calls = 0;
+	check("drained", rtcB.requestRead(DS1306_USER_START, readBack, 3, countCall, &calls) && calls == 1);
+
+	printf("QUEUE,%ld,%ld\n", refused.load(), foreign.load());
+	printf("END\n");
+	return failures ? 1 : 0;
+}
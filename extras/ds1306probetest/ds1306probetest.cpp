@@ -0,0 +1,209 @@
+/*
+ * File			ds1306probetest.cpp
+ *
+ * Synopsis		Host test of SPI clock rate negotiation against the emulator's rate dependent errors
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306probetest extras/ds1306probetest/ds1306probetest.cpp *.cpp
+ *
+ * 			DS1306Emulator::setFastestDivider() makes the emulated chip return corrupted data above a
+ * 			given clock rate. For every such limit DS1306ClockProbe::negotiate() must settle on exactly
+ * 			that rate, which then reads cleanly while the next faster one does not. Range limits,
+ * 			failure (no rate works, write protection on), re-validation from poll() and two devices
+ * 			with different limits sharing a DS1306Bus are checked too. One line is printed per check:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "DS1306.h"
+#include "DS1306Bus.h"
+#include "DS1306ClockProbe.h"
+#include "DS1306Emulator.h"
+
+DS1306Emulator emu, emuB;
+DS1306 rtc, rtcB;
+
+// Millisecond source for poll()
+unsigned long now = 0;
+
+unsigned long testMillis()
+{
+	return now;
+}
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// Read errors seen by an emulator over a time write and read back at the device's current rate
+unsigned long timeErrors(DS1306 *device, DS1306Emulator *chip)
+{
+	ds1306time in, out;
+	in.seconds = 12;
+	in.minutes = 34;
+	in.hours = 21;
+	in.hours12 = 9;
+	in.ampm = 'P';
+	in.dow = DS1306_TUESDAY;
+	in.day = 28;
+	in.month = 2;
+	in.year = 24;
+
+	chip->resetCounters();
+	device->setTime(&in);
+	device->getTime(&out);
+	if (out.hours != in.hours || out.day != in.day || out.year != in.year) return chip->getErrorCount() + 1;
+	return chip->getErrorCount();
+}
+
+// Negotiate against every limit the emulator can be given
+void checkLimits()
+{
+	char name[40];
+	DS1306ClockProbe probe(&rtc);
+
+	for (unsigned int limit = DS1306_SPI_DIV2; limit <= DS1306_SPI_DIV128; limit <<= 1) {
+		emu.setFastestDivider(limit);
+		unsigned char divider = probe.negotiate();
+
+		snprintf(name, sizeof(name), "negotiate_%u", limit);
+		check(name, divider == limit && rtc.getClockDivider() == limit && probe.validate());
+
+		snprintf(name, sizeof(name), "clean_%u", limit);
+		check(name, timeErrors(&rtc, &emu) == 0);
+
+		if (limit > DS1306_SPI_DIV2) {
+			rtc.setClockDivider(limit >> 1);
+			snprintf(name, sizeof(name), "too_fast_%u", limit >> 1);
+			check(name, timeErrors(&rtc, &emu) > 0 && !probe.validate());
+		}
+	}
+
+	// No limit, the fastest rate works
+	emu.setFastestDivider(0);
+	check("negotiate_unlimited", probe.negotiate() == DS1306_SPI_DIV2);
+}
+
+// Range limits and failure
+void checkRanges()
+{
+	DS1306ClockProbe probe(&rtc);
+
+	emu.setFastestDivider(DS1306_SPI_DIV4);
+	check("range_start", probe.negotiate(DS1306_SPI_DIV8, DS1306_SPI_DIV32) == DS1306_SPI_DIV8);
+
+	emu.setFastestDivider(DS1306_SPI_DIV64);
+	check("range_none", probe.negotiate(DS1306_SPI_DIV2, DS1306_SPI_DIV32) == 0 &&
+		rtc.getClockDivider() == DS1306_SPI_DIV32);
+
+	// Slower than any divider, nothing validates and the slowest is kept
+	emu.setFastestDivider(0xFF);
+	check("none_works", probe.negotiate() == 0 && rtc.getClockDivider() == DS1306_SPI_DIV128);
+
+	// The pattern cannot be written while protected
+	emu.setFastestDivider(0);
+	rtc.setWriteProtection(true);
+	check("write_protected", probe.negotiate() == 0);
+	rtc.setWriteProtection(false);
+	check("unprotected", probe.negotiate() == DS1306_SPI_DIV2);
+}
+
+// Re-validation from poll(), negotiating again only once the interval has passed and the check fails
+void checkPoll()
+{
+	DS1306ClockProbe probe(&rtc);
+	probe.setMillisSource(testMillis);
+
+	now = 0;
+	emu.setFastestDivider(DS1306_SPI_DIV8);
+	probe.negotiate();
+	probe.setInterval(1000);
+
+	// The supply drops, the chip now needs a slower clock
+	emu.setFastestDivider(DS1306_SPI_DIV32);
+	now = 500;
+	probe.poll();
+	check("poll_early", probe.getNegotiationCount() == 1 && rtc.getClockDivider() == DS1306_SPI_DIV8);
+
+	now = 1500;
+	probe.poll();
+	check("poll_renegotiate", probe.getNegotiationCount() == 2 && rtc.getClockDivider() == DS1306_SPI_DIV32);
+
+	now = 2600;
+	probe.poll();
+	check("poll_still_good", probe.getNegotiationCount() == 2 && rtc.getClockDivider() == DS1306_SPI_DIV32);
+}
+
+// Two devices negotiated to different rates, then driven together through a DS1306Bus
+void checkBus()
+{
+	DS1306ClockProbe probe(&rtc), probeB(&rtcB);
+	DS1306Bus bus;
+	bus.add(&rtc);
+	bus.add(&rtcB);
+
+	emu.setFastestDivider(DS1306_SPI_DIV2);
+	emuB.setFastestDivider(DS1306_SPI_DIV16);
+	check("bus_negotiate", probe.negotiate() == DS1306_SPI_DIV2 && probeB.negotiate() == DS1306_SPI_DIV16);
+
+	unsigned char pattern[8] = {0x55, 0xAA, 0x33, 0xCC, 0x0F, 0xF0, 0x96, 0x69};
+	unsigned char readBack[2 * 8];
+	emu.resetCounters();
+	emuB.resetCounters();
+	bus.write(DS1306_USER_START, pattern, 8);
+	bus.read(DS1306_USER_START, readBack, 8);
+	check("bus_user", !memcmp(pattern, readBack, 8) && !memcmp(pattern, &readBack[8], 8) &&
+		emu.getErrorCount() == 0 && emuB.getErrorCount() == 0);
+
+	ds1306time times[2];
+	long skew[2];
+	bus.setEpochAll(12345678UL);
+	bus.getTimeAll(times);
+	bus.getSkew(skew);
+	check("bus_time", times[0].hours == times[1].hours && skew[1] == 0 &&
+		emu.getErrorCount() == 0 && emuB.getErrorCount() == 0);
+
+	// Either device first, the bus is reconfigured for the slower one and back
+	DS1306Bus reversed;
+	reversed.add(&rtcB);
+	reversed.add(&rtc);
+	reversed.read(DS1306_USER_START, readBack, 8);
+	check("bus_reversed", !memcmp(pattern, readBack, 8) && !memcmp(pattern, &readBack[8], 8) &&
+		emu.getErrorCount() == 0 && emuB.getErrorCount() == 0);
+}
+
+int main()
+{
+	rtc.attach(&emu);
+	rtcB.attach(&emuB);
+	rtc.init(1);
+	rtcB.init(2);
+	rtc.setWriteProtection(false);
+	rtcB.setWriteProtection(false);
+
+	checkLimits();
+	checkRanges();
+	checkPoll();
+	checkBus();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
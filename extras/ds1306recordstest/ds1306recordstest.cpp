@@ -0,0 +1,188 @@
+/*
+ * File			ds1306recordstest.cpp
+ *
+ * Synopsis		Host test of the DS1306Records layout checker, CRC and bus use, against the emulator
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306recordstest extras/ds1306recordstest/ds1306recordstest.cpp *.cpp
+ *
+ * 			checkLayout() is given layouts at and beyond each of its limits, and crc8() the standard
+ * 			check string. A store is then formatted on DS1306Emulator, and the emulator's transaction
+ * 			count checked for each operation: one for format(), begin(), a read and a write, none for
+ * 			a lookup of the loaded index. Records are read back, a write is checked to touch only its
+ * 			own record, and bytes of the index, a record's length and a payload are corrupted on the
+ * 			chip to check that each is detected. One line is printed per check:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306Records.h"
+
+// Record ids of the test layout
+#define ID_CONFIG		1
+#define ID_NAME			2
+#define ID_COUNTER		3
+
+DS1306Emulator emu;
+DS1306 rtc;
+
+const ds1306slot layout[] = {
+	{ ID_CONFIG, 8, false },
+	{ ID_NAME, 20, true },
+	{ ID_COUNTER, 4, false },
+};
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// Address of a record's slot header in the test layout
+unsigned char slotAddress(unsigned char slot)
+{
+	unsigned char address = DS1306_USER_START + DS1306_RECORD_INDEX_HEADER + 3 * DS1306_RECORD_INDEX_ENTRY;
+	for (unsigned char i = 0; i < slot; i++) {
+		address += DS1306_RECORD_SLOT_HEADER + layout[i].capacity;
+	}
+	return address;
+}
+
+// The layout limits, without a chip
+void checkLayouts()
+{
+	ds1306slot slots[DS1306_RECORD_MAX_SLOTS + 1];
+	for (unsigned char i = 0; i <= DS1306_RECORD_MAX_SLOTS; i++) {
+		slots[i].id = i;
+		slots[i].capacity = 1;
+		slots[i].variable = false;
+	}
+
+	check("layout_valid", DS1306Records::checkLayout(layout, 3));
+	check("layout_empty", !DS1306Records::checkLayout(slots, 0));
+	check("layout_max_slots", DS1306Records::checkLayout(slots, DS1306_RECORD_MAX_SLOTS));
+	check("layout_too_many", !DS1306Records::checkLayout(slots, DS1306_RECORD_MAX_SLOTS + 1));
+
+	slots[1].id = slots[0].id;
+	check("layout_duplicate", !DS1306Records::checkLayout(slots, 2));
+	slots[1].id = 1;
+
+	slots[0].capacity = 0;
+	check("layout_zero", !DS1306Records::checkLayout(slots, 1));
+	slots[0].capacity = DS1306_RECORD_VARIABLE;
+	check("layout_capacity", !DS1306Records::checkLayout(slots, 1));
+
+	// One slot fills user memory exactly: index header, one entry, slot header, payload
+	unsigned char fit = (DS1306_USER_END - DS1306_USER_START + 1) - DS1306_RECORD_INDEX_HEADER -
+		DS1306_RECORD_INDEX_ENTRY - DS1306_RECORD_SLOT_HEADER;
+	slots[0].capacity = fit;
+	check("layout_exact_fit", DS1306Records::checkLayout(slots, 1));
+	slots[0].capacity = fit + 1;
+	check("layout_overflow", !DS1306Records::checkLayout(slots, 1));
+
+	// CRC-8/MAXIM of "123456789"
+	check("crc8", DS1306Records::crc8(0, (const unsigned char *) "123456789", 9) == 0xA1);
+}
+
+// Transactions per operation, round trips and corruption
+void checkStore()
+{
+	DS1306Records records(&rtc), loaded(&rtc);
+	char name[20];
+	unsigned char config[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	unsigned char counter[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
+	unsigned char buf[20];
+
+	emu.resetCounters();
+	check("format_rejects", !records.format(layout, 0) && emu.getTransactionCount() == 0);
+	check("format", records.format(layout, 3) && emu.getTransactionCount() == 1);
+
+	emu.resetCounters();
+	check("begin", loaded.begin() && loaded.getSlotCount() == 3 && emu.getTransactionCount() == 1);
+	check("lookup", loaded.getCapacity(ID_NAME) == 20 && loaded.getCapacity(9) == DS1306_RECORD_NOT_FOUND &&
+		emu.getTransactionCount() == 1);
+	check("empty_record", loaded.read(ID_NAME, buf, sizeof(buf)) == 0 && emu.getTransactionCount() == 2);
+
+	emu.resetCounters();
+	check("write", loaded.write(ID_CONFIG, config, 8) && emu.getTransactionCount() == 1);
+	emu.resetCounters();
+	check("read", loaded.read(ID_CONFIG, buf, sizeof(buf)) == 8 && !memcmp(buf, config, 8) &&
+		emu.getTransactionCount() == 1);
+
+	// Fixed slots take exactly their capacity, variable ones up to it
+	emu.resetCounters();
+	check("write_fixed_length", !loaded.write(ID_CONFIG, config, 7) && !loaded.write(ID_NAME, name, 21) &&
+		!loaded.write(9, config, 1) && emu.getTransactionCount() == 0);
+
+	// A write touches only its own record
+	loaded.write(ID_COUNTER, counter, 4);
+	unsigned char before[DS1306_USER_END - DS1306_USER_START + 1];
+	for (unsigned char i = 0; i < sizeof(before); i++) {
+		before[i] = emu.peek(DS1306_USER_START + i);
+	}
+	strcpy(name, "DS1306");
+	emu.resetCounters();
+	check("write_variable", loaded.write(ID_NAME, name, 6) && emu.getTransactionCount() == 1);
+	bool confined = true;
+	unsigned char low = slotAddress(1) - DS1306_USER_START;
+	unsigned char high = low + DS1306_RECORD_SLOT_HEADER + 6;
+	for (unsigned char i = 0; i < sizeof(before); i++) {
+		if ((i < low || i >= high) && emu.peek(DS1306_USER_START + i) != before[i]) confined = false;
+	}
+	check("write_confined", confined);
+	check("read_variable", loaded.read(ID_NAME, buf, sizeof(buf)) == 6 && !memcmp(buf, name, 6) &&
+		loaded.read(ID_COUNTER, buf, 4) == 4 && !memcmp(buf, counter, 4));
+	check("read_too_small", loaded.read(ID_NAME, buf, 5) == DS1306_RECORD_TOO_SMALL);
+	check("read_not_found", loaded.read(9, buf, sizeof(buf)) == DS1306_RECORD_NOT_FOUND);
+
+	// A corrupted payload byte, then a length beyond capacity
+	unsigned char payload = slotAddress(2) + DS1306_RECORD_SLOT_HEADER + 1;
+	emu.poke(payload, emu.peek(payload) ^ 0x10);
+	check("corrupt_payload", loaded.read(ID_COUNTER, buf, 4) == DS1306_RECORD_CRC_ERROR);
+	emu.poke(payload, emu.peek(payload) ^ 0x10);
+	check("repaired_payload", loaded.read(ID_COUNTER, buf, 4) == 4);
+
+	unsigned char length = slotAddress(1);
+	emu.poke(length, 21);
+	check("corrupt_length", loaded.read(ID_NAME, buf, sizeof(buf)) == DS1306_RECORD_CRC_ERROR);
+	emu.poke(length, 5);
+	check("corrupt_short", loaded.read(ID_NAME, buf, sizeof(buf)) == DS1306_RECORD_CRC_ERROR);
+
+	// A corrupted index entry fails the index CRC
+	unsigned char entry = DS1306_USER_START + DS1306_RECORD_INDEX_HEADER + 1;
+	emu.poke(entry, emu.peek(entry) + 1);
+	DS1306Records corrupt(&rtc);
+	check("corrupt_index", !corrupt.begin() && corrupt.getSlotCount() == 0 &&
+		corrupt.read(ID_CONFIG, buf, sizeof(buf)) == DS1306_RECORD_NOT_FOUND);
+}
+
+int main()
+{
+	rtc.attach(&emu);
+	rtc.init(0);
+	rtc.setWriteProtection(false);
+
+	checkLayouts();
+	checkStore();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
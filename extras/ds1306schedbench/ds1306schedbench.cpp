@@ -0,0 +1,198 @@
+/*
+ * File			ds1306schedbench.cpp
+ *
+ * Synopsis		Host benchmark and check of DS1306Scheduler with thousands of entries on the emulator
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306schedbench extras/ds1306schedbench/ds1306schedbench.cpp *.cpp
+ *
+ * 			For each scheduler size, up to DS1306_SCHEDULE_MAX, the scheduler is filled with tasks
+ * 			firing once a minute or once an hour at random seconds, then the emulated clock is run for
+ * 			TEST_SECONDS, calling service() only in the seconds the hardware alarm flag is raised, as a
+ * 			host sleeping until the INT line would. Every task is then cancelled in random order.
+ * 			Result lines use the ds1306bench format, timing one add(), one task run by service() and
+ * 			one cancel(), with the bus traffic counted by the emulator:
+ *
+ * 			BENCH,name,iterations,elapsed_us,ns_per_iteration,transactions,bytes
+ *
+ * 			Each size is also checked: the nearest deadline after filling, add() refusing once full,
+ * 			the number of task runs against the matches of every pattern over the run, and the count
+ * 			and hardware alarm after cancelling. One line is printed per check, then END:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306Scheduler.h"
+
+#if !DS1306_ALARMS
+#error "ds1306schedbench needs DS1306_ALARMS set to 1"
+#endif
+
+// Seconds of emulated time run with the scheduler full, and the time it starts from
+#define TEST_SECONDS	600
+#define TEST_START		780000000UL
+
+DS1306Emulator emu;
+DS1306 rtc;
+
+ds1306schedule entries[DS1306_SCHEDULE_MAX];
+ds1306alarm patterns[DS1306_SCHEDULE_MAX];
+unsigned int handles[DS1306_SCHEDULE_MAX];
+
+unsigned long runs = 0;
+int failures = 0;
+
+// Nanoseconds from a monotonic clock
+unsigned long long nanos()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// Print a result line, counters are the emulator's since the last resetCounters()
+void bench(const char *name, unsigned long iterations, unsigned long long elapsed)
+{
+	printf("BENCH,%s,%lu,%llu,%llu,%lu,%lu\n", name, iterations, elapsed / 1000,
+		iterations ? elapsed / iterations : 0, emu.getTransactionCount(), emu.getByteCount());
+	emu.resetCounters();
+}
+
+// Task body, counts its runs
+void countRun(unsigned int, void *)
+{
+	runs++;
+}
+
+// Matches of a pattern in the seconds after start, up to and including end
+unsigned long matches(const ds1306alarm *pattern, unsigned long start, unsigned long end)
+{
+	unsigned long count = 0;
+	for (unsigned long fire = DS1306Scheduler::nextFire(pattern, start); fire <= end;
+		fire = DS1306Scheduler::nextFire(pattern, fire)) {
+		count++;
+	}
+	return count;
+}
+
+// Fill, run and empty a scheduler of the given size
+void runSize(unsigned int size)
+{
+	char name[40];
+	DS1306Scheduler scheduler(&rtc, entries, size);
+
+	rtc.setEpoch(TEST_START);
+	scheduler.begin();
+	srand(size);
+
+	// A quarter of the tasks hourly, the rest every minute, all at random seconds
+	for (unsigned int i = 0; i < size; i++) {
+		ds1306alarm pattern = { (unsigned char) (rand() % 60), DS1306_ANY, DS1306_ANY, 0, 0, DS1306_ANY };
+		if (i % 4 == 0) pattern.minutes = rand() % 60;
+		patterns[i] = pattern;
+	}
+
+	emu.resetCounters();
+	unsigned long long start = nanos();
+	for (unsigned int i = 0; i < size; i++) {
+		handles[i] = scheduler.add(&patterns[i], countRun);
+	}
+	snprintf(name, sizeof(name), "add_%u", size);
+	bench(name, size, nanos() - start);
+
+	unsigned long nearest = DS1306_SCHEDULE_NEVER;
+	bool added = true;
+	for (unsigned int i = 0; i < size; i++) {
+		unsigned long fire = DS1306Scheduler::nextFire(&patterns[i], TEST_START);
+		if (fire < nearest) nearest = fire;
+		if (!handles[i]) added = false;
+	}
+	snprintf(name, sizeof(name), "filled_%u", size);
+	check(name, added && scheduler.getCount() == size && scheduler.getNext() == nearest &&
+		!scheduler.add(&patterns[0], countRun));
+	emu.resetCounters();
+
+	// Sleep until the alarm flag rises, then service
+	unsigned long long busy = 0;
+	unsigned long services = 0;
+	runs = 0;
+	for (unsigned int second = 0; second < TEST_SECONDS; second++) {
+		emu.tick();
+		if (!(emu.peek(DS1306_SR) & 1)) continue;
+
+		start = nanos();
+		scheduler.service();
+		busy += nanos() - start;
+		services++;
+	}
+	snprintf(name, sizeof(name), "service_%u", size);
+	bench(name, runs, busy);
+
+	unsigned long expected = 0;
+	for (unsigned int i = 0; i < size; i++) {
+		expected += matches(&patterns[i], TEST_START, TEST_START + TEST_SECONDS);
+	}
+	snprintf(name, sizeof(name), "runs_%u", size);
+	check(name, runs == expected && services > 0);
+	emu.resetCounters();
+
+	// Cancel in random order
+	for (unsigned int i = size - 1; i > 0; i--) {
+		unsigned int j = rand() % (i + 1);
+		unsigned int handle = handles[i];
+		handles[i] = handles[j];
+		handles[j] = handle;
+	}
+	bool cancelled = true;
+	start = nanos();
+	for (unsigned int i = 0; i < size; i++) {
+		if (!scheduler.cancel(handles[i])) cancelled = false;
+	}
+	snprintf(name, sizeof(name), "cancel_%u", size);
+	bench(name, size, nanos() - start);
+
+	snprintf(name, sizeof(name), "empty_%u", size);
+	check(name, cancelled && scheduler.getCount() == 0 && scheduler.getNext() == DS1306_SCHEDULE_NEVER &&
+		!scheduler.cancel(handles[0]) && !(emu.peek(DS1306_CR) & 1));
+}
+
+int main()
+{
+	static const unsigned int sizes[] = { 1000, 4000, 16000, DS1306_SCHEDULE_MAX };
+
+	rtc.attach(&emu);
+	rtc.init(0);
+	rtc.setWriteProtection(false);
+
+	printf("# ds1306schedbench\n");
+	printf("# BENCH,name,iterations,elapsed_us,ns_per_iteration,transactions,bytes\n");
+	for (unsigned char i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		runSize(sizes[i]);
+	}
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# File			ds1306size.sh
+#
+# Synopsis		Code size of DS1306.cpp in each DS1306Config.h configuration
+#
+# Author		Chris Bearman
+#
+# Version		1.0
+#
+# License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+# 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+#
+# Instructions
+# 			A host script, not a sketch. From the library directory run
+#
+# 			sh extras/ds1306size/ds1306size.sh
+#
+# 			DS1306.cpp is compiled with g++ -Os for every configuration in the size table of
+# 			DS1306Config.h, and the text size reported by size(1) is printed with the bytes saved
+# 			against the default (negative when the option adds code). The Code and Saved columns of
+# 			the table are taken from this output. One line is printed per configuration:
+#
+# 			SIZE,<configuration>,<text>,<saved>
+#
+# 			DS1306_STATS 0 must compile to exactly the default object, as the instrumentation claims
+# 			to cost nothing when disabled; the text, data and bss of the two are compared, then:
+#
+# 			CHECK,stats_off,<pass|fail>
+# 			END
+#
+# 			The exit status is 1 if the check failed or a configuration did not build. Set CXX or SIZE
+# 			to use another compiler or size tool.
+
+CXX=${CXX:-g++}
+SIZE=${SIZE:-size}
+OBJ=${TMPDIR:-/tmp}/ds1306size.$$.o
+FAILED=0
+DEFAULT=
+
+# Sizes of DS1306.cpp built with the given flags: text, then text data bss
+measure() {
+	if ! $CXX -Os -std=gnu++11 -c -I. "$@" -o "$OBJ" DS1306.cpp; then
+		return 1
+	fi
+	$SIZE "$OBJ" | awk 'NR == 2 { print $1, $1 "/" $2 "/" $3 }'
+}
+
+# Print one configuration's line, name then flags
+report() {
+	name=$1
+	LAST=
+	shift
+	set -- $(measure "$@") || true
+	if [ -z "$1" ]; then
+		echo "SIZE,$name,fail,-"
+		FAILED=1
+		return
+	fi
+	if [ -z "$DEFAULT" ]; then
+		DEFAULT=$1
+		echo "SIZE,$name,$1,-"
+	else
+		echo "SIZE,$name,$1,$((DEFAULT - $1))"
+	fi
+	LAST=$2
+}
+
+report "Default"
+DEFAULT_ALL=$LAST
+report "DS1306_HOURS_24" -DDS1306_HOURS=DS1306_HOURS_24
+report "DS1306_HOURS_12" -DDS1306_HOURS=DS1306_HOURS_12
+report "DS1306_HOURS_24 DS1306_DECODE_12 0" -DDS1306_HOURS=DS1306_HOURS_24 -DDS1306_DECODE_12=0
+report "DS1306_ALARMS 0" -DDS1306_ALARMS=0
+report "DS1306_TRICKLE 0" -DDS1306_TRICKLE=0
+report "All of the above (24 hour)" -DDS1306_HOURS=DS1306_HOURS_24 -DDS1306_DECODE_12=0 -DDS1306_ALARMS=0 \
+	-DDS1306_TRICKLE=0
+report "DS1306_STATS 1" -DDS1306_STATS=1
+report "DS1306_STATS 0" -DDS1306_STATS=0
+
+if [ -n "$DEFAULT_ALL" ] && [ "$LAST" = "$DEFAULT_ALL" ]; then
+	echo "CHECK,stats_off,pass"
+else
+	echo "CHECK,stats_off,fail"
+	FAILED=1
+fi
+
+rm -f "$OBJ"
+echo "END"
+exit $FAILED
@@ -0,0 +1,174 @@
+/*
+ * File			ds1306spidevbench.cpp
+ *
+ * Synopsis		System calls per operation of the DS1306 Linux spidev backend
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A Linux program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -DDS1306_BUS=DS1306_BUS_SPIDEV -I. -o ds1306spidevbench \
+ * 				extras/ds1306spidevbench/ds1306spidevbench.cpp *.cpp
+ *
+ * 			Run without arguments to count against a DS1306Emulator attached in place of the device,
+ * 			or give a spidev device (for example /dev/spidev0.0) to run against a DS1306, whose user
+ * 			memory is overwritten. Each operation is run unbatched and inside beginBatch() / endBatch(),
+ * 			and one line is printed per run:
+ *
+ * 			BENCH,<name>,<operations>,<messages>,<messages per operation>,<elapsed us>
+ *
+ * 			Every message is one SPI_IOC_MESSAGE ioctl, so messages per operation is the number of
+ * 			system calls each operation costs. Elapsed time is only meaningful against a device.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306RawTime.h"
+#include "DS1306Transaction.h"
+
+// Operations per run
+#define BENCH_LOOPS		100
+
+DS1306 rtc;
+DS1306Emulator emu;
+
+ds1306time sample = { 30, 45, 13, 1, 'P', 3, 15, 6, 24 };
+unsigned char userBuf[DS1306_USER_END - DS1306_USER_START + 1];
+
+// Microseconds from a monotonic clock
+unsigned long micros()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+}
+
+// Benchmark bodies, each called once per operation with the operation number
+void benchGetTime(unsigned int)
+{
+	ds1306time time;
+	rtc.getTime(&time);
+}
+
+void benchGetRawTime(unsigned int)
+{
+	DS1306RawTime raw;
+	rtc.getRawTime(&raw);
+}
+
+void benchSetTime(unsigned int)
+{
+	rtc.setTime(&sample);
+}
+
+void benchUserRead8(unsigned int i)
+{
+	rtc.readUser(DS1306_USER_START + (i % 12) * 8, (char *) userBuf, 8);
+}
+
+void benchUserWrite8(unsigned int i)
+{
+	rtc.writeUser(DS1306_USER_START + (i % 12) * 8, (const char *) userBuf, 8);
+}
+
+void benchUserWrite96(unsigned int)
+{
+	rtc.writeUser(DS1306_USER_START, (const char *) userBuf, sizeof(userBuf));
+}
+
+// Eight scattered single byte updates, as a counter store might make
+void benchUserUpdate8(unsigned int i)
+{
+	for (unsigned char j = 0; j < 8; j++) {
+		unsigned char value = i + j;
+		rtc.write(DS1306_USER_START + j * 12, &value, 1);
+	}
+}
+
+// Set the time then read it back
+void benchSetGetTime(unsigned int)
+{
+	ds1306time time;
+	rtc.setTime(&sample);
+	rtc.getTime(&time);
+}
+
+// Reprogram and enable both alarms through the transaction builder
+void benchTransaction(unsigned int i)
+{
+	ds1306alarm alarm = { 0, (unsigned char) (i % 60), 7, 0, 0, DS1306_ANY };
+	DS1306Transaction transaction(&rtc);
+	transaction.setAlarm(0, &alarm);
+	transaction.setAlarm(1, &alarm);
+	transaction.setAlarmEnabled(0, true);
+	transaction.setAlarmEnabled(1, true);
+	transaction.commit();
+}
+
+// Run one benchmark and print its result line
+void run(const char *name, void (*body)(unsigned int), bool batched)
+{
+	rtc.resetMessageCount();
+	unsigned long start = micros();
+
+	if (batched) rtc.beginBatch();
+	for (unsigned int i = 0; i < BENCH_LOOPS; i++) {
+		body(i);
+	}
+	if (batched) rtc.endBatch();
+
+	unsigned long elapsed = micros() - start;
+	unsigned long messages = rtc.getMessageCount();
+
+	printf("BENCH,%s%s,%u,%lu,%.2f,%lu\n", name, batched ? "_batched" : "", BENCH_LOOPS, messages,
+		(double) messages / BENCH_LOOPS, elapsed);
+}
+
+// Run a benchmark unbatched, then batched
+void runBoth(const char *name, void (*body)(unsigned int))
+{
+	run(name, body, false);
+	run(name, body, true);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) {
+		rtc.setDevice(argv[1]);
+	} else {
+		rtc.attach(&emu);
+	}
+	rtc.init(0);
+	if (!rtc.isBusOpen()) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	rtc.setWriteProtection(false);
+
+	for (unsigned int i = 0; i < sizeof(userBuf); i++) {
+		userBuf[i] = i;
+	}
+
+	printf("# ds1306spidevbench on %s\n", (argc > 1) ? argv[1] : "DS1306Emulator");
+	printf("# BENCH,name,operations,messages,messages_per_operation,elapsed_us\n");
+
+	runBoth("get_time", benchGetTime);
+	runBoth("get_raw_time", benchGetRawTime);
+	runBoth("set_time", benchSetTime);
+	runBoth("user_read_8", benchUserRead8);
+	runBoth("user_write_8", benchUserWrite8);
+	runBoth("user_write_96", benchUserWrite96);
+	runBoth("user_update_8x1", benchUserUpdate8);
+	runBoth("set_get_time", benchSetGetTime);
+	runBoth("transaction_alarms", benchTransaction);
+
+	printf("END\n");
+	return rtc.getMessageErrorCount() ? 1 : 0;
+}
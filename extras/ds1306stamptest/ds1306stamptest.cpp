@@ -0,0 +1,223 @@
+/*
+ * File			ds1306stamptest.cpp
+ *
+ * Synopsis		Host test of DS1306StampLog entries at each length boundary, round tripped
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306stamptest extras/ds1306stamptest/ds1306stamptest.cpp *.cpp
+ *
+ * 			Differences either side of each entry length (0x7F / 0x80, 0x3FFF / 0x4000, 0x1FFFFF /
+ * 			0x200000, 0x0FFFFFFF / 0x10000000) are appended and checked for the bytes they take and
+ * 			their leading bits, then read back with next() and again after setLength() takes the
+ * 			log over. Backward steps, tick carries into the seconds and a full buffer are checked the
+ * 			same way, and setLength() is checked to reject every truncation of a log, bad lead bytes
+ * 			and a length beyond the buffer. One line is printed per check:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "DS1306Stamp.h"
+
+// Log buffer size for the tests
+#define LOG_SIZE		128
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// True if two stamps are the same
+bool same(const ds1306stamp *a, const ds1306stamp *b)
+{
+	return a->seconds == b->seconds && a->ticks == b->ticks;
+}
+
+// True if the log reads back exactly the stamps given, both directly and after setLength() on a copy
+bool readsBack(DS1306StampLog *log, unsigned char *buf, const ds1306stamp *stamps, unsigned int count, bool ticks)
+{
+	ds1306stamp stamp;
+
+	log->rewind();
+	for (unsigned int i = 0; i < count; i++) {
+		if (!log->next(&stamp) || !same(&stamp, &stamps[i])) return false;
+	}
+	if (log->next(&stamp)) return false;
+
+	unsigned char copy[LOG_SIZE];
+	memcpy(copy, buf, log->getLength());
+	DS1306StampLog loaded(copy, sizeof(copy), ticks);
+	if (!loaded.setLength(log->getLength()) || loaded.getCount() != count) return false;
+	for (unsigned int i = 0; i < count; i++) {
+		if (!loaded.next(&stamp) || !same(&stamp, &stamps[i])) return false;
+	}
+	return !loaded.next(&stamp);
+}
+
+// Append one stamp, true if the entry took len bytes and began with lead
+bool appended(DS1306StampLog *log, unsigned char *buf, const ds1306stamp *stamp, unsigned int len, unsigned char lead)
+{
+	unsigned int before = log->getLength();
+	if (!log->append(stamp)) return false;
+	return log->getLength() == before + len && buf[before] == lead;
+}
+
+// Seconds differences either side of each entry length
+void checkBoundaries()
+{
+	static const struct {
+		const char *name;
+		unsigned long delta;
+		unsigned char len;
+		unsigned char lead;
+	} steps[] = {
+		{ "delta_0", 0, 1, 0x00 },
+		{ "delta_7f", 0x7F, 1, 0x7F },
+		{ "delta_80", 0x80, 2, 0x80 },
+		{ "delta_3fff", 0x3FFF, 2, 0xBF },
+		{ "delta_4000", 0x4000, 3, 0xC0 },
+		{ "delta_1fffff", 0x1FFFFF, 3, 0xDF },
+		{ "delta_200000", 0x200000, 4, 0xE0 },
+		{ "delta_fffffff", 0x0FFFFFFF, 4, 0xEF },
+		{ "delta_10000000", 0x10000000, 1 + DS1306_STAMP_SIZE, DS1306_STAMP_ABSOLUTE },
+	};
+	const unsigned int count = sizeof(steps) / sizeof(steps[0]);
+
+	unsigned char buf[LOG_SIZE];
+	DS1306StampLog log(buf, sizeof(buf));
+	ds1306stamp stamps[count + 1];
+
+	stamps[0].seconds = 1000;
+	stamps[0].ticks = 0;
+	check("first_absolute", appended(&log, buf, &stamps[0], 1 + DS1306_STAMP_SIZE, DS1306_STAMP_ABSOLUTE));
+
+	for (unsigned int i = 0; i < count; i++) {
+		stamps[i + 1].seconds = stamps[i].seconds + steps[i].delta;
+		stamps[i + 1].ticks = 0;
+		check(steps[i].name, appended(&log, buf, &stamps[i + 1], steps[i].len, steps[i].lead));
+	}
+
+	// The low bytes follow high first
+	check("delta_bytes", buf[5 + 1 + 1] == 0x80 && buf[5 + 1 + 1 + 1] == 0x80 &&
+		buf[5 + 1 + 1 + 2] == 0xBF && buf[5 + 1 + 1 + 3] == 0xFF);
+	check("boundary_round_trip", log.getCount() == count + 1 && readsBack(&log, buf, stamps, count + 1, false));
+
+	// A log taken over continues from its last stamp
+	DS1306StampLog loaded(buf, sizeof(buf));
+	loaded.setLength(log.getLength());
+	ds1306stamp after = { stamps[count].seconds + 1, 0 };
+	check("extend_loaded", appended(&loaded, buf, &after, 1, 0x01));
+}
+
+// Steps back in time, tick carries and a full buffer
+void checkSteps()
+{
+	unsigned char buf[LOG_SIZE];
+
+	// A backward step needs a full stamp, the step after it is a difference again
+	DS1306StampLog log(buf, sizeof(buf));
+	ds1306stamp backward[] = { { 5000, 0 }, { 4999, 0 }, { 5000, 0 } };
+	log.append(&backward[0]);
+	check("backward", appended(&log, buf, &backward[1], 1 + DS1306_STAMP_SIZE, DS1306_STAMP_ABSOLUTE) &&
+		appended(&log, buf, &backward[2], 1, 0x01) && readsBack(&log, buf, backward, 3, false));
+
+	// Without ticks they are dropped, so stamps differing only in ticks are 0 apart
+	log.clear();
+	ds1306stamp dropped[] = { { 7, 200 }, { 7, 10 } };
+	ds1306stamp droppedRead[] = { { 7, 0 }, { 7, 0 } };
+	log.append(&dropped[0]);
+	check("ticks_dropped", appended(&log, buf, &dropped[1], 1, 0x00) && readsBack(&log, buf, droppedRead, 2, false));
+
+	// With ticks, differences are in ticks and carry into the seconds
+	DS1306StampLog ticked(buf, sizeof(buf), true);
+	ds1306stamp carry[] = { { 10, 250 }, { 11, 5 }, { 11, 5 + 0x7F }, { 12, 4 } };
+	ticked.append(&carry[0]);
+	check("tick_carry", appended(&ticked, buf, &carry[1], 1, 11) && appended(&ticked, buf, &carry[2], 1, 0x7F) &&
+		appended(&ticked, buf, &carry[3], 2, 0x80) && readsBack(&ticked, buf, carry, 4, true));
+
+	// An earlier tick in the same second needs a full stamp, as does a step of 2^28 ticks, while
+	// one tick less is the largest difference even though its seconds differ by 2^20
+	ticked.clear();
+	ds1306stamp jumps[] = { { 20, 100 }, { 20, 99 }, { 20 + 0x100000, 98 }, { 20 + 0x200000, 98 } };
+	ticked.append(&jumps[0]);
+	check("tick_backward", appended(&ticked, buf, &jumps[1], 1 + DS1306_STAMP_SIZE_TICKS, DS1306_STAMP_ABSOLUTE));
+	check("tick_largest", appended(&ticked, buf, &jumps[2], 4, 0xEF) && buf[ticked.getLength() - 1] == 0xFF);
+	check("tick_beyond", appended(&ticked, buf, &jumps[3], 1 + DS1306_STAMP_SIZE_TICKS, DS1306_STAMP_ABSOLUTE) &&
+		readsBack(&ticked, buf, jumps, 4, true));
+
+	// A full buffer refuses the entry and leaves the log as it was
+	DS1306StampLog small(buf, 1 + DS1306_STAMP_SIZE + 1);
+	ds1306stamp fill[] = { { 100, 0 }, { 101, 0 }, { 102, 0 } };
+	bool filled = small.append(&fill[0]) && small.append(&fill[1]);
+	check("full", filled && !small.append(&fill[2]) && small.getLength() == 1 + DS1306_STAMP_SIZE + 1 &&
+		small.getCount() == 2 && readsBack(&small, buf, fill, 2, false));
+}
+
+// setLength() on truncated and malformed logs
+void checkSetLength()
+{
+	unsigned char buf[LOG_SIZE];
+	DS1306StampLog log(buf, sizeof(buf));
+	ds1306stamp stamps[] = { { 1, 0 }, { 1 + 0x80, 0 }, { 1 + 0x80 + 0x4000, 0 }, { 1 + 0x80 + 0x4000 + 0x200000, 0 } };
+	for (unsigned int i = 0; i < 4; i++) {
+		log.append(&stamps[i]);
+	}
+	unsigned int length = log.getLength();
+
+	// Every length that ends between entries is accepted, every one inside an entry rejected
+	static const unsigned int ends[] = { 0, 5, 7, 10, 14 };
+	bool truncated = true;
+	DS1306StampLog loaded(buf, sizeof(buf));
+	for (unsigned int len = 0, end = 0; len <= length; len++) {
+		bool boundary = (len == ends[end]);
+		if (loaded.setLength(len) != boundary) truncated = false;
+		if (boundary) {
+			if (loaded.getCount() != end || loaded.getLength() != len) truncated = false;
+			end++;
+		} else if (loaded.getCount() != 0 || loaded.getLength() != 0) {
+			truncated = false;
+		}
+	}
+	check("truncated", truncated && length == 14);
+
+	check("beyond_buffer", !loaded.setLength(sizeof(buf) + 1) && loaded.getLength() == 0);
+
+	// A log must open with a full stamp, and no lead byte has more than three bytes after it
+	buf[0] = 0x01;
+	check("no_absolute", !loaded.setLength(1));
+	log.clear();
+	log.append(&stamps[0]);
+	bool leads = true;
+	for (unsigned int lead = 0xF0; lead < DS1306_STAMP_ABSOLUTE; lead++) {
+		memset(&buf[5], 0, 5);
+		buf[5] = lead;
+		if (loaded.setLength(10)) leads = false;
+	}
+	check("bad_lead", leads);
+}
+
+int main()
+{
+	checkBoundaries();
+	checkSteps();
+	checkSetLength();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
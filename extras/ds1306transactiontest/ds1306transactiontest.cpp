@@ -0,0 +1,249 @@
+/*
+ * File			ds1306transactiontest.cpp
+ *
+ * Synopsis		Host test of the bursts DS1306Transaction plans and writes, against the emulator
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306transactiontest extras/ds1306transactiontest/ds1306transactiontest.cpp *.cpp
+ *
+ * 			Each check stages updates, compares the bursts reported by getPlanned() with those
+ * 			expected, and where it commits, checks the emulator's transaction count and registers.
+ * 			Covered are both alarms and CR merging into one burst, time and CR kept apart, write
+ * 			protection cleared first and set last, TCR borrowed from the DS1306 cache, gaps in user
+ * 			memory bridged only once loaded, and a pending alarm flag surviving a commit that stages
+ * 			only the other alarm. One line is printed per check:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306Transaction.h"
+
+#if !DS1306_ALARMS || !DS1306_TRICKLE
+#error "ds1306transactiontest needs DS1306_ALARMS and DS1306_TRICKLE set to 1"
+#endif
+
+DS1306Emulator emu;
+DS1306 rtc;
+
+ds1306alarm alarmA = { 1, 2, 3, 0, 0, 4 };
+ds1306alarm alarmB = { 5, 6, 7, 0, 0, 1 };
+ds1306time timeA = { 10, 20, 11, 0, 0, 3, 4, 5, 24 };
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// True if the last plan or commit found exactly the expected bursts, given as address, length pairs
+bool planned(DS1306Transaction *t, unsigned char count, const unsigned char *expected)
+{
+	if (t->getPlannedCount() != count) return false;
+	for (unsigned char i = 0; i < count; i++) {
+		unsigned char address, len;
+		if (!t->getPlanned(i, &address, &len)) return false;
+		if (address != expected[2 * i] || len != expected[2 * i + 1]) return false;
+	}
+	return true;
+}
+
+// Both alarms and CR are adjacent, so staging all three is one burst
+void checkAlarms()
+{
+	DS1306Transaction t(&rtc);
+	ds1306alarm alarm;
+
+	emu.resetCounters();
+	t.setAlarm(0, &alarmA);
+	t.setAlarm(1, &alarmB);
+	t.setAlarmEnabled(0, true);
+	t.setAlarmEnabled(1, true);
+	check("cr_read_once", emu.getTransactionCount() == 1);
+
+	static const unsigned char one[] = { DS1306_ALARM0, 2 * DS1306_SIZE_ALARM + 1 };
+	check("alarms_cr_plan", t.plan() == 1 && planned(&t, 1, one));
+
+	emu.resetCounters();
+	check("alarms_cr_commit", t.commit() == 1 && emu.getTransactionCount() == 1);
+	rtc.getAlarm(1, &alarm);
+	check("alarms_cr_written", alarm.seconds == 5 && alarm.hours == 7 && alarm.dow == 1 &&
+		rtc.getAlarmEnabled(0) && rtc.getAlarmEnabled(1));
+}
+
+// The time registers and unstaged alarms never bridge a gap, so time and CR are two transactions
+void checkTimeAndControl()
+{
+	DS1306Transaction t(&rtc);
+	ds1306time time;
+
+	t.load(DS1306_ALARM0, 2 * DS1306_SIZE_ALARM);
+	t.setWriteProtection(false);
+	t.commit();
+
+	t.setTime(&timeA);
+	t.set1HzState(true);
+	static const unsigned char two[] = { DS1306_DATETIME, DS1306_SIZE_DATETIME, DS1306_CR, 1 };
+	check("time_cr_plan", t.plan() == 2 && planned(&t, 2, two));
+
+	emu.resetCounters();
+	check("time_cr_commit", t.commit() == 2 && emu.getTransactionCount() == 2);
+	rtc.getTime(&time);
+	check("time_cr_written", time.hours == 11 && time.day == 4 && time.year == 24 && rtc.get1HzState());
+
+	// Time and alarm 0 are adjacent and both staged, so one burst
+	t.setTime(&timeA);
+	t.setAlarm(0, &alarmA);
+	static const unsigned char adjacent[] = { DS1306_DATETIME, DS1306_SIZE_DATETIME + DS1306_SIZE_ALARM };
+	check("time_alarm_plan", t.plan() == 1 && planned(&t, 1, adjacent));
+	t.discard();
+}
+
+// A staged CR clearing WP goes first on its own, one setting WP goes last
+void checkWriteProtection()
+{
+	DS1306Transaction t(&rtc);
+	ds1306alarm alarm;
+
+	rtc.setWriteProtection(true);
+	t.setWriteProtection(false);
+	t.setAlarm(0, &alarmA);
+	static const unsigned char clearFirst[] = { DS1306_CR, 1, DS1306_ALARM0, DS1306_SIZE_ALARM };
+	check("wp_clear_plan", t.plan() == 2 && planned(&t, 2, clearFirst));
+	t.commit();
+	rtc.getAlarm(0, &alarm);
+	check("wp_clear_written", !rtc.isWriteProtected() && alarm.seconds == 1 && alarm.hours == 3);
+
+	t.setAlarm(1, &alarmA);
+	t.setWriteProtection(true);
+	static const unsigned char setLast[] = { DS1306_ALARM1, DS1306_SIZE_ALARM, DS1306_CR, 1 };
+	check("wp_set_plan", t.plan() == 2 && planned(&t, 2, setLast));
+	t.commit();
+	rtc.getAlarm(1, &alarm);
+	check("wp_set_written", rtc.isWriteProtected() && alarm.seconds == 1);
+
+	// WP not known is cleared first in case it is set, and CR written again after the rest
+	rtc.setWriteProtection(false);
+	DS1306Transaction unknown(&rtc);
+	unknown.stage(DS1306_CR, 0);
+	unknown.setAlarm(0, &alarmB);
+	static const unsigned char unknownFirst[] = { DS1306_CR, 1, DS1306_ALARM0, DS1306_SIZE_ALARM, DS1306_CR, 1 };
+	check("wp_unknown_plan", unknown.plan() == 3 && planned(&unknown, 3, unknownFirst));
+	unknown.discard();
+}
+
+// TCR's value is taken from the DS1306 cache to bridge from alarm 1 over CR and SR
+void checkTrickleCache()
+{
+	DS1306Transaction t(&rtc);
+	unsigned char diodes, resistor;
+
+	rtc.enableCache();
+	rtc.getTrickleChargeState(&diodes, &resistor);
+	rtc.get1HzState();
+
+	t.setAlarm(1, &alarmB);
+	t.enableTrickleCharge(2, 4);
+	static const unsigned char borrowed[] = { DS1306_ALARM1, DS1306_SIZE_ALARM + 3 };
+	check("tcr_plan", t.plan() == 1 && planned(&t, 1, borrowed));
+	t.commit();
+
+	rtc.invalidateCache();
+	check("tcr_written", rtc.getTrickleChargeState(&diodes, &resistor) && diodes == 2 && resistor == 4 &&
+		rtc.get1HzState());
+	rtc.disableCache();
+
+	// Without the cache TCR is unknown, so the CR and SR gap is not bridged
+	DS1306Transaction cold(&rtc);
+	cold.setAlarm(1, &alarmB);
+	cold.enableTrickleCharge(2, 8);
+	check("tcr_uncached_plan", cold.plan() == 2);
+	cold.discard();
+}
+
+// User memory gaps are bridged only with the bytes between known
+void checkUserGap()
+{
+	DS1306Transaction t(&rtc);
+	char x = 'x';
+
+	t.writeUser(DS1306_USER_START, &x, 1);
+	t.writeUser(DS1306_USER_START + 5, &x, 1);
+	static const unsigned char apart[] = { DS1306_USER_START, 1, DS1306_USER_START + 5, 1 };
+	check("user_gap_unknown", t.plan() == 2 && planned(&t, 2, apart));
+
+	emu.poke(DS1306_USER_START + 2, 0x42);
+	t.load(DS1306_USER_START, 6);
+	static const unsigned char merged[] = { DS1306_USER_START, 6 };
+	check("user_gap_loaded", t.plan() == 1 && planned(&t, 1, merged));
+
+	emu.resetCounters();
+	t.commit();
+	check("user_gap_written", emu.getTransactionCount() == 1 && emu.peek(DS1306_USER_START) == 'x' &&
+		emu.peek(DS1306_USER_START + 5) == 'x' && emu.peek(DS1306_USER_START + 2) == 0x42);
+
+	// The clock registers and user memory are never merged
+	check("range", !t.stage(0x12, 1) && !t.writeUser(DS1306_USER_END, &x, 2) && t.plan() == 0);
+}
+
+// A pending flag of one alarm survives committing the other alarm and CR
+void checkPendingFlag()
+{
+	DS1306Transaction t(&rtc);
+	ds1306alarm any = { DS1306_ANY, DS1306_ANY, DS1306_ANY, DS1306_ANY, 0, DS1306_ANY };
+
+	rtc.setWriteProtection(false);
+	t.setAlarm(1, &any);
+	t.set1HzState(true);
+	t.commit();
+	emu.tick();
+	check("pending_raised", rtc.getAlarmState(1));
+
+	t.setAlarm(0, &alarmA);
+	t.set1HzState(false);
+	static const unsigned char apart[] = { DS1306_ALARM0, DS1306_SIZE_ALARM, DS1306_CR, 1 };
+	check("pending_plan", t.plan() == 2 && planned(&t, 2, apart));
+	t.commit();
+	check("pending_kept", rtc.getAlarmState(1) && !rtc.get1HzState());
+
+	// A partly staged alarm is bridged only over registers whose value is known
+	DS1306Transaction partial(&rtc);
+	partial.stage(DS1306_ALARM0, 0x00);
+	partial.stage(DS1306_ALARM0 + 2, 0x05);
+	static const unsigned char unknown[] = { DS1306_ALARM0, 1, DS1306_ALARM0 + 2, 1 };
+	check("partial_alarm_plan", partial.plan() == 2 && planned(&partial, 2, unknown));
+	partial.discard();
+}
+
+int main()
+{
+	rtc.attach(&emu);
+	rtc.init(0);
+	rtc.setWriteProtection(false);
+
+	checkAlarms();
+	checkTimeAndControl();
+	checkWriteProtection();
+	checkTrickleCache();
+	checkUserGap();
+	checkPendingFlag();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * File			ds1306usercachetest.cpp
+ *
+ * Synopsis		Host test of DS1306UserCache flush merging and flush policies, against the emulator
+ *
+ * Author		Chris Bearman
+ *
+ * Version		1.0
+ *
+ * License		This software is released under the terms of the Mozilla Public License (MPL) version 2.0
+ * 				Full details of licensing terms can be found in the "LICENSE" file, distributed with this code
+ *
+ * Instructions
+ * 			A host program, not a sketch. From the library directory build it with
+ *
+ * 			g++ -O2 -I. -o ds1306usercachetest extras/ds1306usercachetest/ds1306usercachetest.cpp *.cpp
+ *
+ * 			The bursts returned by flush() are checked against the emulator's transaction count for
+ * 			dirty runs either side of the gap threshold, and the chip contents against the writes.
+ * 			The write count and interval policies are checked to flush exactly when due, the
+ * 			statistics against the traffic of the same calls made uncached, and out of range calls
+ * 			(a negative length among them) to fail without touching the caller's buffer. One line is
+ * 			printed per check:
+ *
+ * 			CHECK,<name>,<pass|fail>
+ * 			END
+ *
+ * 			The exit status is 1 if any check failed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "DS1306.h"
+#include "DS1306Emulator.h"
+#include "DS1306UserCache.h"
+
+DS1306Emulator emu;
+DS1306 rtc;
+
+// Millisecond source for the interval policy
+unsigned long now = 0;
+
+unsigned long testMillis()
+{
+	return now;
+}
+
+int failures = 0;
+
+// Print a check result
+void check(const char *name, bool pass)
+{
+	printf("CHECK,%s,%s\n", name, pass ? "pass" : "fail");
+	if (!pass) failures++;
+}
+
+// True if the chip holds the same user memory as the cache
+bool flushed(DS1306UserCache *cache)
+{
+	char mirror[DS1306_USERCACHE_SIZE];
+	cache->readUser(DS1306_USER_START, mirror, DS1306_USERCACHE_SIZE);
+	for (unsigned char i = 0; i < DS1306_USERCACHE_SIZE; i++) {
+		if (emu.peek(DS1306_USER_START + i) != (unsigned char) mirror[i]) return false;
+	}
+	return true;
+}
+
+// Write single bytes at offsets into user memory, then flush, returning the bursts
+unsigned char writeAndFlush(DS1306UserCache *cache, const unsigned char *offsets, unsigned char count, char value)
+{
+	for (unsigned char i = 0; i < count; i++) {
+		cache->writeUser(DS1306_USER_START + offsets[i], &value, 1);
+	}
+	emu.resetCounters();
+	return cache->flush();
+}
+
+// Runs merged up to the gap threshold and no further
+void checkMerging()
+{
+	DS1306UserCache cache(&rtc);
+
+	emu.resetCounters();
+	cache.begin();
+	check("begin", emu.getTransactionCount() == 1 && !cache.isDirty());
+
+	// Writes stay in RAM until flushed
+	char value = 'a';
+	emu.resetCounters();
+	cache.writeUser(DS1306_USER_START, &value, 1);
+	check("write_cached", emu.getTransactionCount() == 0 && cache.isDirty() && emu.peek(DS1306_USER_START) != 'a');
+
+	// Two clean bytes between, the default threshold, is one burst
+	static const unsigned char withinGap[] = { 0, 3 };
+	unsigned char bursts = writeAndFlush(&cache, withinGap, 2, 'b');
+	check("merge_default_gap", bursts == 1 && emu.getTransactionCount() == 1 && flushed(&cache) && !cache.isDirty());
+
+	static const unsigned char beyondGap[] = { 10, 14 };
+	bursts = writeAndFlush(&cache, beyondGap, 2, 'c');
+	check("split_default_gap", bursts == 2 && emu.getTransactionCount() == 2 && flushed(&cache));
+
+	// Threshold of 0 merges only adjacent bytes
+	cache.setGapThreshold(0);
+	static const unsigned char adjacent[] = { 20, 21, 23 };
+	bursts = writeAndFlush(&cache, adjacent, 3, 'd');
+	check("gap_zero", bursts == 2 && emu.getTransactionCount() == 2 && flushed(&cache));
+
+	// A threshold covering all of user memory is one burst from the first dirty byte to the last
+	cache.setGapThreshold(DS1306_USERCACHE_SIZE);
+	static const unsigned char spread[] = { 1, 40, DS1306_USERCACHE_SIZE - 1 };
+	bursts = writeAndFlush(&cache, spread, 3, 'e');
+	check("gap_all", bursts == 1 && emu.getTransactionCount() == 1 && flushed(&cache));
+
+	emu.resetCounters();
+	check("flush_clean", cache.flush() == 0 && emu.getTransactionCount() == 0);
+}
+
+// Automatic flushes after a number of writes and after an interval
+void checkPolicies()
+{
+	DS1306UserCache cache(&rtc);
+	char value = 'f';
+
+	cache.begin();
+	cache.setFlushCount(3);
+	emu.resetCounters();
+	cache.writeUser(DS1306_USER_START + 5, &value, 1);
+	cache.writeUser(DS1306_USER_START + 50, &value, 1);
+	check("count_pending", emu.getTransactionCount() == 0 && cache.isDirty());
+	cache.writeUser(DS1306_USER_START + 51, &value, 1);
+	check("count_flush", emu.getTransactionCount() == 2 && !cache.isDirty() && flushed(&cache));
+	cache.setFlushCount(0);
+
+	cache.setMillisSource(testMillis);
+	cache.setFlushInterval(100);
+	now = 1000;
+	emu.resetCounters();
+	cache.writeUser(DS1306_USER_START + 7, &value, 1);
+	now = 1050;
+	cache.writeUser(DS1306_USER_START + 8, &value, 1);
+	cache.poll();
+	now = 1099;
+	cache.poll();
+	check("interval_pending", emu.getTransactionCount() == 0 && cache.isDirty());
+	now = 1100;
+	cache.poll();
+	check("interval_flush", emu.getTransactionCount() == 1 && !cache.isDirty() && flushed(&cache));
+
+	// The age runs from the first write after a flush, and a write can trigger the flush itself
+	now = 2000;
+	cache.writeUser(DS1306_USER_START + 9, &value, 1);
+	now = 2100;
+	emu.resetCounters();
+	cache.writeUser(DS1306_USER_START + 10, &value, 1);
+	check("interval_on_write", emu.getTransactionCount() == 1 && !cache.isDirty());
+}
+
+// Statistics against the same calls made uncached
+void checkStatistics()
+{
+	DS1306UserCache cache(&rtc);
+	char buf[4] = { 1, 2, 3, 4 };
+
+	cache.begin();
+	cache.resetCounters();
+	for (unsigned char i = 0; i < 10; i++) {
+		cache.writeUser(DS1306_USER_START + 30, buf, 4);
+	}
+	for (unsigned char i = 0; i < 5; i++) {
+		cache.readUser(DS1306_USER_START + 30, buf, 4);
+	}
+	emu.resetCounters();
+	cache.flush();
+
+	// 15 calls of 1 + 4 bytes each, against one burst of 1 + 4
+	check("transactions_saved", emu.getTransactionCount() == 1 && cache.getTransactionsSaved() == 14);
+	check("bytes_saved", cache.getBytesSaved() == 15 * 5 - 5);
+
+	// Loading the mirror costs more than one small read saves
+	cache.resetCounters();
+	cache.begin();
+	cache.readUser(DS1306_USER_START, buf, 1);
+	check("bytes_lost", cache.getTransactionsSaved() == 0 && cache.getBytesSaved() == 2 - (1 + DS1306_USERCACHE_SIZE));
+}
+
+// Calls outside user memory fail, leaving the caller's buffer alone
+void checkRange()
+{
+	DS1306UserCache cache(&rtc);
+	char guard[8];
+
+	cache.begin();
+	memset(guard, 0x5A, sizeof(guard));
+	bool untouched = !cache.readUser(DS1306_USER_START, guard, -1) &&
+		!cache.readUser(DS1306_USER_START, guard, 0) &&
+		!cache.readUser(DS1306_USER_END, guard, 2) &&
+		!cache.readUser(DS1306_USER_START - 1, guard, 1);
+	for (unsigned char i = 0; i < sizeof(guard); i++) {
+		if (guard[i] != 0x5A) untouched = false;
+	}
+	check("read_out_of_range", untouched);
+	check("write_out_of_range", !cache.writeUser(DS1306_USER_START, guard, -1) &&
+		!cache.writeUser(DS1306_USER_END, guard, 2) && !cache.isDirty());
+	check("last_byte", cache.writeUser(DS1306_USER_END, guard, 1) && cache.flush() == 1 &&
+		emu.peek(DS1306_USER_END) == 0x5A);
+}
+
+int main()
+{
+	rtc.attach(&emu);
+	rtc.init(0);
+	rtc.setWriteProtection(false);
+
+	checkMerging();
+	checkPolicies();
+	checkStatistics();
+	checkRange();
+
+	printf("END\n");
+	return failures ? 1 : 0;
+}